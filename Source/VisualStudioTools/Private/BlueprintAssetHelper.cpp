@@ -2,6 +2,7 @@
 // Licensed under the MIT License.
 
 #include "BlueprintAssetHelpers.h"
+#include "CommandletCancellation.h"
 
 #include "AssetRegistry/AssetRegistryModule.h"
 #include "Blueprint/BlueprintSupport.h"
@@ -9,7 +10,11 @@
 #include "Engine/BlueprintGeneratedClass.h"
 #include "Engine/Engine.h"
 #include "Engine/StreamableManager.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
 #include "Misc/ScopeExit.h"
+#include "UObject/UObjectGlobals.h"
 #include "VisualStudioTools.h"
 
 namespace VisualStudioTools
@@ -49,10 +54,133 @@ static FString GetObjectPathString(const FAssetData& InAssetData)
 
 #endif // FILTER_ASSETS_BY_CLASS_PATH
 
+TArray<FString> GetContentPaths(const FString& InDir)
+{
+	const FString ProjectDir = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir());
+	const FString FullDir = FPaths::ConvertRelativePathToFull(InDir);
+
+	TArray<FString> ContentPaths;
+	ContentPaths.Add(TEXT("/Game/"));
+
+	for (const TSharedRef<IPlugin>& Plugin : IPluginManager::Get().GetEnabledPluginsWithContent())
+	{
+		const FString PluginDir = FPaths::ConvertRelativePathToFull(Plugin->GetBaseDir());
+		if (FPaths::IsUnderDirectory(PluginDir, ProjectDir) || FPaths::IsUnderDirectory(PluginDir, FullDir))
+		{
+			ContentPaths.Add(Plugin->GetMountedAssetPath());
+		}
+	}
+
+	return ContentPaths;
+}
+
+void ScanAssetRegistry(const TArray<FString>& ContentPaths, bool bForceRescan)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::ScanAssetRegistry);
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+
+	if (ContentPaths.Num() == 0)
+	{
+		if (bForceRescan)
+		{
+			TArray<FString> RootPaths;
+			FPackageName::QueryRootContentPaths(RootPaths);
+			AssetRegistry.ScanPathsSynchronous(RootPaths, true /*bForceRescan*/);
+		}
+		else
+		{
+			AssetRegistry.SearchAllAssets(true);
+		}
+		return;
+	}
+
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Scanning content paths: %s"), *FString::Join(ContentPaths, TEXT(", ")));
+
+	// Unless forced, paths that were already discovered, e.g. by the initial scan of the editor, are not scanned again.
+	AssetRegistry.ScanPathsSynchronous(ContentPaths, bForceRescan);
+}
+
+static FSoftClassPath GetGeneratedClassPath(const FAssetData& InAssetData)
+{
+	return FSoftClassPath(InAssetData.GetTagValueRef<FString>(FBlueprintTags::GeneratedClassPath));
+}
+
+void FLoadStats::AddLoadTime(const FString& Path, double Seconds)
+{
+	if (SlowestLoads.Num() == MaxSlowestLoads && SlowestLoads.Last().Seconds >= Seconds)
+	{
+		return;
+	}
+
+	const int32 Idx = SlowestLoads.IndexOfByPredicate([Seconds](const FAssetLoadTime& Load) { return Load.Seconds < Seconds; });
+	SlowestLoads.Insert(FAssetLoadTime{ Path, Seconds }, Idx == INDEX_NONE ? SlowestLoads.Num() : Idx);
+
+	if (SlowestLoads.Num() > MaxSlowestLoads)
+	{
+		SlowestLoads.Pop();
+	}
+}
+
+/**
+* Collects garbage whenever the process memory goes over the budget. The objects already requested are
+* still referenced by their handles, so only the blueprints that were processed can be released.
+* Disabled at the yield points of the server, where the budget is only checked.
+*/
+class FMemoryBudget
+{
+public:
+	FMemoryBudget(int32 InMaxMemoryMB, FLoadStats& InStats)
+		: Budget(uint64(FMath::Max(0, InMaxMemoryMB)) * 1024 * 1024)
+		, Threshold(Budget)
+		, Stats(InStats)
+	{
+	}
+
+	void Update()
+	{
+		uint64 UsedMemory = FPlatformMemory::GetStats().UsedPhysical;
+
+		if (Budget > 0 && UsedMemory > Threshold && !IsRunningAtYieldPoint())
+		{
+			{
+				TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::CollectGarbage);
+				FScopedPerfTimer Timer(Stats.GCTime);
+				CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+			}
+
+			Stats.GCCount++;
+			const uint64 UsedBeforeGC = UsedMemory;
+			UsedMemory = FPlatformMemory::GetStats().UsedPhysical;
+
+			// The memory still in use after a collection can't be released, e.g. native data or the loaded
+			// dependencies of the assets in flight. Wait for some growth before collecting again,
+			// otherwise every asset would trigger a collection.
+			Threshold = FMath::Max(Budget, UsedMemory + Budget / 10);
+
+			UE_LOG(LogVisualStudioTools, Verbose, TEXT("Collected garbage: %llu MB -> %llu MB."), UsedBeforeGC / (1024 * 1024), UsedMemory / (1024 * 1024));
+		}
+
+		Stats.PeakUsedMemory = FMath::Max(Stats.PeakUsedMemory, UsedMemory);
+		Stats.TotalUsedMemory += UsedMemory;
+		Stats.MemorySamples++;
+	}
+
+private:
+	const uint64 Budget;
+	uint64 Threshold;
+	FLoadStats& Stats;
+};
+
 void ForEachAsset(
 	const TArray<FAssetData>& TargetAssets,
-	TFunctionRef<void(UBlueprintGeneratedClass*, const FAssetData& AssetData)> Callback)
+	TFunctionRef<void(UBlueprintGeneratedClass*, const FAssetData& AssetData)> Callback,
+	int32 MaxInFlight,
+	int32 MaxMemoryMB,
+	FLoadStats* OutStats)
 {
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::ForEachAsset);
+
 	// Show a simpler logging output.
 	// LogTimes are still useful to tell how long it takes to process each asset.
 	TGuardValue<bool> DisableLogVerbosity(GPrintLogVerbosity, false);
@@ -60,31 +188,82 @@ void ForEachAsset(
 
 	// We're about to load the assets which might trigger a ton of log messages
 	// Temporarily suppress them during this stage.
-	GEngine->Exec(nullptr, TEXT("log LogVisualStudioTools only"));
+	// At a yield point, the interrupted scan already did, and resetting them here would undo it.
+	const bool bSuppressLogs = !IsRunningAtYieldPoint();
+	if (bSuppressLogs)
+	{
+		GEngine->Exec(nullptr, TEXT("log LogVisualStudioTools only"));
+	}
 	ON_SCOPE_EXIT
 	{
-		GEngine->Exec(nullptr, TEXT("log reset"));
+		if (bSuppressLogs)
+		{
+			GEngine->Exec(nullptr, TEXT("log reset"));
+		}
 	};
 
 	FStreamableManager AssetLoader;
 
+	FLoadStats LocalStats;
+	FLoadStats& Stats = OutStats ? *OutStats : LocalStats;
+	FMemoryBudget MemoryBudget(MaxMemoryMB, Stats);
+
+	// Handles for the requests ahead of the asset being processed.
+	// The callbacks are invoked in the same order as the assets, so the results are deterministic,
+	// while the loader keeps working on the next requests in the window.
+	TArray<TSharedPtr<FStreamableHandle>> Handles;
+	Handles.SetNum(TargetAssets.Num());
+	MaxInFlight = FMath::Max(1, MaxInFlight);
+	int32 NextRequest = 0;
+
 	for (int32 Idx = 0; Idx < TargetAssets.Num(); Idx++)
 	{
-		const FAssetData AssetData = TargetAssets[Idx];
-		FSoftClassPath GenClassPath = AssetData.GetTagValueRef<FString>(FBlueprintTags::GeneratedClassPath);
+		// The previous asset was released, so the urgent requests of the server can load their own.
+		YieldToUrgentRequests();
+
+		if (IsCancellationRequested())
+		{
+			UE_LOG(LogVisualStudioTools, Warning, TEXT("Cancelled after processing %d of %d blueprints."), Idx, TargetAssets.Num());
+			for (; Idx < NextRequest; Idx++)
+			{
+				if (Handles[Idx].IsValid())
+				{
+					Handles[Idx]->CancelHandle();
+				}
+			}
+			break;
+		}
+
+		// The previous asset was already released, it's safe to collect it before loading more.
+		MemoryBudget.Update();
+
+		for (; NextRequest < TargetAssets.Num() && NextRequest < Idx + MaxInFlight; NextRequest++)
+		{
+			Handles[NextRequest] = AssetLoader.RequestAsyncLoad(GetGeneratedClassPath(TargetAssets[NextRequest]));
+		}
+
+		const FAssetData& AssetData = TargetAssets[Idx];
+		FSoftClassPath GenClassPath = GetGeneratedClassPath(AssetData);
 		UE_LOG(LogVisualStudioTools, Display, TEXT("Processing blueprints [%d/%d]: %s"), Idx + 1, TargetAssets.Num(), *GenClassPath.ToString());
 
-		TSharedPtr<FStreamableHandle> Handle = AssetLoader.RequestSyncLoad(GenClassPath);
+		TSharedPtr<FStreamableHandle> Handle = MoveTemp(Handles[Idx]);
+		if (!Handle.IsValid())
+		{
+			UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to get a streamable handle for Blueprint. Skipping. GenClassPath: %s"), *GenClassPath.ToString());
+			continue;
+		}
+
 		ON_SCOPE_EXIT
 		{
 			// We're done, notify an unload.
 			Handle->ReleaseHandle();
 		};
 
-		if (!Handle.IsValid())
 		{
-			UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to get a streamable handle for Blueprint. Skipping. GenClassPath: %s"), *GenClassPath.ToString());
-			continue;
+			TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::WaitForAsset);
+			const double WaitStart = FPlatformTime::Seconds();
+			Handle->WaitUntilComplete();
+			Stats.AddLoadTime(GenClassPath.ToString(), FPlatformTime::Seconds() - WaitStart);
 		}
 
 		if (auto BlueprintGeneratedClass = Cast<UBlueprintGeneratedClass>(Handle->GetLoadedAsset()))
@@ -3,6 +3,7 @@
 
 #pragma once
 #include "CoreMinimal.h"
+#include "CommandletPerf.h"
 #include "UObject/NoExportTypes.h"
 
 class UBlueprintGeneratedClass;
@@ -11,16 +12,67 @@ namespace VisualStudioTools
 {
 namespace AssetHelpers
 {
+static constexpr int32 DefaultMaxInFlight = 8;
+
+struct FAssetLoadTime
+{
+	FString Path;
+	double Seconds = 0.0;
+};
+
+/**
+* Process memory, garbage collection activity and the slowest assets while the assets were loaded.
+*/
+struct FLoadStats
+{
+	static constexpr int32 MaxSlowestLoads = 10;
+
+	uint64 PeakUsedMemory = 0;
+	uint64 TotalUsedMemory = 0;
+	int32 MemorySamples = 0;
+	int32 GCCount = 0;
+	FPerfTime GCTime;
+
+	/** Assets with the longest wait for their load to complete, from slowest to fastest. */
+	TArray<FAssetLoadTime> SlowestLoads;
+
+	uint64 GetAverageUsedMemory() const { return MemorySamples > 0 ? TotalUsedMemory / MemorySamples : 0; }
+
+	/** Keeps track of the load time of an asset, if it's among the slowest ones. */
+	void AddLoadTime(const FString& Path, double Seconds);
+};
+
 void SetBlueprintClassFilter(FARFilter& InOutFilter);
 
+/**
+* Content paths that can contain blueprints for the code under the given directory:
+* the project content and the content of the plugins under the project or the directory.
+*/
+TArray<FString> GetContentPaths(const FString& InDir);
+
+/**
+* Makes sure the asset registry has discovered the assets under the given content paths.
+* Only those paths are scanned, so the commandlets run with `-projectcontent` don't wait for the engine and unrelated plugins.
+* The asset gatherer reads its discovery cache for the files that did not change since it was written.
+* With no paths, the whole registry is scanned as before.
+* `bForceRescan` discovers again the paths that were already scanned, to pick up the files changed since then.
+*/
+void ScanAssetRegistry(const TArray<FString>& ContentPaths, bool bForceRescan = false);
+
 /**
 * Loads each blueprint asset and invokes the callback with the resulting blueprint generated class.
-* Each iteration will load the asset using a FStreamableHandle and verify that is a valid blueprint
-* before invoking the callback.
+* Up to `MaxInFlight` assets are requested asynchronously ahead of the one being processed, and each
+* handle is released as soon as its callback returns. Callbacks run on the game thread, in the same
+* order as `TargetAssets`, and only for assets that loaded as a valid blueprint.
+* When `MaxMemoryMB` is set, garbage is collected between assets whenever the process goes over that
+* budget, so callers must not keep pointers to the loaded objects after their callback returns.
 */
 void ForEachAsset(
 	const TArray<FAssetData>& TargetAssets,
-	TFunctionRef<void(UBlueprintGeneratedClass*, const FAssetData& AssetData)> Callback);
+	TFunctionRef<void(UBlueprintGeneratedClass*, const FAssetData& AssetData)> Callback,
+	int32 MaxInFlight = DefaultMaxInFlight,
+	int32 MaxMemoryMB = 0,
+	FLoadStats* OutStats = nullptr);
 
 } // namespace AssetHelpers
 } // namespace VisualStudioTools
@@ -0,0 +1,213 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "BlueprintCallSiteIndex.h"
+
+#include "BlueprintAssetHelpers.h"
+#include "CommandletCancellation.h"
+#include "Engine/BlueprintGeneratedClass.h"
+#include "HAL/FileManager.h"
+#include "Serialization/NameAsStringProxyArchive.h"
+#include "VisualStudioTools.h"
+
+namespace VisualStudioTools
+{
+// Bump whenever the layout of the records or the data they capture changes.
+static constexpr uint32 CallSiteIndexMagic = 0x56534349; // 'VSCI'
+static constexpr uint32 CallSiteIndexVersion = 1;
+
+FArchive& operator<<(FArchive& Ar, FCallSiteRecord& Record)
+{
+	return Ar << Record.Name << Record.CalledFunctions;
+}
+
+FCallSiteIndex::FCallSiteIndex()
+	: Signature(ComputeBuildSignature())
+{
+}
+
+bool FCallSiteIndex::Load(const FString& InFilePath)
+{
+	Entries.Reset();
+	Callers.Reset();
+
+	TUniquePtr<FArchive> Reader{ IFileManager::Get().CreateFileReader(*InFilePath) };
+	if (!Reader)
+	{
+		return false;
+	}
+
+	FNameAsStringProxyArchive Ar(*Reader);
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	FString FileSignature;
+	Ar << Magic << Version;
+	if (Ar.IsError() || Magic != CallSiteIndexMagic || Version != CallSiteIndexVersion)
+	{
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Ignoring incompatible call site index: %s"), *InFilePath);
+		return false;
+	}
+
+	Ar << FileSignature;
+	if (FileSignature != Signature)
+	{
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Call site index is outdated, rebuilding. { Index: %s, Current: %s }"), *FileSignature, *Signature);
+		return false;
+	}
+
+	Ar << Entries;
+	if (Ar.IsError())
+	{
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to read call site index, rebuilding: %s"), *InFilePath);
+		Entries.Reset();
+		return false;
+	}
+
+	RebuildCallers();
+	return true;
+}
+
+bool FCallSiteIndex::Save(const FString& InFilePath)
+{
+	// Written next to the file and moved over it, so an interrupted save leaves the previous call site index intact.
+	const FString TempFilePath = InFilePath + TEXT(".tmp");
+	TUniquePtr<FArchive> Writer{ IFileManager::Get().CreateFileWriter(*TempFilePath) };
+	if (!Writer)
+	{
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to create call site index with path: %s"), *TempFilePath);
+		return false;
+	}
+
+	FNameAsStringProxyArchive Ar(*Writer);
+
+	uint32 Magic = CallSiteIndexMagic;
+	uint32 Version = CallSiteIndexVersion;
+	Ar << Magic << Version << Signature << Entries;
+
+	const bool bWritten = Writer->Close() && !Ar.IsError();
+	Writer.Reset();
+
+	if (!bWritten || !IFileManager::Get().Move(*InFilePath, *TempFilePath))
+	{
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to write call site index with path: %s"), *InFilePath);
+		IFileManager::Get().Delete(*TempFilePath);
+		return false;
+	}
+
+	return true;
+}
+
+void FCallSiteIndex::Update(const TArray<FAssetData>& InAssets, int32 MaxInFlight, int32 MaxMemoryMB)
+{
+	Assets.Reset();
+
+	TArray<FAssetData> ChangedAssets;
+	for (const FAssetData& AssetData : InAssets)
+	{
+		Assets.Add(AssetData.PackageName, AssetData);
+
+		const FEntry* Entry = Entries.Find(AssetData.PackageName);
+		const FPackageStamp Stamp = Stamper.GetPackageStamp(AssetData);
+		if (Entry == nullptr || !Stamp.IsValid() || !(Entry->Stamp == Stamp))
+		{
+			ChangedAssets.Add(AssetData);
+		}
+	}
+
+	// Drop the blueprints that were deleted.
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		if (!Assets.Contains(It.Key()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Call site index: %d up to date, %d to load."),
+		InAssets.Num() - ChangedAssets.Num(), ChangedAssets.Num());
+
+	// The entries of the changed assets are only replaced once they load, so a cancelled update keeps them.
+	// Their stamps are out of date, so they are loaded again by the next update.
+	TSet<FName> ReloadedPackages;
+	AssetHelpers::ForEachAsset(ChangedAssets,
+		[&](UBlueprintGeneratedClass* BlueprintGeneratedClass, const FAssetData& AssetData)
+		{
+			FEntry& Entry = Entries.FindOrAdd(AssetData.PackageName);
+			Entry.Stamp = Stamper.GetPackageStamp(AssetData);
+			Entry.Record = MakeRecord(BlueprintGeneratedClass);
+			ReloadedPackages.Add(AssetData.PackageName);
+		},
+		MaxInFlight,
+		MaxMemoryMB);
+
+	if (!IsCancellationRequested())
+	{
+		for (const FAssetData& AssetData : ChangedAssets)
+		{
+			// Assets that fail to load are not indexed, so they are tried again in the next update.
+			if (!ReloadedPackages.Contains(AssetData.PackageName))
+			{
+				Entries.Remove(AssetData.PackageName);
+			}
+		}
+	}
+
+	RebuildCallers();
+}
+
+TMap<FString, FAssetData> FCallSiteIndex::Find(const FString& ClassNameWithoutPrefix, const FString& FunctionName) const
+{
+	TMap<FString, FAssetData> Result;
+
+	const TArray<FName>* Packages = Callers.Find(MakeFunctionKey(ClassNameWithoutPrefix, FunctionName));
+	if (Packages == nullptr)
+	{
+		return Result;
+	}
+
+	for (FName PackageName : *Packages)
+	{
+		const FAssetData* AssetData = Assets.Find(PackageName);
+		if (AssetData != nullptr)
+		{
+			Result.Add(Entries[PackageName].Record.Name, *AssetData);
+		}
+	}
+
+	return Result;
+}
+
+FName FCallSiteIndex::MakeFunctionKey(const FString& ClassNameWithoutPrefix, const FString& FunctionName)
+{
+	return FName(*FString::Printf(TEXT("%s::%s"), *ClassNameWithoutPrefix, *FunctionName));
+}
+
+FCallSiteRecord FCallSiteIndex::MakeRecord(const UBlueprintGeneratedClass* BlueprintGeneratedClass)
+{
+	FCallSiteRecord Record;
+	Record.Name = BlueprintGeneratedClass->GetName();
+
+	for (const UFunction* Fn : BlueprintGeneratedClass->CalledFunctions)
+	{
+		if (Fn != nullptr && Fn->HasAnyFunctionFlags(EFunctionFlags::FUNC_Native))
+		{
+			Record.CalledFunctions.AddUnique(MakeFunctionKey(Fn->GetOwnerClass()->GetName(), Fn->GetName()));
+		}
+	}
+
+	return Record;
+}
+
+void FCallSiteIndex::RebuildCallers()
+{
+	Callers.Reset();
+	for (const auto& Entry : Entries)
+	{
+		for (FName Function : Entry.Value.Record.CalledFunctions)
+		{
+			Callers.FindOrAdd(Function).Add(Entry.Key);
+		}
+	}
+}
+} // namespace VisualStudioTools
@@ -0,0 +1,86 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "BlueprintIndexCache.h"
+
+class UBlueprintGeneratedClass;
+
+namespace VisualStudioTools
+{
+/**
+* Native functions called from the graphs of a single blueprint.
+*/
+struct FCallSiteRecord
+{
+	/** Name of the blueprint generated class. */
+	FString Name;
+
+	/** Called native functions, as `<OwnerClassName>::<FunctionName>` without the C++ prefix. */
+	TArray<FName> CalledFunctions;
+
+	friend FArchive& operator<<(FArchive& Ar, FCallSiteRecord& Record);
+};
+
+/**
+* Persistent inverted index from native functions to the blueprints that call them,
+* built from `UBlueprintGeneratedClass::CalledFunctions`.
+* Each package is only loaded again when it changed since the index was saved, so queries
+* on an up-to-date index don't load any blueprint.
+*/
+class FCallSiteIndex
+{
+public:
+	FCallSiteIndex();
+
+	/** Loads the index from disk. Returns false if the file is missing, corrupted or outdated. */
+	bool Load(const FString& InFilePath);
+
+	bool Save(const FString& InFilePath);
+
+	/**
+	* Brings the index up to date with the given blueprint assets.
+	* Only the packages that are new or changed are loaded, and the ones that are gone are dropped.
+	* When cancelled, the packages not loaded yet keep their previous entries, to be loaded by the next update.
+	*/
+	void Update(const TArray<FAssetData>& Assets, int32 MaxInFlight, int32 MaxMemoryMB);
+
+	/** Returns the blueprints that call the given function, keyed by their generated class name. */
+	TMap<FString, FAssetData> Find(const FString& ClassNameWithoutPrefix, const FString& FunctionName) const;
+
+	int32 Num() const { return Entries.Num(); }
+
+	/** Makes the key of a native function in the index. */
+	static FName MakeFunctionKey(const FString& ClassNameWithoutPrefix, const FString& FunctionName);
+
+	/** Creates the record of a loaded blueprint. */
+	static FCallSiteRecord MakeRecord(const UBlueprintGeneratedClass* BlueprintGeneratedClass);
+
+private:
+	struct FEntry
+	{
+		FPackageStamp Stamp;
+		FCallSiteRecord Record;
+
+		friend FArchive& operator<<(FArchive& Ar, FEntry& Entry)
+		{
+			return Ar << Entry.Stamp << Entry.Record;
+		}
+	};
+
+	void RebuildCallers();
+
+	FString Signature;
+	TMap<FName, FEntry> Entries;
+	FPackageStamper Stamper;
+
+	/** Packages of the blueprints that call each function. Not persisted, built from the entries. */
+	TMap<FName, TArray<FName>> Callers;
+
+	/** Asset data of the packages passed to the last update. */
+	TMap<FName, FAssetData> Assets;
+};
+} // namespace VisualStudioTools
@@ -0,0 +1,289 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "BlueprintIndexBuilder.h"
+
+#include "UObject/SoftObjectPath.h"
+#include "UObject/UnrealType.h"
+#include "VisualStudioTools.h"
+
+namespace VisualStudioTools
+{
+FClassLayout::FClassLayout(const UClass* Class)
+{
+	for (TFieldIterator<FProperty> It(Class, EFieldIteratorFlags::ExcludeSuper); It; ++It)
+	{
+		FProperty* Property = *It;
+		Properties.Add({ Property, Property->GetOffset_ForInternal(), Property->GetSize(), IsPlainOldData(Property) ? 0 : INDEX_NONE });
+	}
+
+	// Merge the plain-old-data properties that are next to each other in memory.
+	// Small gaps are allowed, since they are usually just alignment padding and an
+	// unexpected difference there only causes a fallback to the per-property check.
+	static constexpr int32 MaxGap = 8;
+
+	TArray<int32> SortedIndices;
+	for (int32 Idx = 0; Idx < Properties.Num(); Idx++)
+	{
+		if (Properties[Idx].Range != INDEX_NONE)
+		{
+			SortedIndices.Add(Idx);
+		}
+	}
+
+	SortedIndices.Sort([this](int32 A, int32 B) { return Properties[A].Offset < Properties[B].Offset; });
+
+	for (int32 Idx : SortedIndices)
+	{
+		FPropertyLayout& Layout = Properties[Idx];
+		if (Ranges.Num() == 0 || Layout.Offset > Ranges.Last().End + MaxGap)
+		{
+			Ranges.Add({ Layout.Offset, Layout.Offset + Layout.Size });
+		}
+		else
+		{
+			Ranges.Last().End = FMath::Max(Ranges.Last().End, Layout.Offset + Layout.Size);
+		}
+
+		Layout.Range = Ranges.Num() - 1;
+	}
+}
+
+bool FClassLayout::IsPlainOldData(const FProperty* Property)
+{
+	// Bitfields share their bytes with other properties, so they can't be compared in bulk.
+	if (const FBoolProperty* BoolProperty = CastField<const FBoolProperty>(Property))
+	{
+		return BoolProperty->IsNativeBool();
+	}
+
+	return Property->HasAnyPropertyFlags(CPF_IsPlainOldData);
+}
+
+FNativeClassInfo::FNativeClassInfo(UClass* Class)
+	: Layout(Class)
+	, DefaultObject(reinterpret_cast<const uint8*>(Class->GetDefaultObject(false)))
+{
+	for (TFieldIterator<UFunction> It(Class, EFieldIteratorFlags::ExcludeSuper); It; ++It)
+	{
+		Functions.Add(It->GetFName());
+	}
+}
+
+const FNativeClassInfo& FNativeClassCache::Get(UClass* Class)
+{
+	TUniquePtr<FNativeClassInfo>& Info = Classes.FindOrAdd(Class);
+	if (!Info.IsValid())
+	{
+		Info = MakeUnique<FNativeClassInfo>(Class);
+	}
+
+	return *Info;
+}
+
+TArray<FProperty*> GetChangedPropertiesList(const FClassLayout& Layout, const uint8* DataPtr, const uint8* DefaultDataPtr)
+{
+	TArray<FProperty*> Result;
+
+	// Lazily computed state of each plain-old-data range: 0 = unknown, 1 = identical, -1 = different.
+	TArray<int8, TInlineAllocator<16>> RangeStates;
+	RangeStates.SetNumZeroed(Layout.Ranges.Num());
+
+	// Walk only in the properties defined in the current class, the super classes are processed individually
+	for (const FClassLayout::FPropertyLayout& PropLayout : Layout.Properties)
+	{
+		FProperty* Property = PropLayout.Property;
+
+		if (PropLayout.Range != INDEX_NONE)
+		{
+			int8& RangeState = RangeStates[PropLayout.Range];
+			if (RangeState == 0)
+			{
+				const FClassLayout::FRange& Range = Layout.Ranges[PropLayout.Range];
+				RangeState = FMemory::Memcmp(DataPtr + Range.Begin, DefaultDataPtr + Range.Begin, Range.End - Range.Begin) == 0 ? 1 : -1;
+			}
+
+			if (RangeState == 1 || FMemory::Memcmp(DataPtr + PropLayout.Offset, DefaultDataPtr + PropLayout.Offset, PropLayout.Size) == 0)
+			{
+				continue;
+			}
+		}
+
+		// The bytes differ or the property is not trivially comparable, so let the property decide.
+		for (int32 Idx = 0; Idx < Property->ArrayDim; Idx++)
+		{
+			const uint8* PropertyValue = Property->ContainerPtrToValuePtr<uint8>(DataPtr, Idx);
+			const uint8* DefaultPropertyValue = Property->ContainerPtrToValuePtr<uint8>(DefaultDataPtr, Idx);
+
+			if (!Property->Identical(PropertyValue, DefaultPropertyValue))
+			{
+				Result.Add(Property);
+				break;
+			}
+		}
+	}
+
+	return Result;
+}
+
+const UClass* FClassResolver::Resolve(const FParentRecord& ParentRecord)
+{
+	if (ParentRecord.Class != nullptr)
+	{
+		return ParentRecord.Class;
+	}
+
+	if (const UClass** Found = ResolvedClasses.Find(ParentRecord.ClassPath))
+	{
+		return *Found;
+	}
+
+	const UClass* Class = FSoftClassPath(ParentRecord.ClassPath.ToString()).ResolveClass();
+	if (Class == nullptr)
+	{
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to find native class '%s'. Skipping."), *ParentRecord.ClassPath.ToString());
+	}
+
+	ResolvedClasses.Add(ParentRecord.ClassPath, Class);
+	return Class;
+}
+
+void FAssetIndex::AddBlueprint(const FBlueprintRecord& Record)
+{
+	int32 BlueprintIndex = Blueprints.Num();
+	bool bHasAnyParent = false;
+
+	for (const FParentRecord& ParentRecord : Record.Parents)
+	{
+		const UClass* Parent = Resolver.Resolve(ParentRecord);
+		if (Parent == nullptr)
+		{
+			continue;
+		}
+
+		bHasAnyParent = true;
+
+		FClassEntry& ClassEntry = Classes.FindOrAdd(Parent);
+		ClassEntry.Class = Parent;
+
+		ClassEntry.Blueprints.Add(BlueprintIndex);
+
+		for (const FPropertyRecord& PropRecord : ParentRecord.Properties)
+		{
+			FPropertyEntry& PropEntry = ClassEntry.Properties.FindOrAdd(PropRecord.Name);
+			if (PropEntry.Property == nullptr)
+			{
+				PropEntry.Property = FindFProperty<FProperty>(Parent, PropRecord.Name);
+				if (PropEntry.Property == nullptr)
+				{
+					ClassEntry.Properties.Remove(PropRecord.Name);
+					continue;
+				}
+			}
+
+			PropEntry.Blueprints.Add(BlueprintIndex);
+			PropEntry.Values.Add(PropRecord.Value);
+		}
+
+		for (FName FnName : ParentRecord.Functions)
+		{
+			ClassEntry.Functions.FindOrAdd(FnName).Blueprints.Add(BlueprintIndex);
+		}
+	}
+
+	if (bHasAnyParent)
+	{
+		check(Blueprints.Add({ Record.Name, Record.Path }) == BlueprintIndex);
+	}
+}
+
+bool ShouldSerializePropertyValue(FProperty* Property)
+{
+	if (Property->ArrayDim > 1) // Skip properties that are not scalars
+	{
+		return false;
+	}
+
+	if (FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property))
+	{
+		return true;
+	}
+
+	if (FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+	{
+		UEnum* EnumDef = NumericProperty->GetIntPropertyEnum();
+		if (EnumDef != NULL)
+		{
+			return true;
+		}
+
+		if (NumericProperty->IsFloatingPoint())
+		{
+			return true;
+		}
+
+		if (NumericProperty->IsInteger())
+		{
+			return true;
+		}
+	}
+
+	if (FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+	{
+		return true;
+	}
+
+	if (FStrProperty* StringProperty = CastField<FStrProperty>(Property))
+	{
+		return true;
+	}
+
+	return false;
+}
+
+FPropertyValue MakePropertyValue(FProperty* Property, const uint8* PropData)
+{
+	FPropertyValue Value;
+	if (!ShouldSerializePropertyValue(Property))
+	{
+		return Value;
+	}
+
+	if (FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property))
+	{
+		// Enums are exported as strings
+		Value.Kind = FPropertyValue::EKind::String;
+		Value.String = EnumProperty->GetEnum()->GetAuthoredNameStringByValue(EnumProperty->GetUnderlyingProperty()->GetSignedIntPropertyValue(PropData));
+	}
+	else if (FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+	{
+		if (UEnum* EnumDef = NumericProperty->GetIntPropertyEnum())
+		{
+			Value.Kind = FPropertyValue::EKind::String;
+			Value.String = EnumDef->GetAuthoredNameStringByValue(NumericProperty->GetSignedIntPropertyValue(PropData));
+		}
+		else if (NumericProperty->IsFloatingPoint())
+		{
+			Value.Kind = FPropertyValue::EKind::Number;
+			Value.Number = NumericProperty->GetFloatingPointPropertyValue(PropData);
+		}
+		else if (NumericProperty->IsInteger())
+		{
+			Value.Kind = FPropertyValue::EKind::Number;
+			Value.Number = static_cast<double>(NumericProperty->GetSignedIntPropertyValue(PropData));
+		}
+	}
+	else if (FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+	{
+		Value.Kind = FPropertyValue::EKind::Bool;
+		Value.bBool = BoolProperty->GetPropertyValue(PropData);
+	}
+	else if (FStrProperty* StringProperty = CastField<FStrProperty>(Property))
+	{
+		Value.Kind = FPropertyValue::EKind::String;
+		Value.String = StringProperty->GetPropertyValue(PropData);
+	}
+
+	return Value;
+}
+} // namespace VisualStudioTools
@@ -0,0 +1,122 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlueprintIndexCache.h"
+
+class FProperty;
+
+namespace VisualStudioTools
+{
+/**
+* Layout of the properties declared in a native class, excluding the super classes.
+* Plain-old-data properties are also grouped in contiguous byte ranges, so the common
+* case of unchanged values can be detected with a single `memcmp` per range.
+*/
+struct FClassLayout
+{
+	struct FPropertyLayout
+	{
+		FProperty* Property;
+		int32 Offset;
+		int32 Size;
+		int32 Range; // Index in `Ranges` or INDEX_NONE if it requires `FProperty::Identical`.
+	};
+
+	struct FRange
+	{
+		int32 Begin;
+		int32 End;
+	};
+
+	TArray<FPropertyLayout> Properties;
+	TArray<FRange> Ranges;
+
+	explicit FClassLayout(const UClass* Class);
+
+private:
+	static bool IsPlainOldData(const FProperty* Property);
+};
+
+/**
+* Data about a native class that does not change during the scan, shared by all the blueprints.
+*/
+struct FNativeClassInfo
+{
+	FClassLayout Layout;
+	TArray<FName> Functions;
+	const uint8* DefaultObject;
+
+	explicit FNativeClassInfo(UClass* Class);
+};
+
+struct FNativeClassCache
+{
+	TMap<const UClass*, TUniquePtr<FNativeClassInfo>> Classes;
+
+	const FNativeClassInfo& Get(UClass* Class);
+};
+
+/** Properties declared in the class of `Layout` whose value in `DataPtr` differs from `DefaultDataPtr`. */
+TArray<FProperty*> GetChangedPropertiesList(const FClassLayout& Layout, const uint8* DataPtr, const uint8* DefaultDataPtr);
+
+struct FPropertyEntry
+{
+	FProperty* Property = nullptr;
+	TArray<int32> Blueprints;
+	TArray<FPropertyValue> Values;
+};
+
+struct FFunctionEntry
+{
+	TArray<int32> Blueprints;
+};
+
+struct FClassEntry
+{
+	const UClass* Class = nullptr;
+	TArray<int32> Blueprints;
+	TMap<FName, FPropertyEntry> Properties;
+	TMap<FName, FFunctionEntry> Functions;
+};
+
+struct FBlueprintEntry
+{
+	FString Name;
+	FString Path;
+};
+
+using ClassMap = TMap<const UClass*, FClassEntry>;
+
+/**
+* Maps the parent records to their native classes. Records created in this process
+* already point to the class, while the ones loaded from the cache only have its path.
+*/
+struct FClassResolver
+{
+	TMap<FName, const UClass*> ResolvedClasses;
+
+	const UClass* Resolve(const FParentRecord& ParentRecord);
+};
+
+struct FAssetIndex
+{
+	TSet<FString> AssetPathCache;
+	ClassMap Classes;
+	TArray<FBlueprintEntry> Blueprints;
+	FClassResolver Resolver;
+
+	void AddBlueprint(const FBlueprintRecord& Record);
+};
+
+/** Returns whether the value of the property is written to the index, which only keeps scalars. */
+bool ShouldSerializePropertyValue(FProperty* Property);
+
+/**
+* Reads the value of the scalar types accepted by `ShouldSerializePropertyValue`, with the same
+* representation as `FJsonObjectConverter::UPropertyToJsonValue`, but without allocating a `FJsonValue`.
+*/
+FPropertyValue MakePropertyValue(FProperty* Property, const uint8* PropData);
+} // namespace VisualStudioTools
@@ -0,0 +1,272 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "BlueprintIndexCache.h"
+
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Blueprint/BlueprintSupport.h"
+#include "HAL/FileManager.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+#include "Serialization/NameAsStringProxyArchive.h"
+#include "VisualStudioTools.h"
+
+namespace VisualStudioTools
+{
+// Bump whenever the layout of the records or the data they capture changes.
+static constexpr uint32 CacheMagic = 0x56534243; // 'VSBC'
+static constexpr uint32 CacheVersion = 2;
+
+// Guard against cycles or unreasonably deep blueprint hierarchies.
+static constexpr int32 MaxAncestorDepth = 32;
+
+FArchive& operator<<(FArchive& Ar, FPropertyValue& Value)
+{
+	uint8 Kind = static_cast<uint8>(Value.Kind);
+	Ar << Kind;
+	Value.Kind = static_cast<FPropertyValue::EKind>(Kind);
+
+	switch (Value.Kind)
+	{
+	case FPropertyValue::EKind::Bool:
+		Ar << Value.bBool;
+		break;
+	case FPropertyValue::EKind::Number:
+		Ar << Value.Number;
+		break;
+	case FPropertyValue::EKind::String:
+		Ar << Value.String;
+		break;
+	default:
+		break;
+	}
+
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FPropertyRecord& Record)
+{
+	return Ar << Record.Name << Record.Value;
+}
+
+FArchive& operator<<(FArchive& Ar, FParentRecord& Record)
+{
+	// The path is only computed when needed, since building it for every blueprint is not free.
+	if (Ar.IsSaving() && Record.ClassPath.IsNone() && Record.Class != nullptr)
+	{
+		Record.ClassPath = *Record.Class->GetPathName();
+	}
+
+	return Ar << Record.ClassPath << Record.Properties << Record.Functions;
+}
+
+FArchive& operator<<(FArchive& Ar, FBlueprintRecord& Record)
+{
+	return Ar << Record.Name << Record.Path << Record.Parents;
+}
+
+FArchive& operator<<(FArchive& Ar, FPackageStamp& Stamp)
+{
+	return Ar << Stamp.Ticks << Stamp.Size << Stamp.AncestorsHash;
+}
+
+/**
+* The records depend on the native classes, so any change in the engine, the plugin
+* or the binaries of the game modules invalidates the whole cache.
+*/
+FString ComputeBuildSignature()
+{
+	FString PluginVersion;
+	if (TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(TEXT("VisualStudioTools")))
+	{
+		PluginVersion = Plugin->GetDescriptor().VersionName;
+	}
+
+	const FString ProjectDir = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir());
+
+	TArray<FModuleStatus> Modules;
+	FModuleManager::Get().QueryModules(Modules);
+	Modules.Sort([](const FModuleStatus& A, const FModuleStatus& B) { return A.Name < B.Name; });
+
+	uint32 ModulesHash = 0;
+	for (const FModuleStatus& Module : Modules)
+	{
+		if (!Module.bIsLoaded || !(Module.bIsGameModule || FPaths::IsUnderDirectory(Module.FilePath, ProjectDir)))
+		{
+			continue;
+		}
+
+		const FFileStatData Stat = IFileManager::Get().GetStatData(*Module.FilePath);
+		ModulesHash = HashCombine(ModulesHash, GetTypeHash(Module.Name));
+		ModulesHash = HashCombine(ModulesHash, GetTypeHash(Stat.ModificationTime.GetTicks()));
+	}
+
+	return FString::Printf(TEXT("%s|%s|%08x"), *FEngineVersion::Current().ToString(), *PluginVersion, ModulesHash);
+}
+
+static bool GetPackageFilePath(const FString& PackageName, FString& OutFilePath)
+{
+	FString PackageFileName;
+	return FPackageName::TryConvertLongPackageNameToFilename(PackageName, PackageFileName)
+		&& FPackageName::FindPackageFileWithoutExtension(PackageFileName, OutFilePath);
+}
+
+FBlueprintIndexCache::FBlueprintIndexCache(const FString& InScanOptions)
+	: Signature(ComputeBuildSignature() + TEXT("|") + InScanOptions)
+{
+}
+
+bool FBlueprintIndexCache::Load(const FString& InFilePath)
+{
+	Entries.Reset();
+
+	TUniquePtr<FArchive> Reader{ IFileManager::Get().CreateFileReader(*InFilePath) };
+	if (!Reader)
+	{
+		return false;
+	}
+
+	FNameAsStringProxyArchive Ar(*Reader);
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	FString FileSignature;
+	Ar << Magic << Version;
+	if (Ar.IsError() || Magic != CacheMagic || Version != CacheVersion)
+	{
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Ignoring incompatible blueprint cache: %s"), *InFilePath);
+		return false;
+	}
+
+	Ar << FileSignature;
+	if (FileSignature != Signature)
+	{
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Blueprint cache is outdated, rebuilding. { Cache: %s, Current: %s }"), *FileSignature, *Signature);
+		return false;
+	}
+
+	Ar << Entries;
+	if (Ar.IsError())
+	{
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to read blueprint cache, rebuilding: %s"), *InFilePath);
+		Entries.Reset();
+		return false;
+	}
+
+	return true;
+}
+
+bool FBlueprintIndexCache::Save(const FString& InFilePath)
+{
+	// Written next to the file and moved over it, so an interrupted save leaves the previous blueprint cache intact.
+	const FString TempFilePath = InFilePath + TEXT(".tmp");
+	TUniquePtr<FArchive> Writer{ IFileManager::Get().CreateFileWriter(*TempFilePath) };
+	if (!Writer)
+	{
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to create blueprint cache with path: %s"), *TempFilePath);
+		return false;
+	}
+
+	FNameAsStringProxyArchive Ar(*Writer);
+
+	uint32 Magic = CacheMagic;
+	uint32 Version = CacheVersion;
+	Ar << Magic << Version << Signature << Entries;
+
+	const bool bWritten = Writer->Close() && !Ar.IsError();
+	Writer.Reset();
+
+	if (!bWritten || !IFileManager::Get().Move(*InFilePath, *TempFilePath))
+	{
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to write blueprint cache with path: %s"), *InFilePath);
+		IFileManager::Get().Delete(*TempFilePath);
+		return false;
+	}
+
+	return true;
+}
+
+FPackageStamp FPackageStamper::GetPackageStamp(const FAssetData& AssetData)
+{
+	return GetPackageStamp(AssetData.PackageName, AssetData.GetTagValueRef<FString>(FBlueprintTags::ParentClassPath), 0);
+}
+
+FPackageStamp FPackageStamper::GetPackageStamp(FName PackageName, const FString& ParentClassPath, int32 Depth)
+{
+	if (const FPackageStamp* Cached = StampCache.Find(PackageName))
+	{
+		return *Cached;
+	}
+
+	FPackageStamp Stamp;
+
+	FString FilePath;
+	if (GetPackageFilePath(PackageName.ToString(), FilePath))
+	{
+		const FFileStatData Stat = IFileManager::Get().GetStatData(*FilePath);
+		if (Stat.bIsValid)
+		{
+			Stamp.Ticks = Stat.ModificationTime.GetTicks();
+			Stamp.Size = Stat.FileSize;
+		}
+	}
+
+	// Blueprint parents live in regular packages, while the native ones are under `/Script/`.
+	const FString ParentPackage = FPackageName::ObjectPathToPackageName(FPackageName::ExportTextPathToObjectPath(ParentClassPath));
+	if (!ParentPackage.IsEmpty() && !ParentPackage.StartsWith(TEXT("/Script/")) && Depth < MaxAncestorDepth)
+	{
+		IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+
+		TArray<FAssetData> ParentAssets;
+		AssetRegistry.GetAssetsByPackageName(*ParentPackage, ParentAssets);
+
+		const FAssetData* ParentAsset = ParentAssets.FindByPredicate([](const FAssetData& Asset)
+			{
+				return Asset.FindTag(FBlueprintTags::ParentClassPath);
+			});
+
+		const FPackageStamp ParentStamp = GetPackageStamp(
+			*ParentPackage,
+			ParentAsset ? ParentAsset->GetTagValueRef<FString>(FBlueprintTags::ParentClassPath) : FString(),
+			Depth + 1);
+
+		Stamp.AncestorsHash = HashCombine(GetTypeHash(ParentStamp.Ticks), GetTypeHash(ParentStamp.Size));
+		Stamp.AncestorsHash = HashCombine(Stamp.AncestorsHash, ParentStamp.AncestorsHash);
+	}
+
+	StampCache.Add(PackageName, Stamp);
+	return Stamp;
+}
+
+const FBlueprintRecord* FBlueprintIndexCache::Find(FName PackageName, const FPackageStamp& Stamp) const
+{
+	const FEntry* Entry = Entries.Find(PackageName);
+	return Entry && Stamp.IsValid() && Entry->Stamp == Stamp ? &Entry->Record : nullptr;
+}
+
+void FBlueprintIndexCache::Update(FName PackageName, const FPackageStamp& Stamp, FBlueprintRecord&& Record)
+{
+	if (!Stamp.IsValid())
+	{
+		return;
+	}
+
+	FEntry& Entry = Entries.FindOrAdd(PackageName);
+	Entry.Stamp = Stamp;
+	Entry.Record = MoveTemp(Record);
+}
+
+void FBlueprintIndexCache::Prune(const TSet<FName>& LivePackages)
+{
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		if (!LivePackages.Contains(It.Key()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+} // namespace VisualStudioTools
@@ -0,0 +1,158 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FAssetData;
+
+namespace VisualStudioTools
+{
+/**
+* Scalar value of a blueprint property, captured from the blueprint CDO.
+* Only the types accepted by the index serialization are represented.
+*/
+struct FPropertyValue
+{
+	enum class EKind : uint8
+	{
+		None,
+		Bool,
+		Number,
+		String,
+	};
+
+	EKind Kind = EKind::None;
+	bool bBool = false;
+	double Number = 0.0;
+	FString String;
+
+	friend FArchive& operator<<(FArchive& Ar, FPropertyValue& Value);
+};
+
+struct FPropertyRecord
+{
+	FName Name;
+	FPropertyValue Value;
+
+	friend FArchive& operator<<(FArchive& Ar, FPropertyRecord& Record);
+};
+
+/**
+* Contribution of a blueprint to a single native parent class:
+* the properties changed in the blueprint CDO and the functions it implements.
+*/
+struct FParentRecord
+{
+	/** Path of the native class, only filled in when the record is persisted or loaded from disk. */
+	FName ClassPath;
+
+	/** Native class, set while the record is created in this process. Not persisted. */
+	const UClass* Class = nullptr;
+
+	TArray<FPropertyRecord> Properties;
+	TArray<FName> Functions;
+
+	friend FArchive& operator<<(FArchive& Ar, FParentRecord& Record);
+};
+
+/**
+* Plain-data contribution of a single blueprint to the index.
+* It only references native classes, so it can outlive the loaded asset and be persisted.
+*/
+struct FBlueprintRecord
+{
+	FString Name;
+	FString Path;
+	TArray<FParentRecord> Parents;
+
+	friend FArchive& operator<<(FArchive& Ar, FBlueprintRecord& Record);
+};
+
+/**
+* Identifies the on-disk state of a blueprint package, including its blueprint ancestors,
+* since changes in a parent blueprint also affect the CDO of the derived ones.
+*/
+struct FPackageStamp
+{
+	int64 Ticks = 0;
+	int64 Size = 0;
+	uint32 AncestorsHash = 0;
+
+	bool IsValid() const { return Size > 0; }
+
+	bool operator==(const FPackageStamp& Other) const
+	{
+		return Ticks == Other.Ticks && Size == Other.Size && AncestorsHash == Other.AncestorsHash;
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FPackageStamp& Stamp);
+};
+
+/**
+* Computes the stamps of blueprint packages. The stamps are memoized, since the packages
+* of the blueprint parents are shared by many blueprints.
+*/
+class FPackageStamper
+{
+public:
+	/** Computes the current stamp of the package that contains the given asset. */
+	FPackageStamp GetPackageStamp(const FAssetData& AssetData);
+
+private:
+	FPackageStamp GetPackageStamp(FName PackageName, const FString& ParentClassPath, int32 Depth);
+
+	TMap<FName, FPackageStamp> StampCache;
+};
+
+/**
+* Identifies the engine, the plugin and the game module binaries, which the cached data depends on.
+*/
+FString ComputeBuildSignature();
+
+/**
+* Persistent cache of blueprint records keyed by package name.
+* The whole cache is discarded when the engine, the plugin or any game module binary changes,
+* or when it was written with different scan options.
+*/
+class FBlueprintIndexCache
+{
+public:
+	explicit FBlueprintIndexCache(const FString& InScanOptions);
+
+	/** Loads the cache from disk. Returns false if the file is missing, corrupted or outdated. */
+	bool Load(const FString& InFilePath);
+
+	bool Save(const FString& InFilePath);
+
+	/** Computes the current stamp of the package that contains the given asset. */
+	FPackageStamp GetPackageStamp(const FAssetData& AssetData) { return Stamper.GetPackageStamp(AssetData); }
+
+	/** Returns the cached record for the package, if it is still up to date. */
+	const FBlueprintRecord* Find(FName PackageName, const FPackageStamp& Stamp) const;
+
+	void Update(FName PackageName, const FPackageStamp& Stamp, FBlueprintRecord&& Record);
+
+	/** Drops any entry that is not in the given set of packages. */
+	void Prune(const TSet<FName>& LivePackages);
+
+	int32 Num() const { return Entries.Num(); }
+
+private:
+	struct FEntry
+	{
+		FPackageStamp Stamp;
+		FBlueprintRecord Record;
+
+		friend FArchive& operator<<(FArchive& Ar, FEntry& Entry)
+		{
+			return Ar << Entry.Stamp << Entry.Record;
+		}
+	};
+
+	FString Signature;
+	TMap<FName, FEntry> Entries;
+	FPackageStamper Stamper;
+};
+} // namespace VisualStudioTools
@@ -0,0 +1,307 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+// Layout of the binary blueprint index written with `-format=binary`.
+// This header does not depend on the engine, so it can be shared with the consumers of the index.
+//
+// The file is little-endian and made of a fixed-size header followed by sections at the offsets
+// listed in the header. Every section starts at an 8-byte aligned offset:
+// - String offsets: `StringCount + 1` uint32 offsets into the string data. String `i` spans [offsets[i], offsets[i+1]).
+// - String data: UTF-8 bytes, without terminators. All names and paths are deduplicated in this table.
+// - Blueprints, classes, properties, functions and values: arrays of the fixed-size records below.
+// - Blueprint references: uint32 blueprint indices, referenced as ranges by the classes and functions.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace VisualStudioTools
+{
+namespace BinaryIndex
+{
+static constexpr uint32_t Magic = 0x49425356; // 'VSBI'
+static constexpr uint32_t Version = 1;
+static constexpr uint32_t InvalidString = 0xFFFFFFFF;
+static constexpr uint64_t SectionAlignment = 8;
+
+enum class EValueKind : uint16_t
+{
+	None,
+	Bool,
+	Number,
+	String,
+};
+
+struct FBinaryHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t StringCount;
+	uint32_t BlueprintCount;
+	uint32_t ClassCount;
+	uint32_t PropertyCount;
+	uint32_t FunctionCount;
+	uint32_t ValueCount;
+	uint32_t BlueprintRefCount;
+	uint32_t Reserved;
+	uint64_t StringOffsetsOffset;
+	uint64_t StringDataOffset;
+	uint64_t BlueprintsOffset;
+	uint64_t ClassesOffset;
+	uint64_t PropertiesOffset;
+	uint64_t FunctionsOffset;
+	uint64_t ValuesOffset;
+	uint64_t BlueprintRefsOffset;
+};
+
+struct FBinaryBlueprint
+{
+	uint32_t Name;
+	uint32_t Path;
+};
+
+struct FBinaryClass
+{
+	uint32_t Name;
+	uint32_t FirstBlueprintRef;
+	uint32_t BlueprintCount;
+	uint32_t FirstProperty;
+	uint32_t PropertyCount;
+	uint32_t FirstFunction;
+	uint32_t FunctionCount;
+	uint32_t Reserved;
+};
+
+struct FBinaryProperty
+{
+	uint32_t Name;
+	uint32_t Categories; // `InvalidString` when the property has no category metadata.
+	uint32_t FirstValue;
+	uint32_t ValueCount;
+};
+
+struct FBinaryFunction
+{
+	uint32_t Name;
+	uint32_t FirstBlueprintRef;
+	uint32_t BlueprintCount;
+	uint32_t Reserved;
+};
+
+struct FBinaryValue
+{
+	uint32_t Blueprint;
+	EValueKind Kind;
+	uint16_t Reserved;
+	uint64_t Payload; // 0/1 for `Bool`, the bits of a double for `Number` and a string index for `String`.
+};
+
+static_assert(sizeof(FBinaryHeader) == 104, "Binary index layout changed");
+static_assert(sizeof(FBinaryBlueprint) == 8, "Binary index layout changed");
+static_assert(sizeof(FBinaryClass) == 32, "Binary index layout changed");
+static_assert(sizeof(FBinaryProperty) == 16, "Binary index layout changed");
+static_assert(sizeof(FBinaryFunction) == 16, "Binary index layout changed");
+static_assert(sizeof(FBinaryValue) == 16, "Binary index layout changed");
+
+/**
+* Read-only view over a binary index in memory, e.g. a memory-mapped file.
+* The records are read in place, nothing is parsed or allocated.
+*/
+class FBinaryIndexReader
+{
+public:
+	/** Validates the header and the bounds of every section. The data must outlive the reader. */
+	bool Open(const void* InData, size_t InSize)
+	{
+		Data = static_cast<const uint8_t*>(InData);
+		Size = InSize;
+
+		if (Data == nullptr || Size < sizeof(FBinaryHeader))
+		{
+			return false;
+		}
+
+		std::memcpy(&Header, Data, sizeof(FBinaryHeader));
+		if (Header.Magic != Magic || Header.Version != Version)
+		{
+			return false;
+		}
+
+		return IsValidSection(Header.StringOffsetsOffset, (uint64_t(Header.StringCount) + 1) * sizeof(uint32_t))
+			&& IsValidSection(Header.StringDataOffset, ReadAt<uint32_t>(Header.StringOffsetsOffset, Header.StringCount))
+			&& IsValidSection(Header.BlueprintsOffset, uint64_t(Header.BlueprintCount) * sizeof(FBinaryBlueprint))
+			&& IsValidSection(Header.ClassesOffset, uint64_t(Header.ClassCount) * sizeof(FBinaryClass))
+			&& IsValidSection(Header.PropertiesOffset, uint64_t(Header.PropertyCount) * sizeof(FBinaryProperty))
+			&& IsValidSection(Header.FunctionsOffset, uint64_t(Header.FunctionCount) * sizeof(FBinaryFunction))
+			&& IsValidSection(Header.ValuesOffset, uint64_t(Header.ValueCount) * sizeof(FBinaryValue))
+			&& IsValidSection(Header.BlueprintRefsOffset, uint64_t(Header.BlueprintRefCount) * sizeof(uint32_t));
+	}
+
+	const FBinaryHeader& GetHeader() const { return Header; }
+
+	std::string_view GetString(uint32_t Index) const
+	{
+		if (Index >= Header.StringCount)
+		{
+			return {};
+		}
+
+		const uint32_t Begin = ReadAt<uint32_t>(Header.StringOffsetsOffset, Index);
+		const uint32_t End = ReadAt<uint32_t>(Header.StringOffsetsOffset, Index + 1);
+		if (Begin > End || Header.StringDataOffset + End > Size)
+		{
+			return {};
+		}
+
+		return std::string_view(reinterpret_cast<const char*>(Data + Header.StringDataOffset + Begin), End - Begin);
+	}
+
+	FBinaryBlueprint GetBlueprint(uint32_t Index) const { return ReadAt<FBinaryBlueprint>(Header.BlueprintsOffset, Index); }
+	FBinaryClass GetClass(uint32_t Index) const { return ReadAt<FBinaryClass>(Header.ClassesOffset, Index); }
+	FBinaryProperty GetProperty(uint32_t Index) const { return ReadAt<FBinaryProperty>(Header.PropertiesOffset, Index); }
+	FBinaryFunction GetFunction(uint32_t Index) const { return ReadAt<FBinaryFunction>(Header.FunctionsOffset, Index); }
+	FBinaryValue GetValue(uint32_t Index) const { return ReadAt<FBinaryValue>(Header.ValuesOffset, Index); }
+	uint32_t GetBlueprintRef(uint32_t Index) const { return ReadAt<uint32_t>(Header.BlueprintRefsOffset, Index); }
+
+	static double GetNumber(const FBinaryValue& Value)
+	{
+		double Number;
+		std::memcpy(&Number, &Value.Payload, sizeof(double));
+		return Number;
+	}
+
+	/** Returns the index of the class with the given C++ name (e.g. `AActor`), or -1. */
+	int64_t FindClass(std::string_view Name) const
+	{
+		for (uint32_t Idx = 0; Idx < Header.ClassCount; Idx++)
+		{
+			if (GetString(GetClass(Idx).Name) == Name)
+			{
+				return Idx;
+			}
+		}
+
+		return -1;
+	}
+
+private:
+	bool IsValidSection(uint64_t Offset, uint64_t Length) const
+	{
+		return Offset % SectionAlignment == 0 && Offset <= Size && Length <= Size - Offset;
+	}
+
+	template <typename T>
+	T ReadAt(uint64_t SectionOffset, uint64_t Index) const
+	{
+		T Result{};
+		const uint64_t Offset = SectionOffset + Index * sizeof(T);
+		if (Offset <= Size && sizeof(T) <= Size - Offset)
+		{
+			std::memcpy(&Result, Data + Offset, sizeof(T));
+		}
+
+		return Result;
+	}
+
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+	FBinaryHeader Header{};
+};
+/**
+* Builds a binary index in memory. The records are added to the public arrays,
+* and the strings they reference are deduplicated by `AddString`.
+*/
+class FBinaryIndexWriter
+{
+public:
+	std::vector<FBinaryBlueprint> Blueprints;
+	std::vector<FBinaryClass> Classes;
+	std::vector<FBinaryProperty> Properties;
+	std::vector<FBinaryFunction> Functions;
+	std::vector<FBinaryValue> Values;
+	std::vector<uint32_t> BlueprintRefs;
+
+	/** Returns the index of the UTF-8 string in the string table, adding it if needed. */
+	uint32_t AddString(std::string_view Value)
+	{
+		const auto Result = StringIds.emplace(std::string(Value), static_cast<uint32_t>(StringIds.size()));
+		if (Result.second)
+		{
+			StringOffsets.push_back(static_cast<uint32_t>(StringData.size()));
+			StringData.insert(StringData.end(), Value.begin(), Value.end());
+		}
+
+		return Result.first->second;
+	}
+
+	/** Appends the whole file to `Out`. */
+	void Write(std::vector<uint8_t>& Out) const
+	{
+		std::vector<uint32_t> Offsets = StringOffsets;
+		Offsets.push_back(static_cast<uint32_t>(StringData.size()));
+
+		FBinaryHeader Header{};
+		Header.Magic = Magic;
+		Header.Version = Version;
+		Header.StringCount = static_cast<uint32_t>(StringOffsets.size());
+		Header.BlueprintCount = static_cast<uint32_t>(Blueprints.size());
+		Header.ClassCount = static_cast<uint32_t>(Classes.size());
+		Header.PropertyCount = static_cast<uint32_t>(Properties.size());
+		Header.FunctionCount = static_cast<uint32_t>(Functions.size());
+		Header.ValueCount = static_cast<uint32_t>(Values.size());
+		Header.BlueprintRefCount = static_cast<uint32_t>(BlueprintRefs.size());
+
+		uint64_t Offset = sizeof(FBinaryHeader);
+		auto PlaceSection = [&Offset](uint64_t& OutSectionOffset, uint64_t Bytes)
+		{
+			OutSectionOffset = (Offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+			Offset = OutSectionOffset + Bytes;
+		};
+
+		PlaceSection(Header.StringOffsetsOffset, Offsets.size() * sizeof(uint32_t));
+		PlaceSection(Header.StringDataOffset, StringData.size());
+		PlaceSection(Header.BlueprintsOffset, Blueprints.size() * sizeof(FBinaryBlueprint));
+		PlaceSection(Header.ClassesOffset, Classes.size() * sizeof(FBinaryClass));
+		PlaceSection(Header.PropertiesOffset, Properties.size() * sizeof(FBinaryProperty));
+		PlaceSection(Header.FunctionsOffset, Functions.size() * sizeof(FBinaryFunction));
+		PlaceSection(Header.ValuesOffset, Values.size() * sizeof(FBinaryValue));
+		PlaceSection(Header.BlueprintRefsOffset, BlueprintRefs.size() * sizeof(uint32_t));
+
+		// The records are written as they are in memory, which matches the little-endian layout of the format.
+		// The padding between the sections is zeroed by the resize.
+		const size_t Start = Out.size();
+		Out.resize(Start + Offset);
+		uint8_t* File = Out.data() + Start;
+
+		auto WriteSection = [File](uint64_t SectionOffset, const void* SectionData, size_t Bytes)
+		{
+			if (Bytes > 0)
+			{
+				std::memcpy(File + SectionOffset, SectionData, Bytes);
+			}
+		};
+
+		WriteSection(0, &Header, sizeof(FBinaryHeader));
+		WriteSection(Header.StringOffsetsOffset, Offsets.data(), Offsets.size() * sizeof(uint32_t));
+		WriteSection(Header.StringDataOffset, StringData.data(), StringData.size());
+		WriteSection(Header.BlueprintsOffset, Blueprints.data(), Blueprints.size() * sizeof(FBinaryBlueprint));
+		WriteSection(Header.ClassesOffset, Classes.data(), Classes.size() * sizeof(FBinaryClass));
+		WriteSection(Header.PropertiesOffset, Properties.data(), Properties.size() * sizeof(FBinaryProperty));
+		WriteSection(Header.FunctionsOffset, Functions.data(), Functions.size() * sizeof(FBinaryFunction));
+		WriteSection(Header.ValuesOffset, Values.data(), Values.size() * sizeof(FBinaryValue));
+		WriteSection(Header.BlueprintRefsOffset, BlueprintRefs.data(), BlueprintRefs.size() * sizeof(uint32_t));
+	}
+
+private:
+	std::unordered_map<std::string, uint32_t> StringIds;
+	std::vector<uint32_t> StringOffsets;
+	std::vector<uint8_t> StringData;
+};
+} // namespace BinaryIndex
+} // namespace VisualStudioTools
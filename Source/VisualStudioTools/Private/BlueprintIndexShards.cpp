@@ -0,0 +1,204 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "BlueprintIndexShards.h"
+
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "CommandletCancellation.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Serialization/NameAsStringProxyArchive.h"
+#include "VisualStudioTools.h"
+
+namespace VisualStudioTools
+{
+// Bump whenever the layout of the shard results changes.
+static constexpr uint32 ShardMagic = 0x56534253; // 'VSBS'
+static constexpr uint32 ShardVersion = 2;
+
+bool FShardSpec::Parse(const FString& InValue)
+{
+	FString IndexString;
+	FString CountString;
+	if (!InValue.Split(TEXT("/"), &IndexString, &CountString) || !IndexString.IsNumeric() || !CountString.IsNumeric())
+	{
+		return false;
+	}
+
+	Index = FCString::Atoi(*IndexString);
+	Count = FCString::Atoi(*CountString);
+	return Count > 0 && Index >= 0 && Index < Count;
+}
+
+TArray<FAssetData> FShardSpec::Select(const TArray<FAssetData>& SortedAssets) const
+{
+	const int64 Num = SortedAssets.Num();
+	const int32 Begin = static_cast<int32>(Num * Index / Count);
+	const int32 End = static_cast<int32>(Num * (Index + 1) / Count);
+
+	TArray<FAssetData> Result;
+	Result.Append(SortedAssets.GetData() + Begin, End - Begin);
+	return Result;
+}
+
+void SortTargetAssets(TArray<FAssetData>& Assets)
+{
+	Assets.Sort([](const FAssetData& A, const FAssetData& B)
+		{
+			const int32 PackageOrder = A.PackageName.Compare(B.PackageName);
+			return PackageOrder != 0 ? PackageOrder < 0 : A.AssetName.Compare(B.AssetName) < 0;
+		});
+}
+
+static FArchive& operator<<(FArchive& Ar, AssetHelpers::FAssetLoadTime& Load)
+{
+	return Ar << Load.Path << Load.Seconds;
+}
+
+static FArchive& operator<<(FArchive& Ar, AssetHelpers::FLoadStats& Stats)
+{
+	return Ar << Stats.PeakUsedMemory << Stats.TotalUsedMemory << Stats.MemorySamples << Stats.GCCount << Stats.GCTime << Stats.SlowestLoads;
+}
+
+bool SaveShardResult(FArchive& Ar, FShardResult& Result)
+{
+	FNameAsStringProxyArchive ProxyAr(Ar);
+
+	uint32 Magic = ShardMagic;
+	uint32 Version = ShardVersion;
+	ProxyAr << Magic << Version << Result.LoadStats << Result.Records;
+
+	return !ProxyAr.IsError();
+}
+
+bool LoadShardResult(const FString& InFilePath, FShardResult& OutResult)
+{
+	TUniquePtr<FArchive> Reader{ IFileManager::Get().CreateFileReader(*InFilePath) };
+	if (!Reader)
+	{
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to open shard result: %s"), *InFilePath);
+		return false;
+	}
+
+	FNameAsStringProxyArchive Ar(*Reader);
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	Ar << Magic << Version;
+	if (Ar.IsError() || Magic != ShardMagic || Version != ShardVersion)
+	{
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Incompatible shard result: %s"), *InFilePath);
+		return false;
+	}
+
+	Ar << OutResult.LoadStats << OutResult.Records;
+	if (Ar.IsError())
+	{
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to read shard result: %s"), *InFilePath);
+		return false;
+	}
+
+	return true;
+}
+
+void MergeLoadStats(AssetHelpers::FLoadStats& Into, const AssetHelpers::FLoadStats& From)
+{
+	Into.PeakUsedMemory = FMath::Max(Into.PeakUsedMemory, From.PeakUsedMemory);
+	Into.TotalUsedMemory += From.TotalUsedMemory;
+	Into.MemorySamples += From.MemorySamples;
+	Into.GCCount += From.GCCount;
+	Into.GCTime += From.GCTime;
+
+	for (const AssetHelpers::FAssetLoadTime& Load : From.SlowestLoads)
+	{
+		Into.AddLoadTime(Load.Path, Load.Seconds);
+	}
+}
+
+bool RunShardProcesses(int32 Count, TFunctionRef<FString(int32 ShardIndex)> GetShardParams, double TimeoutSeconds)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::RunShardProcesses);
+
+	static constexpr float PollIntervalSeconds = 0.1f;
+
+	const FString ExecutablePath = FPlatformProcess::ExecutablePath();
+	const double StartTime = FPlatformTime::Seconds();
+
+	bool bSuccess = true;
+	TArray<FProcHandle> Processes;
+	for (int32 ShardIndex = 0; ShardIndex < Count; ShardIndex++)
+	{
+		const FString Params = GetShardParams(ShardIndex);
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Launching shard [%d/%d]: %s"), ShardIndex + 1, Count, *Params);
+
+		FProcHandle Process = FPlatformProcess::CreateProc(
+			*ExecutablePath, *Params,
+			false /*bLaunchDetached*/, true /*bLaunchHidden*/, true /*bLaunchReallyHidden*/,
+			nullptr /*OutProcessID*/, 0 /*PriorityModifier*/, nullptr /*OptionalWorkingDirectory*/, nullptr /*PipeWriteChild*/);
+
+		if (!Process.IsValid())
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to launch shard [%d/%d]."), ShardIndex + 1, Count);
+			bSuccess = false;
+			break;
+		}
+
+		Processes.Add(Process);
+	}
+
+	// Poll the processes instead of blocking on them, so a cancelled command or a stuck shard does not hang the scan.
+	for (;;)
+	{
+		const bool bAnyRunning = Processes.ContainsByPredicate([](FProcHandle& Process) { return FPlatformProcess::IsProcRunning(Process); });
+		if (!bAnyRunning)
+		{
+			break;
+		}
+
+		const bool bCancelled = IsCancellationRequested();
+		const bool bTimedOut = TimeoutSeconds > 0.0 && FPlatformTime::Seconds() - StartTime > TimeoutSeconds;
+		if (bCancelled || bTimedOut)
+		{
+			if (bCancelled)
+			{
+				UE_LOG(LogVisualStudioTools, Warning, TEXT("Scan cancelled, terminating the shard processes."));
+			}
+			else
+			{
+				UE_LOG(LogVisualStudioTools, Error, TEXT("Shard processes did not finish in %.0fs, terminating them."), TimeoutSeconds);
+			}
+
+			for (FProcHandle& Process : Processes)
+			{
+				if (FPlatformProcess::IsProcRunning(Process))
+				{
+					FPlatformProcess::TerminateProc(Process, true /*KillTree*/);
+				}
+			}
+
+			bSuccess = false;
+			break;
+		}
+
+		FPlatformProcess::Sleep(PollIntervalSeconds);
+	}
+
+	// Reap all the processes that were launched, even after a failure, so none is left behind.
+	for (int32 ShardIndex = 0; ShardIndex < Processes.Num(); ShardIndex++)
+	{
+		FProcHandle& Process = Processes[ShardIndex];
+		FPlatformProcess::WaitForProc(Process);
+
+		int32 ReturnCode = -1;
+		if (!FPlatformProcess::GetProcReturnCode(Process, &ReturnCode) || ReturnCode != 0)
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Shard [%d/%d] failed with code %d."), ShardIndex + 1, Count, ReturnCode);
+			bSuccess = false;
+		}
+
+		FPlatformProcess::CloseProc(Process);
+	}
+
+	return bSuccess;
+}
+} // namespace VisualStudioTools
@@ -0,0 +1,64 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlueprintAssetHelpers.h"
+#include "BlueprintIndexCache.h"
+
+struct FAssetData;
+
+namespace VisualStudioTools
+{
+/**
+* Identifies the subset of the blueprints scanned by one of the processes of a sharded scan.
+*/
+struct FShardSpec
+{
+	int32 Index = 0;
+	int32 Count = 1;
+
+	/** Parses a `<index>/<count>` value, e.g. `0/4`. */
+	bool Parse(const FString& InValue);
+
+	/**
+	* Returns the assets of this shard, as a contiguous range of the sorted assets.
+	* Concatenating the results of all the shards in order gives back the original list.
+	*/
+	TArray<FAssetData> Select(const TArray<FAssetData>& SortedAssets) const;
+};
+
+/**
+* Sorts the assets by package and asset name. The asset registry does not guarantee any order,
+* so this is required for every process to split the assets the same way and to get a stable output.
+*/
+void SortTargetAssets(TArray<FAssetData>& Assets);
+
+/**
+* Data written by a shard process, read back by the coordinator to build the merged index.
+*/
+struct FShardResult
+{
+	AssetHelpers::FLoadStats LoadStats;
+	TArray<FBlueprintRecord> Records;
+};
+
+bool SaveShardResult(FArchive& Ar, FShardResult& Result);
+
+bool LoadShardResult(const FString& InFilePath, FShardResult& OutResult);
+
+/** Combines the memory stats of several processes. The peak is the highest of any process. */
+void MergeLoadStats(AssetHelpers::FLoadStats& Into, const AssetHelpers::FLoadStats& From);
+
+/** Default time limit for all the shard processes to finish. */
+static constexpr double DefaultShardTimeoutSeconds = 60.0 * 60.0;
+
+/**
+* Launches one commandlet process per shard, all of them running at the same time, and waits for them.
+* The processes still running when the command is cancelled or after `TimeoutSeconds` are terminated.
+* A timeout of zero waits for as long as they take.
+* Returns false if any of the processes could not be started or did not succeed.
+*/
+bool RunShardProcesses(int32 Count, TFunctionRef<FString(int32 ShardIndex)> GetShardParams, double TimeoutSeconds);
+} // namespace VisualStudioTools
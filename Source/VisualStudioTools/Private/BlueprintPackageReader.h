@@ -0,0 +1,649 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+// Reads the asset registry tags saved in the header of `.uasset` packages, without the engine.
+// This header does not depend on the engine, so the consumers of the index can use it to find the
+// blueprints derived from native classes without launching the commandlet.
+//
+// Only the data needed to reach the asset registry section of editor packages is parsed:
+// - Cooked (filtered editor-only) and unversioned packages are rejected.
+// - Any layout this reader does not know about fails the read, instead of returning partial data,
+//   so the callers can fall back to the commandlet.
+// The tags only name the closest native parent of each blueprint. The native class hierarchy, the
+// changed properties and the implemented functions still require the `VisualStudioTools` commandlet.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace VisualStudioTools
+{
+namespace PackageReader
+{
+static constexpr uint32_t PackageFileTag = 0x9E2A83C1;
+static constexpr uint32_t PackageFlagFilterEditorOnly = 0x80000000;
+
+// Oldest and newest `LegacyFileVersion` values with a known layout.
+static constexpr int32_t OldestLegacyFileVersion = -9;
+static constexpr int32_t NewestLegacyFileVersion = -2;
+
+// Object versions that changed the layout of the package summary or the asset registry data.
+namespace UE4Version
+{
+static constexpr int32_t OldestLoadable = 214;
+static constexpr int32_t EngineVersionObject = 336;
+static constexpr int32_t AddStringAssetReferencesMap = 384;
+static constexpr int32_t PackageSummaryHasCompatibleEngineVersion = 444;
+static constexpr int32_t SerializeTextInPackages = 459;
+static constexpr int32_t AddedSearchableNames = 510;
+static constexpr int32_t AddedPackageSummaryLocalizationId = 516;
+static constexpr int32_t AddedPackageOwner = 518;
+static constexpr int32_t NonOuterPackageImport = 520;
+static constexpr int32_t AssetRegistryDependencyFlags = 521;
+}
+
+namespace UE5Version
+{
+static constexpr int32_t AddSoftObjectPathList = 1008;
+static constexpr int32_t MetadataSerializationOffset = 1014;
+static constexpr int32_t VerseCells = 1015;
+static constexpr int32_t PackageSavedHash = 1016;
+}
+
+// Names of the blueprint tags, same as `FBlueprintTags`.
+static constexpr std::string_view GeneratedClassTag = "GeneratedClass";
+static constexpr std::string_view ParentClassTag = "ParentClass";
+static constexpr std::string_view NativeParentClassTag = "NativeParentClass";
+
+/**
+* Tags of a single object in the package, as saved for the asset registry.
+*/
+struct FAssetTags
+{
+	std::string ObjectPath;
+	std::string ClassName;
+	std::vector<std::pair<std::string, std::string>> Tags;
+
+	const std::string* FindTag(std::string_view Key) const
+	{
+		for (const auto& Tag : Tags)
+		{
+			if (Tag.first == Key)
+			{
+				return &Tag.second;
+			}
+		}
+
+		return nullptr;
+	}
+};
+
+/**
+* Little-endian reader with bounds checks. Any failure is sticky, so the callers only check at the end.
+*/
+class FPackageArchive
+{
+public:
+	FPackageArchive(const void* InData, size_t InSize)
+		: Data(static_cast<const uint8_t*>(InData))
+		, Size(InData != nullptr ? InSize : 0)
+	{
+	}
+
+	bool IsError() const { return bError; }
+	size_t Tell() const { return Offset; }
+
+	void Seek(int64_t InOffset)
+	{
+		if (InOffset < 0 || static_cast<uint64_t>(InOffset) > Size)
+		{
+			bError = true;
+			return;
+		}
+
+		Offset = static_cast<size_t>(InOffset);
+	}
+
+	void Skip(uint64_t Bytes)
+	{
+		if (bError || Bytes > Size - Offset)
+		{
+			bError = true;
+			return;
+		}
+
+		Offset += static_cast<size_t>(Bytes);
+	}
+
+	template <typename T>
+	T Read()
+	{
+		T Value{};
+		if (bError || sizeof(T) > Size - Offset)
+		{
+			bError = true;
+			return Value;
+		}
+
+		std::memcpy(&Value, Data + Offset, sizeof(T));
+		Offset += sizeof(T);
+		return Value;
+	}
+
+	/** Skips an array of fixed-size elements, prefixed by its int32 length. */
+	void SkipArray(uint64_t ElementSize)
+	{
+		const int32_t Count = Read<int32_t>();
+		if (Count < 0)
+		{
+			bError = true;
+			return;
+		}
+
+		Skip(uint64_t(Count) * ElementSize);
+	}
+
+	/** Reads a `FString`, converted to UTF-8. Positive lengths are Latin-1, negative lengths UTF-16. */
+	std::string ReadString()
+	{
+		std::string Result;
+		const int32_t Len = Read<int32_t>();
+		if (bError || Len == 0)
+		{
+			return Result;
+		}
+
+		if (Len > 0)
+		{
+			if (uint64_t(Len) > Size - Offset)
+			{
+				bError = true;
+				return Result;
+			}
+
+			for (int32_t Idx = 0; Idx < Len - 1; Idx++)
+			{
+				AppendUtf8(Result, Data[Offset + Idx]);
+			}
+
+			Offset += Len;
+			return Result;
+		}
+
+		const uint64_t Count = uint64_t(-int64_t(Len));
+		if (Count * 2 > Size - Offset)
+		{
+			bError = true;
+			return Result;
+		}
+
+		for (uint64_t Idx = 0; Idx + 1 < Count; Idx++)
+		{
+			uint32_t CodePoint = ReadUtf16(Idx);
+			if (CodePoint >= 0xD800 && CodePoint < 0xDC00 && Idx + 2 < Count)
+			{
+				const uint32_t Low = ReadUtf16(Idx + 1);
+				if (Low >= 0xDC00 && Low < 0xE000)
+				{
+					CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (Low - 0xDC00);
+					Idx++;
+				}
+			}
+
+			AppendUtf8(Result, CodePoint);
+		}
+
+		Offset += static_cast<size_t>(Count * 2);
+		return Result;
+	}
+
+private:
+	uint32_t ReadUtf16(uint64_t Idx) const
+	{
+		const uint8_t* Unit = Data + Offset + Idx * 2;
+		return uint32_t(Unit[0]) | (uint32_t(Unit[1]) << 8);
+	}
+
+	static void AppendUtf8(std::string& Out, uint32_t CodePoint)
+	{
+		if (CodePoint < 0x80)
+		{
+			Out += char(CodePoint);
+		}
+		else if (CodePoint < 0x800)
+		{
+			Out += char(0xC0 | (CodePoint >> 6));
+			Out += char(0x80 | (CodePoint & 0x3F));
+		}
+		else if (CodePoint < 0x10000)
+		{
+			Out += char(0xE0 | (CodePoint >> 12));
+			Out += char(0x80 | ((CodePoint >> 6) & 0x3F));
+			Out += char(0x80 | (CodePoint & 0x3F));
+		}
+		else
+		{
+			Out += char(0xF0 | (CodePoint >> 18));
+			Out += char(0x80 | ((CodePoint >> 12) & 0x3F));
+			Out += char(0x80 | ((CodePoint >> 6) & 0x3F));
+			Out += char(0x80 | (CodePoint & 0x3F));
+		}
+	}
+
+	const uint8_t* Data;
+	size_t Size;
+	size_t Offset = 0;
+	bool bError = false;
+};
+
+/**
+* Fields of `FPackageFileSummary` needed to read the asset registry data.
+*/
+struct FPackageSummary
+{
+	int32_t LegacyFileVersion = 0;
+	int32_t FileVersionUE4 = 0;
+	int32_t FileVersionUE5 = 0;
+	uint32_t PackageFlags = 0;
+	int32_t AssetRegistryDataOffset = 0;
+
+	bool IsFilterEditorOnly() const { return (PackageFlags & PackageFlagFilterEditorOnly) != 0; }
+	int32_t GetFileVersion() const { return FileVersionUE5 != 0 ? FileVersionUE5 : FileVersionUE4; }
+};
+
+/** Reads the package summary, following the same order as `operator<<(FArchive&, FPackageFileSummary&)`. */
+inline bool ReadPackageSummary(FPackageArchive& Ar, FPackageSummary& Sum)
+{
+	if (Ar.Read<uint32_t>() != PackageFileTag)
+	{
+		return false;
+	}
+
+	Sum.LegacyFileVersion = Ar.Read<int32_t>();
+	if (Sum.LegacyFileVersion < OldestLegacyFileVersion || Sum.LegacyFileVersion > NewestLegacyFileVersion)
+	{
+		return false;
+	}
+
+	if (Sum.LegacyFileVersion != -4)
+	{
+		Ar.Read<int32_t>(); // LegacyUE3Version
+	}
+
+	Sum.FileVersionUE4 = Ar.Read<int32_t>();
+	if (Sum.LegacyFileVersion <= -8)
+	{
+		Sum.FileVersionUE5 = Ar.Read<int32_t>();
+	}
+
+	Ar.Read<int32_t>(); // FileVersionLicenseeUE
+
+	// Custom versions: enum-based, guid-based with a friendly name, or the optimized guid-based format.
+	const int32_t CustomVersionCount = Ar.Read<int32_t>();
+	for (int32_t Idx = 0; Idx < CustomVersionCount && !Ar.IsError(); Idx++)
+	{
+		if (Sum.LegacyFileVersion == -2)
+		{
+			Ar.Skip(8);
+		}
+		else if (Sum.LegacyFileVersion >= -5)
+		{
+			Ar.Skip(20);
+			Ar.ReadString();
+		}
+		else
+		{
+			Ar.Skip(20);
+		}
+	}
+
+	// Unversioned packages can only be read with the exact engine that saved them.
+	if (CustomVersionCount < 0 || Sum.FileVersionUE4 < UE4Version::OldestLoadable)
+	{
+		return false;
+	}
+
+	const int32_t UE4 = Sum.FileVersionUE4;
+	const int32_t UE5 = Sum.FileVersionUE5;
+
+	if (UE5 >= UE5Version::PackageSavedHash)
+	{
+		Ar.Skip(20); // SavedHash
+	}
+
+	Ar.Read<int32_t>(); // TotalHeaderSize
+	Ar.ReadString(); // PackageName
+	Sum.PackageFlags = Ar.Read<uint32_t>();
+	Ar.Skip(8); // NameCount, NameOffset
+
+	if (UE5 >= UE5Version::AddSoftObjectPathList)
+	{
+		Ar.Skip(8); // SoftObjectPathsCount, SoftObjectPathsOffset
+	}
+
+	if (!Sum.IsFilterEditorOnly() && UE4 >= UE4Version::AddedPackageSummaryLocalizationId)
+	{
+		Ar.ReadString(); // LocalizationId
+	}
+
+	if (UE4 >= UE4Version::SerializeTextInPackages)
+	{
+		Ar.Skip(8); // GatherableTextDataCount, GatherableTextDataOffset
+	}
+
+	Ar.Skip(16); // ExportCount, ExportOffset, ImportCount, ImportOffset
+
+	if (UE5 >= UE5Version::VerseCells)
+	{
+		Ar.Skip(16); // CellExportCount, CellExportOffset, CellImportCount, CellImportOffset
+	}
+
+	if (UE5 >= UE5Version::MetadataSerializationOffset)
+	{
+		Ar.Skip(4); // MetaDataOffset
+	}
+
+	Ar.Skip(4); // DependsOffset
+
+	if (UE4 >= UE4Version::AddStringAssetReferencesMap)
+	{
+		Ar.Skip(8); // SoftPackageReferencesCount, SoftPackageReferencesOffset
+	}
+
+	if (UE4 >= UE4Version::AddedSearchableNames)
+	{
+		Ar.Skip(4); // SearchableNamesOffset
+	}
+
+	Ar.Skip(4); // ThumbnailTableOffset
+
+	if (UE5 < UE5Version::PackageSavedHash)
+	{
+		Ar.Skip(16); // Guid
+	}
+
+	if (!Sum.IsFilterEditorOnly())
+	{
+		if (UE4 >= UE4Version::AddedPackageOwner)
+		{
+			Ar.Skip(16); // PersistentGuid
+		}
+
+		if (UE4 >= UE4Version::AddedPackageOwner && UE4 < UE4Version::NonOuterPackageImport)
+		{
+			Ar.Skip(16); // OwnerPersistentGuid
+		}
+	}
+
+	Ar.SkipArray(8); // Generations: ExportCount, NameCount
+
+	if (UE4 >= UE4Version::EngineVersionObject)
+	{
+		Ar.Skip(10); // SavedByEngineVersion: Major, Minor, Patch, Changelist
+		Ar.ReadString(); // Branch
+	}
+	else
+	{
+		Ar.Skip(4); // EngineChangelist
+	}
+
+	if (UE4 >= UE4Version::PackageSummaryHasCompatibleEngineVersion)
+	{
+		Ar.Skip(10); // CompatibleWithEngineVersion: Major, Minor, Patch, Changelist
+		Ar.ReadString(); // Branch
+	}
+
+	Ar.Skip(4); // CompressionFlags
+
+	// Compressed packages are no longer supported by the engine.
+	if (Ar.Read<int32_t>() != 0)
+	{
+		return false;
+	}
+
+	Ar.Skip(4); // PackageSource
+
+	const int32_t AdditionalPackagesToCook = Ar.Read<int32_t>();
+	for (int32_t Idx = 0; Idx < AdditionalPackagesToCook && !Ar.IsError(); Idx++)
+	{
+		Ar.ReadString();
+	}
+
+	if (Sum.LegacyFileVersion > -7)
+	{
+		Ar.Skip(4); // NumTextureAllocations
+	}
+
+	Sum.AssetRegistryDataOffset = Ar.Read<int32_t>();
+
+	return !Ar.IsError() && AdditionalPackagesToCook >= 0;
+}
+
+/**
+* Reads the asset registry tags of every asset in an editor package (`.uasset` or `.umap`).
+* Returns false if the package can't be read, in which case `OutAssets` is left unchanged.
+*/
+inline bool ReadAssetTags(const void* Data, size_t Size, std::vector<FAssetTags>& OutAssets)
+{
+	FPackageArchive Ar(Data, Size);
+
+	FPackageSummary Sum;
+	if (!ReadPackageSummary(Ar, Sum) || Sum.IsFilterEditorOnly() || Sum.AssetRegistryDataOffset <= 0)
+	{
+		return false;
+	}
+
+	Ar.Seek(Sum.AssetRegistryDataOffset);
+
+	if (Sum.FileVersionUE4 >= UE4Version::AssetRegistryDependencyFlags)
+	{
+		Ar.Skip(8); // DependencyDataOffset
+	}
+
+	// Each asset takes at least 12 bytes, which bounds the count of a corrupted package.
+	const int32_t ObjectCount = Ar.Read<int32_t>();
+	if (Ar.IsError() || ObjectCount < 0 || uint64_t(ObjectCount) * 12 > Size - Ar.Tell())
+	{
+		return false;
+	}
+
+	std::vector<FAssetTags> Assets(ObjectCount);
+	for (FAssetTags& Asset : Assets)
+	{
+		Asset.ObjectPath = Ar.ReadString();
+		Asset.ClassName = Ar.ReadString();
+
+		const int32_t TagCount = Ar.Read<int32_t>();
+		if (Ar.IsError() || TagCount < 0 || uint64_t(TagCount) * 8 > Size - Ar.Tell())
+		{
+			return false;
+		}
+
+		Asset.Tags.resize(TagCount);
+		for (auto& Tag : Asset.Tags)
+		{
+			Tag.first = Ar.ReadString();
+			Tag.second = Ar.ReadString();
+		}
+	}
+
+	if (Ar.IsError())
+	{
+		return false;
+	}
+
+	OutAssets.insert(OutAssets.end(), std::make_move_iterator(Assets.begin()), std::make_move_iterator(Assets.end()));
+	return true;
+}
+
+/** Converts an export text path, e.g. `/Script/CoreUObject.Class'/Script/Engine.Actor'`, to an object path. */
+inline std::string ExportTextPathToObjectPath(std::string_view Path)
+{
+	const size_t Open = Path.find('\'');
+	if (Open != std::string_view::npos && Path.size() > Open + 1 && Path.back() == '\'')
+	{
+		return std::string(Path.substr(Open + 1, Path.size() - Open - 2));
+	}
+
+	return std::string(Path);
+}
+
+/** Returns the object name of an object path, e.g. `Actor` for `/Script/Engine.Actor`. */
+inline std::string_view GetObjectName(std::string_view ObjectPath)
+{
+	const size_t Separator = ObjectPath.find_last_of(".:");
+	return Separator != std::string_view::npos ? ObjectPath.substr(Separator + 1) : ObjectPath;
+}
+
+/**
+* Builds the `blueprints` and `classes[].blueprints` sections of the index from the package tags.
+* Blueprints are only listed under their closest native parent, since the tags don't describe the
+* native class hierarchy. The blueprints are listed in the order their packages were added.
+*/
+class FBlueprintIndexBuilder
+{
+public:
+	/** Maps a native class path to the name written to the index. Defaults to the object name, without the C++ prefix. */
+	using FClassNameResolver = std::function<std::string(std::string_view ClassPath)>;
+
+	/** Adds the blueprints of a package. Returns false if the package could not be read. */
+	bool AddPackage(const void* Data, size_t Size)
+	{
+		std::vector<FAssetTags> Assets;
+		if (!ReadAssetTags(Data, Size, Assets))
+		{
+			return false;
+		}
+
+		for (const FAssetTags& Asset : Assets)
+		{
+			AddAsset(Asset);
+		}
+
+		return true;
+	}
+
+	void AddAsset(const FAssetTags& Asset)
+	{
+		const std::string* GeneratedClass = Asset.FindTag(GeneratedClassTag);
+		const std::string* NativeParentClass = Asset.FindTag(NativeParentClassTag);
+		if (GeneratedClass == nullptr || NativeParentClass == nullptr)
+		{
+			return;
+		}
+
+		const std::string BlueprintPath = ExportTextPathToObjectPath(*GeneratedClass);
+		const std::string NativeParentPath = ExportTextPathToObjectPath(*NativeParentClass);
+		if (BlueprintPath.empty() || NativeParentPath.empty())
+		{
+			return;
+		}
+
+		const uint32_t BlueprintIndex = static_cast<uint32_t>(Blueprints.size());
+		Blueprints.push_back({ std::string(GetObjectName(BlueprintPath)), BlueprintPath });
+
+		auto Inserted = ClassIndices.emplace(NativeParentPath, Classes.size());
+		if (Inserted.second)
+		{
+			Classes.push_back({ NativeParentPath, {} });
+		}
+
+		Classes[Inserted.first->second].Blueprints.push_back(BlueprintIndex);
+	}
+
+	size_t GetBlueprintCount() const { return Blueprints.size(); }
+
+	/** Writes a JSON object with the same `blueprints` and `classes` layout as the `VisualStudioTools` commandlet. */
+	std::string ToJson(const FClassNameResolver& ResolveClassName = nullptr) const
+	{
+		std::string Json = "{\"blueprints\":[";
+		for (size_t Idx = 0; Idx < Blueprints.size(); Idx++)
+		{
+			Json += Idx > 0 ? ",{\"name\":" : "{\"name\":";
+			AppendJsonString(Json, Blueprints[Idx].Name);
+			Json += ",\"path\":";
+			AppendJsonString(Json, Blueprints[Idx].Path);
+			Json += '}';
+		}
+
+		Json += "],\"classes\":[";
+		for (size_t Idx = 0; Idx < Classes.size(); Idx++)
+		{
+			const FClass& Class = Classes[Idx];
+			Json += Idx > 0 ? ",{\"name\":" : "{\"name\":";
+			AppendJsonString(Json, ResolveClassName ? ResolveClassName(Class.Path) : std::string(GetObjectName(Class.Path)));
+			Json += ",\"blueprints\":[";
+			for (size_t BlueprintIdx = 0; BlueprintIdx < Class.Blueprints.size(); BlueprintIdx++)
+			{
+				if (BlueprintIdx > 0)
+				{
+					Json += ',';
+				}
+
+				Json += std::to_string(Class.Blueprints[BlueprintIdx]);
+			}
+			Json += "]}";
+		}
+
+		Json += "]}";
+		return Json;
+	}
+
+private:
+	static void AppendJsonString(std::string& Json, std::string_view Value)
+	{
+		static constexpr char HexDigits[] = "0123456789abcdef";
+
+		Json += '"';
+		for (const char Char : Value)
+		{
+			switch (Char)
+			{
+			case '"': Json += "\\\""; break;
+			case '\\': Json += "\\\\"; break;
+			case '\n': Json += "\\n"; break;
+			case '\r': Json += "\\r"; break;
+			case '\t': Json += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(Char) < 0x20)
+				{
+					Json += "\\u00";
+					Json += HexDigits[(Char >> 4) & 0xF];
+					Json += HexDigits[Char & 0xF];
+				}
+				else
+				{
+					Json += Char;
+				}
+				break;
+			}
+		}
+		Json += '"';
+	}
+
+	struct FBlueprint
+	{
+		std::string Name;
+		std::string Path;
+	};
+
+	struct FClass
+	{
+		std::string Path;
+		std::vector<uint32_t> Blueprints;
+	};
+
+	std::vector<FBlueprint> Blueprints;
+	std::vector<FClass> Classes;
+	std::map<std::string, size_t, std::less<>> ClassIndices;
+};
+} // namespace PackageReader
+} // namespace VisualStudioTools
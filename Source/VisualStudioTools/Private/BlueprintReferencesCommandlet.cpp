@@ -3,13 +3,16 @@
 
 #include "BlueprintReferencesCommandlet.h"
 
-#include "Algo/Find.h"
 #include "Algo/Transform.h"
 #include "AssetRegistry/AssetRegistryModule.h"
 #include "BlueprintAssetHelpers.h"
+#include "BlueprintCallSiteIndex.h"
+#include "CommandletCancellation.h"
+#include "CommandletPerf.h"
 #include "Engine/BlueprintGeneratedClass.h"
 #include "FindInBlueprintManager.h"
 #include "JsonObjectConverter.h"
+#include "Misc/FileHelper.h"
 #include "Misc/Paths.h"
 #include "Misc/ScopeExit.h"
 #include "Policies/CondensedJsonPrintPolicy.h"
@@ -55,24 +58,179 @@ static FString StripClassPrefix(const FString& InClassName)
 	return InClassName.RightChop(PrefixSize);
 }
 
+/**
+* Native function searched for in the blueprints, given as `NativeClassName::FunctionName`.
+*/
+struct FSymbolQuery
+{
+	FString Symbol;
+	FString ClassNameWithoutPrefix;
+	FString FunctionName;
+
+	bool Parse(const FString& InSymbol)
+	{
+		FString ClassNameNative;
+		if (!InSymbol.Split(TEXT("::"), &ClassNameNative, &FunctionName) || ClassNameNative.IsEmpty() || FunctionName.IsEmpty())
+		{
+			return false;
+		}
+
+		Symbol = InSymbol;
+		ClassNameWithoutPrefix = StripClassPrefix(ClassNameNative);
+		return true;
+	}
+};
+
+/**
+* Reads the symbols to search for from a file, with one symbol per line. Empty lines are ignored.
+*/
+static bool ReadSymbolsFile(const FString& InFilePath, TArray<FSymbolQuery>& OutQueries)
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *InFilePath))
+	{
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to read symbols file: %s"), *InFilePath);
+		return false;
+	}
+
+	TSet<FString> Symbols;
+	for (const FString& Line : Lines)
+	{
+		const FString Symbol = Line.TrimStartAndEnd();
+		if (Symbol.IsEmpty() || Symbols.Contains(Symbol))
+		{
+			continue;
+		}
+
+		FSymbolQuery Query;
+		if (!Query.Parse(Symbol))
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Invalid symbol '%s' in %s."), *Symbol, *InFilePath);
+			return false;
+		}
+
+		Symbols.Add(Symbol);
+		OutQueries.Add(MoveTemp(Query));
+	}
+
+	return true;
+}
+
+/**
+* Creates a FiB search query for function nodes where the native name matches any of the requested symbols.
+*/
+static FString MakeSearchQuery(const TArray<FSymbolQuery>& Queries)
+{
+	TSet<FString> FunctionNames;
+	TArray<FString> Terms;
+	for (const FSymbolQuery& Query : Queries)
+	{
+		if (!FunctionNames.Contains(Query.FunctionName))
+		{
+			FunctionNames.Add(Query.FunctionName);
+			Terms.Add(FString::Printf(TEXT("Nodes(\"Native Name\"=+%s & ClassName=K2Node_CallFunction)"), *Query.FunctionName));
+		}
+	}
+
+	return FString::Join(Terms, TEXT(" || "));
+}
+
+/**
+* Describes how the search went, so that incomplete results can be told apart in the output.
+*/
+struct FSearchMetadata
+{
+	/** Number of blueprints the results were taken from. */
+	int32 AssetCount = 0;
+
+	/** False if the search was stopped by the timeout or cancelled, and the results are partial. */
+	bool bComplete = true;
+
+	/** Blueprints without search data, which FindInBlueprints cannot match until they are re-saved. */
+	int32 UnindexedAssetCount = 0;
+
+	/** Blueprints whose search data still had to be cached when the search finished. */
+	int32 UncachedAssetCount = 0;
+
+	/** Time spent finding the candidates, either with FindInBlueprints or by updating the index. */
+	FPerfTime Search;
+
+	/** Time spent loading the candidates to confirm the matches. */
+	FPerfTime Confirm;
+};
+
+/** Time between the ticks of the search manager while waiting for the search thread. */
+static constexpr float SearchTickInterval = 0.01f;
+
+/** Time between the progress messages of a search. */
+static constexpr double SearchProgressInterval = 5.0;
+
 /**
 * Retrieves the asset data matching the given FindInBlueprints query.
+* The search stops after `TimeoutSeconds`, if positive, or when the command is cancelled,
+* and the items found up to that point are returned.
 */
-TArray<FAssetData> SearchForCandidateAssets(const FString& SearchQuery)
+TArray<FAssetData> SearchForCandidateAssets(
+	const FString& SearchQuery, double TimeoutSeconds, FSearchMetadata& OutMetadata)
 {
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::SearchForCandidateAssets);
+
 	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
-	AssetRegistry.SearchAllAssets(true);
+
+	FFindInBlueprintSearchManager& SearchManager = FFindInBlueprintSearchManager::Get();
+
+	const double StartTime = FPlatformTime::Seconds();
+	double NextProgressTime = StartTime + SearchProgressInterval;
 
 	TArray<FSearchResult> OutItemsFound;
 	FStreamSearch StreamSearch(SearchQuery);
 	while (!StreamSearch.IsComplete())
 	{
-		FFindInBlueprintSearchManager::Get().Tick(0.0);
+		// The search runs in its own thread, the game thread only needs to keep the manager ticking.
+		SearchManager.Tick(SearchTickInterval);
+		FPlatformProcess::Sleep(SearchTickInterval);
+
+		const double Now = FPlatformTime::Seconds();
+		if (IsCancellationRequested())
+		{
+			UE_LOG(LogVisualStudioTools, Warning, TEXT("Blueprint search cancelled."));
+			break;
+		}
+
+		if (TimeoutSeconds > 0.0 && Now - StartTime >= TimeoutSeconds)
+		{
+			UE_LOG(LogVisualStudioTools, Warning, TEXT("Blueprint search timed out after %.1fs."), Now - StartTime);
+			break;
+		}
+
+		if (Now >= NextProgressTime)
+		{
+			UE_LOG(LogVisualStudioTools, Display, TEXT("Blueprint search: %.0f%% complete, %d assets left to cache."),
+				StreamSearch.GetPercentComplete() * 100.0f, SearchManager.GetNumberUncachedAssets());
+			NextProgressTime = Now + SearchProgressInterval;
+		}
 	}
 
-	// Execute the search and get all the assets in the result.
+	// Take the items found so far while the search thread may still be running: `EnsureCompletion` empties
+	// the items not collected yet before stopping it, which would drop the partial results.
+	// The completion is checked first, so a search that completes in between is still treated as partial.
+	const bool bSearchComplete = StreamSearch.IsComplete();
 	StreamSearch.GetFilteredItems(OutItemsFound);
 
+	if (!bSearchComplete)
+	{
+		OutMetadata.bComplete = false;
+
+		// `FStreamSearch` has no cancellation of its own, it's stopped as an `FRunnable`.
+		StreamSearch.Stop();
+		StreamSearch.EnsureCompletion();
+	}
+
+	OutMetadata.UnindexedAssetCount = SearchManager.GetNumberUnindexedAssets();
+	OutMetadata.UncachedAssetCount = SearchManager.GetNumberUncachedAssets();
+
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Blueprint search finished in %.1fs. { Unindexed: %d, Uncached: %d }"),
+		FPlatformTime::Seconds() - StartTime, OutMetadata.UnindexedAssetCount, OutMetadata.UncachedAssetCount);
 
 	TArray<FAssetData> OutTargetAssets;
 	Algo::Transform(OutItemsFound, OutTargetAssets,
@@ -92,36 +250,89 @@ TArray<FAssetData> SearchForCandidateAssets(const FString& SearchQuery)
 
 /**
 * Loads each blueprint asset and filters the collection to items which use the 
-* target UFunction in their call graph, matching the native class and function names.
+* target UFunctions in their call graph, matching the native class and function names.
+* Each asset is loaded once and checked against all the queries. The results are in the order of the queries.
+* `OnConfirmed` is called as soon as each match is found, before the remaining assets are loaded.
 */
-TMap<FString, FAssetData> GetConfirmedAssets(
-	const FString& FunctionName, const FString& ClassNameWithoutPrefix, const TArray<FAssetData>& InAssets)
+TArray<TMap<FString, FAssetData>> GetConfirmedAssets(
+	const TArray<FSymbolQuery>& Queries, const TArray<FAssetData>& InAssets, int32 MaxInFlight, int32 MaxMemoryMB,
+	TFunctionRef<void(int32 QueryIndex, const FString& BlueprintClassName, const FAssetData& AssetData)> OnConfirmed)
 {
-	TMap<FString, FAssetData> OutResults;
+	TArray<TMap<FString, FAssetData>> OutResults;
+	OutResults.SetNum(Queries.Num());
+
+	TMap<FName, int32> QueryIndexByKey;
+	for (int32 QueryIndex = 0; QueryIndex < Queries.Num(); QueryIndex++)
+	{
+		QueryIndexByKey.Add(FCallSiteIndex::MakeFunctionKey(Queries[QueryIndex].ClassNameWithoutPrefix, Queries[QueryIndex].FunctionName), QueryIndex);
+	}
 
 	AssetHelpers::ForEachAsset(InAssets,
 		[&](UBlueprintGeneratedClass* BlueprintClassName, const FAssetData AssetData)
 		{
-			auto MatchingFunction = Algo::FindByPredicate(BlueprintClassName->CalledFunctions,
-				[&](const UFunction* Fn)
-				{
-					return Fn->HasAnyFunctionFlags(EFunctionFlags::FUNC_Native)
-						&& Fn->GetName() == FunctionName
-						&& Fn->GetOwnerClass()->GetName() == ClassNameWithoutPrefix;
-				});
-
-			if (MatchingFunction != nullptr)
+			const FCallSiteRecord Record = FCallSiteIndex::MakeRecord(BlueprintClassName);
+			for (FName CalledFunction : Record.CalledFunctions)
 			{
-				OutResults.Add(BlueprintClassName->GetName(), AssetData);
+				const int32* QueryIndex = QueryIndexByKey.Find(CalledFunction);
+				if (QueryIndex != nullptr && !OutResults[*QueryIndex].Contains(Record.Name))
+				{
+					OutResults[*QueryIndex].Add(Record.Name, AssetData);
+					OnConfirmed(*QueryIndex, Record.Name, AssetData);
+				}
 			}
+		},
+		MaxInFlight,
+		MaxMemoryMB);
+
+	return OutResults;
+}
+
+/**
+* Finds the blueprints that call the given functions from the persistent call site index,
+* loading only the blueprints that changed since the index was last saved.
+*/
+TArray<TMap<FString, FAssetData>> FindIndexedAssets(
+	const TArray<FSymbolQuery>& Queries, const FString& CachePath,
+	int32 MaxInFlight, int32 MaxMemoryMB, int32& OutTotalAssetCount)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::FindIndexedAssets);
+
+	FARFilter Filter;
+	Filter.bRecursivePaths = true;
+	Filter.bRecursiveClasses = true;
+	AssetHelpers::SetBlueprintClassFilter(Filter);
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+	OutTotalAssetCount = Assets.Num();
+
+	FCallSiteIndex Index;
+	if (!Index.Load(CachePath))
+	{
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Building a new call site index: %s"), *CachePath);
+	}
+
+	Index.Update(Assets, MaxInFlight, MaxMemoryMB);
+
+	if (!Index.Save(CachePath))
+	{
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to save the call site index: %s"), *CachePath);
+	}
+
+	TArray<TMap<FString, FAssetData>> OutResults;
+	Algo::Transform(Queries, OutResults, [&](const FSymbolQuery& Query)
+		{
+			return Index.Find(Query.ClassNameWithoutPrefix, Query.FunctionName);
 		});
 
 	return OutResults;
 }
+
 using JsonWriter = TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>;
 
-static void SerializeBlueprintReference(
-	TSharedRef<JsonWriter>& Json, const FString& BlueprintClassName, const FAssetData& Asset)
+static FString GetPackageFilePath(const FAssetData& Asset)
 {
 	FString PackageFileName;
 	FString PackageFile;
@@ -132,9 +343,15 @@ static void SerializeBlueprintReference(
 		PackageFilePath = FPaths::ConvertRelativePathToFull(MoveTemp(PackageFile));
 	}
 
+	return PackageFilePath;
+}
+
+static void SerializeBlueprintReference(
+	TSharedRef<JsonWriter>& Json, const FString& BlueprintClassName, const FAssetData& Asset)
+{
 	Json->WriteObjectStart();
 	Json->WriteValue(TEXT("name"), BlueprintClassName);
-	Json->WriteValue(TEXT("path"), PackageFilePath);
+	Json->WriteValue(TEXT("path"), GetPackageFilePath(Asset));
 	Json->WriteObjectEnd();
 }
 
@@ -154,13 +371,31 @@ static void SerializeBlueprints(
 	Json->WriteArrayEnd();
 }
 
+static void SerializePerfTime(TSharedRef<JsonWriter>& Json, const TCHAR* Name, const FPerfTime& Time)
+{
+	Json->WriteIdentifierPrefix(Name);
+	Json->WriteObjectStart();
+	Json->WriteValue(TEXT("wall_seconds"), Time.Wall);
+	Json->WriteValue(TEXT("cpu_seconds"), Time.Cpu);
+	Json->WriteObjectEnd();
+}
+
 static void SerializeMetadata(
-	TSharedRef<JsonWriter>& Json, int TotalAssetCount)
+	TSharedRef<JsonWriter>& Json, const FSearchMetadata& Metadata)
 {
 	Json->WriteIdentifierPrefix(TEXT("metadata"));
 	Json->WriteObjectStart();
 	{
-		Json->WriteValue(TEXT("asset_count"), TotalAssetCount);
+		Json->WriteValue(TEXT("asset_count"), Metadata.AssetCount);
+		Json->WriteValue(TEXT("complete"), Metadata.bComplete);
+		Json->WriteValue(TEXT("unindexed_count"), Metadata.UnindexedAssetCount);
+		Json->WriteValue(TEXT("uncached_count"), Metadata.UncachedAssetCount);
+
+		Json->WriteIdentifierPrefix(TEXT("perf"));
+		Json->WriteObjectStart();
+		SerializePerfTime(Json, TEXT("search"), Metadata.Search);
+		SerializePerfTime(Json, TEXT("confirm"), Metadata.Confirm);
+		Json->WriteObjectEnd();
 	}
 	Json->WriteObjectEnd();
 }
@@ -168,20 +403,107 @@ static void SerializeMetadata(
 static void SerializeResults(
 	const TMap<FString, FAssetData>& InAssets,
 	FArchive& OutArchive,
-	int TotalAssetCount)
+	const FSearchMetadata& Metadata)
 {
 	TSharedRef<JsonWriter> Json = JsonWriter::Create(&OutArchive);
 	Json->WriteObjectStart();
 
 	SerializeBlueprints(Json, InAssets);
-	SerializeMetadata(Json, TotalAssetCount);
+	SerializeMetadata(Json, Metadata);
 
 	Json->WriteObjectEnd();
 	Json->Close();
 }
+
+/**
+* Writes the results of a batch of symbols, as a map from each symbol to its blueprints.
+*/
+static void SerializeSymbolResults(
+	const TArray<FSymbolQuery>& Queries,
+	const TArray<TMap<FString, FAssetData>>& Results,
+	FArchive& OutArchive,
+	const FSearchMetadata& Metadata)
+{
+	TSharedRef<JsonWriter> Json = JsonWriter::Create(&OutArchive);
+	Json->WriteObjectStart();
+
+	Json->WriteIdentifierPrefix(TEXT("symbols"));
+	Json->WriteObjectStart();
+	for (int32 QueryIndex = 0; QueryIndex < Queries.Num(); QueryIndex++)
+	{
+		Json->WriteIdentifierPrefix(Queries[QueryIndex].Symbol);
+		Json->WriteObjectStart();
+		SerializeBlueprints(Json, Results[QueryIndex]);
+		Json->WriteObjectEnd();
+	}
+	Json->WriteObjectEnd();
+
+	SerializeMetadata(Json, Metadata);
+
+	Json->WriteObjectEnd();
+	Json->Close();
+}
+
+/**
+* Writes the references as newline-delimited JSON, one line per blueprint as soon as it is confirmed,
+* followed by a summary line with the metadata.
+*/
+class FReferenceStreamWriter
+{
+public:
+	explicit FReferenceStreamWriter(FArchive& InArchive)
+		: Archive(InArchive)
+	{
+	}
+
+	void AddReference(const FString& Symbol, const FString& BlueprintClassName, const FAssetData& Asset)
+	{
+		WriteLine([&](TSharedRef<JsonWriter>& Json)
+		{
+			Json->WriteValue(TEXT("type"), TEXT("reference"));
+			Json->WriteValue(TEXT("symbol"), Symbol);
+			Json->WriteValue(TEXT("name"), BlueprintClassName);
+			Json->WriteValue(TEXT("path"), GetPackageFilePath(Asset));
+		});
+
+		ReferenceCount++;
+	}
+
+	void Close(const FSearchMetadata& Metadata)
+	{
+		WriteLine([&](TSharedRef<JsonWriter>& Json)
+		{
+			Json->WriteValue(TEXT("type"), TEXT("end"));
+			Json->WriteValue(TEXT("reference_count"), ReferenceCount);
+			SerializeMetadata(Json, Metadata);
+		});
+	}
+
+private:
+	void WriteLine(TFunctionRef<void(TSharedRef<JsonWriter>&)> Body)
+	{
+		TSharedRef<JsonWriter> Json = JsonWriter::Create(&Archive);
+		Json->WriteObjectStart();
+		Body(Json);
+		Json->WriteObjectEnd();
+		Json->Close();
+
+		TCondensedJsonPrintPolicy<TCHAR>::WriteChar(&Archive, TEXT('\n'));
+
+		// Let the consumer read the line right away.
+		Archive.Flush();
+	}
+
+	FArchive& Archive;
+	int32 ReferenceCount = 0;
+};
 } // namespace VisualStudioTools
 
 static constexpr auto SymbolParamVal = TEXT("symbol");
+static constexpr auto SymbolsParamVal = TEXT("symbols");
+static constexpr auto CacheParamVal = TEXT("cache");
+static constexpr auto TimeoutParamVal = TEXT("timeout");
+static constexpr auto FormatParamVal = TEXT("format");
 
 UVsBlueprintReferencesCommandlet::UVsBlueprintReferencesCommandlet()
 	: Super()
@@ -191,7 +513,19 @@ UVsBlueprintReferencesCommandlet::UVsBlueprintReferencesCommandlet()
 	HelpParamNames.Add(SymbolParamVal);
 	HelpParamDescriptions.Add(TEXT("[Optional] Fully qualified symbol to search for in the blueprints."));
 
-	HelpUsage = TEXT("<Editor-Cmd.exe> <path_to_uproject> -run=VsBlueprintReferences -output=<path_to_output_file> -symbol=<ClassName::FunctionName> [-unattended -noshadercompile -nosound -nullrhi -nocpuprofilertrace -nocrashreports -nosplash]");
+	HelpParamNames.Add(SymbolsParamVal);
+	HelpParamDescriptions.Add(TEXT("[Optional] Path to a file with the fully qualified symbols to search for, one per line. All the symbols are searched in a single pass, and the results are reported for each symbol. Incompatible with `-symbol`."));
+
+	HelpParamNames.Add(CacheParamVal);
+	HelpParamDescriptions.Add(TEXT("[Optional] Path to an index of the native functions called by each blueprint. When set, the index is used instead of FindInBlueprints and only the blueprints that changed since the previous run are loaded."));
+
+	HelpParamNames.Add(TimeoutParamVal);
+	HelpParamDescriptions.Add(TEXT("[Optional] Maximum time in seconds to wait for the FindInBlueprints search. When exceeded, the blueprints found so far are reported and the output is marked as incomplete."));
+
+	HelpParamNames.Add(FormatParamVal);
+	HelpParamDescriptions.Add(TEXT("[Optional] Output format: `json` or `ndjson`. Defaults to `json`. With `ndjson`, each blueprint is written as a separate line as soon as it is confirmed, followed by a summary line."));
+
+	HelpUsage = TEXT("<Editor-Cmd.exe> <path_to_uproject> -run=VsBlueprintReferences -output=<path_to_output_file> (-symbol=<ClassName::FunctionName>|-symbols=<path_to_symbols_file>) [-cache=<path_to_index_file>] [-timeout=<seconds>] [-format=json|ndjson] [-projectcontent] [-unattended -noshadercompile -nosound -nullrhi -nocpuprofilertrace -nocrashreports -nosplash]");
 }
 
 int32 UVsBlueprintReferencesCommandlet::Run(
@@ -203,46 +537,169 @@ int32 UVsBlueprintReferencesCommandlet::Run(
 	using namespace VisualStudioTools;
 	GIsRunning = true; // Required for the blueprint search to work.
 
-	FString* ReferencesSymbol = ParamVals.Find(SymbolParamVal);
-	if (ReferencesSymbol->IsEmpty())
+	const FString* ReferencesSymbol = ParamVals.Find(SymbolParamVal);
+	const FString* SymbolsFile = ParamVals.Find(SymbolsParamVal);
+	if (ReferencesSymbol != nullptr && SymbolsFile != nullptr)
 	{
-		UE_LOG(LogVisualStudioTools, Error, TEXT("Missing required symbol parameter."));
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Incompatible symbol parameters."));
 		PrintHelp();
 		return -1;
 	}
 
-	FString FunctionName;
-	FString ClassNameNative;
-	if (!ReferencesSymbol->Split(TEXT("::"), &ClassNameNative, &FunctionName))
+	TArray<FSymbolQuery> Queries;
+	if (SymbolsFile != nullptr)
 	{
-		UE_LOG(LogVisualStudioTools, Error, TEXT("Reference parameter should be in the qualified 'NativeClassName::MethodName' format."));
-		PrintHelp();
-		return -1;
+		if (!ReadSymbolsFile(*SymbolsFile, Queries))
+		{
+			PrintHelp();
+			return -1;
+		}
+	}
+	else
+	{
+		if (ReferencesSymbol == nullptr || ReferencesSymbol->IsEmpty())
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Missing required symbol parameter."));
+			PrintHelp();
+			return -1;
+		}
+
+		FSymbolQuery& Query = Queries.AddDefaulted_GetRef();
+		if (!Query.Parse(*ReferencesSymbol))
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Reference parameter should be in the qualified 'NativeClassName::MethodName' format."));
+			PrintHelp();
+			return -1;
+		}
+	}
+
+	double TimeoutSeconds = 0.0;
+	if (const FString* Timeout = ParamVals.Find(TimeoutParamVal))
+	{
+		TimeoutSeconds = Timeout->IsNumeric() ? FCString::Atod(**Timeout) : 0.0;
+		if (TimeoutSeconds <= 0.0)
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Invalid timeout '%s', it should be a positive number of seconds."), **Timeout);
+			PrintHelp();
+			return -1;
+		}
+	}
+
+	bool bStreamOutput = false;
+	if (const FString* Format = ParamVals.Find(FormatParamVal))
+	{
+		bStreamOutput = *Format == TEXT("ndjson");
+		if (!bStreamOutput && *Format != TEXT("json"))
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Invalid output format: %s."), **Format);
+			PrintHelp();
+			return -1;
+		}
+	}
+
+	// With a streamed output, the references are written as they are confirmed and only the summary is left at the end.
+	TOptional<FReferenceStreamWriter> Stream;
+	if (bStreamOutput)
+	{
+		Stream.Emplace(OutArchive);
+	}
+
+	auto OnConfirmed = [&](int32 QueryIndex, const FString& BlueprintClassName, const FAssetData& AssetData)
+	{
+		if (Stream.IsSet())
+		{
+			Stream->AddReference(Queries[QueryIndex].Symbol, BlueprintClassName, AssetData);
+		}
+	};
+
+	// A batch writes a result for each symbol, while a single symbol keeps the original output format.
+	auto WriteResults = [&](const TArray<TMap<FString, FAssetData>>& Results, const FSearchMetadata& Metadata)
+	{
+		if (Stream.IsSet())
+		{
+			Stream->Close(Metadata);
+		}
+		else if (SymbolsFile != nullptr)
+		{
+			SerializeSymbolResults(Queries, Results, OutArchive, Metadata);
+		}
+		else
+		{
+			SerializeResults(Results[0], OutArchive, Metadata);
+		}
+
+		int32 MatchCount = 0;
+		for (const TMap<FString, FAssetData>& MatchAssets : Results)
+		{
+			MatchCount += MatchAssets.Num();
+		}
+
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Found %d blueprint references for %d symbols."), MatchCount, Queries.Num());
+	};
+
+	if (Queries.Num() == 0)
+	{
+		WriteResults({}, FSearchMetadata());
+		return 0;
 	}
 
 	// Execute the search in two stages:
-	// 1. Use FindInBlueprints to get all candidate blueprints with calls to functions that match the requested symbol
-	// 2. Confirm the blueprints reference the requested function, by matching the target UFunction in their call graph.
+	// 1. Use FindInBlueprints to get all candidate blueprints with calls to functions that match the requested symbols
+	// 2. Confirm the blueprints reference the requested functions, by matching the target UFunctions in their call graph.
 	// The first step acts as a filter to avoid loading too many blueprints to inspect their call graph.
 	// The second step is required because the FiB data does not always allow for searching with the function
 	// qualified with the owned class name, if the function is static.
 
-	FString ClassNameWithoutPrefix = StripClassPrefix(ClassNameNative);
-	
-	// Create a FiB search query for function nodes where the native name matches the requested symbol
-	FString SearchValue = FString::Printf(TEXT("Nodes(\"Native Name\"=+%s & ClassName=K2Node_CallFunction)"), *FunctionName);
+	FSearchMetadata Metadata;
+	{
+		FScopedPerfTimer Timer(Metadata.Search);
+		// The references can come from any mounted content, so every root is scanned unless asked otherwise.
+		AssetHelpers::ScanAssetRegistry(
+			bProjectContentOnly ? AssetHelpers::GetContentPaths(FPaths::ProjectDir()) : TArray<FString>(), bRescanAssetRegistry);
+	}
+
+	// With an index, the call graphs of all the blueprints are known without searching.
+	if (const FString* CachePath = ParamVals.Find(CacheParamVal))
+	{
+		TArray<TMap<FString, FAssetData>> Results;
+		{
+			FScopedPerfTimer Timer(Metadata.Search);
+			Results = FindIndexedAssets(Queries, *CachePath, MaxAssetsInFlight, MaxMemoryMB, Metadata.AssetCount);
+		}
+
+		for (int32 QueryIndex = 0; QueryIndex < Results.Num(); QueryIndex++)
+		{
+			for (const auto& Item : Results[QueryIndex])
+			{
+				OnConfirmed(QueryIndex, Item.Key, Item.Value);
+			}
+		}
+
+		WriteResults(Results, Metadata);
+		return 0;
+	}
+
+	// A single query for all the symbols, so that each candidate is only found and loaded once.
+	FString SearchValue = MakeSearchQuery(Queries);
 	
 	UE_LOG(LogVisualStudioTools, Display, TEXT("Blueprint search query: %s"), *SearchValue);
 
 	// Step 1: Execute the Fib search
-	TArray<FAssetData> TargetAssets = SearchForCandidateAssets(SearchValue);
+	TArray<FAssetData> TargetAssets;
+	{
+		FScopedPerfTimer Timer(Metadata.Search);
+		TargetAssets = SearchForCandidateAssets(SearchValue, TimeoutSeconds, Metadata);
+	}
+	Metadata.AssetCount = TargetAssets.Num();
 	
 	// Step 2: Load the assets to confirm they are a match
-	TMap<FString, FAssetData> MatchAssets = GetConfirmedAssets(FunctionName, ClassNameWithoutPrefix, TargetAssets);
+	TArray<TMap<FString, FAssetData>> Results;
+	{
+		FScopedPerfTimer Timer(Metadata.Confirm);
+		Results = GetConfirmedAssets(Queries, TargetAssets, MaxAssetsInFlight, MaxMemoryMB, OnConfirmed);
+	}
 
 	// Finally, write the results back to the output
-	SerializeResults(MatchAssets, OutArchive, TargetAssets.Num());
-
-	UE_LOG(LogVisualStudioTools, Display, TEXT("Found %d blueprints."), MatchAssets.Num());
+	WriteResults(Results, Metadata);
 	return 0;
-}
\ No newline at end of file
+}
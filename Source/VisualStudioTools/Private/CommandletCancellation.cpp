@@ -0,0 +1,60 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "CommandletCancellation.h"
+
+#include "CoreGlobals.h"
+
+namespace VisualStudioTools
+{
+static const FCancellationToken* CurrentToken = nullptr;
+static TFunction<void()> YieldHandler;
+static int32 YieldDepth = 0;
+
+FScopedCancellationToken::FScopedCancellationToken(const FCancellationToken& InToken)
+	: PreviousToken(CurrentToken)
+{
+	check(IsInGameThread());
+	CurrentToken = &InToken;
+}
+
+FScopedCancellationToken::~FScopedCancellationToken()
+{
+	CurrentToken = PreviousToken;
+}
+
+bool IsCancellationRequested()
+{
+	return IsEngineExitRequested() || (CurrentToken != nullptr && CurrentToken->IsCancelled());
+}
+
+void YieldToUrgentRequests()
+{
+	// The requests run by the handler install their own, so only the depth stops them from yielding in turn.
+	if (YieldHandler && YieldDepth == 0)
+	{
+		TFunction<void()> Handler = MoveTemp(YieldHandler);
+		YieldDepth++;
+		Handler();
+		YieldDepth--;
+		YieldHandler = MoveTemp(Handler);
+	}
+}
+
+bool IsRunningAtYieldPoint()
+{
+	return YieldDepth > 0;
+}
+
+FScopedYieldHandler::FScopedYieldHandler(TFunction<void()> InHandler)
+	: PreviousHandler(MoveTemp(YieldHandler))
+{
+	check(IsInGameThread());
+	YieldHandler = MoveTemp(InHandler);
+}
+
+FScopedYieldHandler::~FScopedYieldHandler()
+{
+	YieldHandler = MoveTemp(PreviousHandler);
+}
+} // namespace VisualStudioTools
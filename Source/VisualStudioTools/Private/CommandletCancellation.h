@@ -0,0 +1,70 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+namespace VisualStudioTools
+{
+/**
+* Flag that asks a running command to stop early. It can be set from any thread.
+*/
+class FCancellationToken
+{
+public:
+	void Cancel() { bCancelled = true; }
+
+	bool IsCancelled() const { return bCancelled; }
+
+private:
+	std::atomic<bool> bCancelled{ false };
+};
+
+/**
+* Makes the token the one checked by `IsCancellationRequested` while the command runs in the scope.
+* Only used on the game thread, where the commands run.
+*/
+class FScopedCancellationToken
+{
+public:
+	explicit FScopedCancellationToken(const FCancellationToken& InToken);
+	~FScopedCancellationToken();
+
+private:
+	const FCancellationToken* PreviousToken;
+};
+
+/**
+* Returns whether the current command should stop, because its request was cancelled or the engine is exiting.
+* The long-running loops check it between the units of work, and return the results produced so far.
+*/
+bool IsCancellationRequested();
+
+/**
+* Lets the server run its urgent requests at a point where the current command can be interrupted,
+* e.g. between two tests or two loaded blueprints. Does nothing outside of the server, or when called
+* by a request that already runs at a yield point.
+*/
+void YieldToUrgentRequests();
+
+/**
+* Returns whether the current command runs at the yield point of another one. The interrupted command can
+* hold objects that are not referenced anywhere else, so garbage must not be collected until it resumes.
+*/
+bool IsRunningAtYieldPoint();
+
+/**
+* Sets the handler invoked by `YieldToUrgentRequests` while in scope.
+*/
+class FScopedYieldHandler
+{
+public:
+	explicit FScopedYieldHandler(TFunction<void()> InHandler);
+	~FScopedYieldHandler();
+
+private:
+	TFunction<void()> PreviousHandler;
+};
+} // namespace VisualStudioTools
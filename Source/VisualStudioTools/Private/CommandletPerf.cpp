@@ -0,0 +1,55 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "CommandletPerf.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+
+#include <windows.h>
+
+#include "Windows/HideWindowsPlatformTypes.h"
+#elif PLATFORM_UNIX || PLATFORM_MAC
+#include <sys/resource.h>
+#endif
+
+namespace VisualStudioTools
+{
+#if PLATFORM_WINDOWS
+static double FileTimeToSeconds(const FILETIME& Time)
+{
+	// FILETIME is expressed in 100-nanosecond intervals.
+	const uint64 Ticks = (uint64(Time.dwHighDateTime) << 32) | Time.dwLowDateTime;
+	return Ticks * 1e-7;
+}
+#elif PLATFORM_UNIX || PLATFORM_MAC
+static double TimeValToSeconds(const timeval& Time)
+{
+	return Time.tv_sec + Time.tv_usec * 1e-6;
+}
+#endif
+
+FPerfTime FPerfTime::Now()
+{
+	FPerfTime Result;
+	Result.Wall = FPlatformTime::Seconds();
+
+#if PLATFORM_WINDOWS
+	FILETIME CreationTime, ExitTime, KernelTime, UserTime;
+	if (::GetProcessTimes(::GetCurrentProcess(), &CreationTime, &ExitTime, &KernelTime, &UserTime))
+	{
+		Result.Cpu = FileTimeToSeconds(KernelTime) + FileTimeToSeconds(UserTime);
+	}
+#elif PLATFORM_UNIX || PLATFORM_MAC
+	rusage Usage;
+	if (::getrusage(RUSAGE_SELF, &Usage) == 0)
+	{
+		Result.Cpu = TimeValToSeconds(Usage.ru_stime) + TimeValToSeconds(Usage.ru_utime);
+	}
+#else
+	// Only the wall time is measured, and the CPU time is reported as zero.
+#endif
+
+	return Result;
+}
+} // namespace VisualStudioTools
@@ -0,0 +1,66 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+namespace VisualStudioTools
+{
+/**
+* Wall clock and CPU time, in seconds. The CPU time includes all the threads of the process,
+* so it can be higher than the wall time when the loading threads are busy.
+*/
+struct FPerfTime
+{
+	double Wall = 0.0;
+	double Cpu = 0.0;
+
+	/** Current time since an arbitrary point, only meaningful as the difference between two calls. */
+	static FPerfTime Now();
+
+	FPerfTime operator-(const FPerfTime& Other) const { return { Wall - Other.Wall, Cpu - Other.Cpu }; }
+
+	FPerfTime& operator+=(const FPerfTime& Other)
+	{
+		Wall += Other.Wall;
+		Cpu += Other.Cpu;
+		return *this;
+	}
+
+	FPerfTime& operator-=(const FPerfTime& Other)
+	{
+		Wall -= Other.Wall;
+		Cpu -= Other.Cpu;
+		return *this;
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FPerfTime& Time)
+	{
+		return Ar << Time.Wall << Time.Cpu;
+	}
+};
+
+/**
+* Adds the time spent in the scope to an accumulator.
+*/
+class FScopedPerfTimer
+{
+public:
+	explicit FScopedPerfTimer(FPerfTime& InAccumulator)
+		: Accumulator(InAccumulator)
+		, Start(FPerfTime::Now())
+	{
+	}
+
+	~FScopedPerfTimer()
+	{
+		Accumulator += FPerfTime::Now() - Start;
+	}
+
+private:
+	FPerfTime& Accumulator;
+	const FPerfTime Start;
+};
+} // namespace VisualStudioTools
@@ -0,0 +1,556 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "BlueprintIndexBuilder.h"
+#include "CommandletPerf.h"
+#include "VisualStudioTools.h"
+
+#include "GameFramework/Actor.h"
+#include "GameFramework/Character.h"
+#include "JsonObjectConverter.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/ScopeExit.h"
+#include "UObject/SoftObjectPath.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/**
+* Before/after timings of the index extraction hot paths, on the `AActor` and `ACharacter` hierarchies.
+* The "before" side of each benchmark is the implementation that was replaced, kept here
+* only for the comparison, and both sides must produce the same result on the same input.
+*/
+namespace VisualStudioTools
+{
+namespace Benchmark
+{
+/** Repetitions of each case, enough for the timings to stand out from the noise. */
+static constexpr int32 BenchmarkIterations = 100;
+
+struct FResult
+{
+	FString Name;
+	FString Class;
+	int32 Iterations = 0;
+	FPerfTime Before;
+	FPerfTime After;
+	bool bSameResult = true;
+};
+
+template <typename FunctionType>
+static FPerfTime TimeIterations(int32 Iterations, FunctionType&& Function)
+{
+	const FPerfTime Start = FPerfTime::Now();
+	for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		Function();
+	}
+
+	return FPerfTime::Now() - Start;
+}
+
+/** Native parents of the benchmark blueprints: a shallow and a deep hierarchy. */
+static TArray<UClass*> GetTargetClasses()
+{
+	return { AActor::StaticClass(), ACharacter::StaticClass() };
+}
+
+/** Native classes that a blueprint derived from `Class` reports, same as `FindBlueprintNativeParents`. */
+static TArray<UClass*> GetNativeParents(UClass* Class)
+{
+	TArray<UClass*> Parents;
+	for (UClass* Super = Class; Super; Super = Super->GetSuperClass())
+	{
+		if (Super->HasAnyClassFlags(CLASS_Native) && Super->GetFName() != NAME_Object)
+		{
+			Parents.Add(Super);
+		}
+	}
+
+	return Parents;
+}
+
+/** Reports the timings of a case to the test, which fails if the two sides disagree. */
+static void ReportResult(FAutomationTestBase& Test, const FResult& Result)
+{
+	const double Speedup = Result.After.Wall > 0.0 ? Result.Before.Wall / Result.After.Wall : 0.0;
+	Test.AddInfo(FString::Printf(TEXT("%s/%s x%d: { Before: %.3fms, After: %.3fms, Speedup: %.2fx }"),
+		*Result.Name, *Result.Class, Result.Iterations,
+		Result.Before.Wall * 1000.0 / Result.Iterations, Result.After.Wall * 1000.0 / Result.Iterations, Speedup));
+	Test.TestTrue(FString::Printf(TEXT("%s/%s gives the same result before and after"), *Result.Name, *Result.Class), Result.bSameResult);
+}
+
+static bool IsSameValue(const TSharedPtr<FJsonValue>& JsonValue, const FPropertyValue& Value)
+{
+	if (!JsonValue.IsValid())
+	{
+		return Value.Kind == FPropertyValue::EKind::None;
+	}
+
+	switch (Value.Kind)
+	{
+	case FPropertyValue::EKind::Bool:
+		return JsonValue->Type == EJson::Boolean && JsonValue->AsBool() == Value.bBool;
+	case FPropertyValue::EKind::Number:
+		return JsonValue->Type == EJson::Number && JsonValue->AsNumber() == Value.Number;
+	case FPropertyValue::EKind::String:
+		return JsonValue->Type == EJson::String && JsonValue->AsString() == Value.String;
+	default:
+		return false;
+	}
+}
+
+/**
+* Reads the scalar properties of the `Class` CDO that the index serializes, declared in any of its
+* native parents, with `FJsonObjectConverter::UPropertyToJsonValue` before and `MakePropertyValue` after.
+*/
+static FResult RunPropertyValueBenchmark(UClass* Class, int32 Iterations)
+{
+	const uint8* DefaultObject = reinterpret_cast<const uint8*>(Class->GetDefaultObject());
+
+	TArray<FProperty*> Properties;
+	for (UClass* Parent : GetNativeParents(Class))
+	{
+		for (TFieldIterator<FProperty> It(Parent, EFieldIteratorFlags::ExcludeSuper); It; ++It)
+		{
+			if (ShouldSerializePropertyValue(*It))
+			{
+				Properties.Add(*It);
+			}
+		}
+	}
+
+	TArray<TSharedPtr<FJsonValue>> BeforeValues;
+	TArray<FPropertyValue> AfterValues;
+
+	FResult Result;
+	Result.Name = TEXT("property_values");
+	Result.Class = Class->GetName();
+	Result.Iterations = Iterations;
+
+	Result.Before = TimeIterations(Iterations, [&]
+	{
+		BeforeValues.Reset();
+		for (FProperty* Property : Properties)
+		{
+			BeforeValues.Add(FJsonObjectConverter::UPropertyToJsonValue(Property, Property->ContainerPtrToValuePtr<uint8>(DefaultObject)));
+		}
+	});
+
+	Result.After = TimeIterations(Iterations, [&]
+	{
+		AfterValues.Reset();
+		for (FProperty* Property : Properties)
+		{
+			AfterValues.Add(MakePropertyValue(Property, Property->ContainerPtrToValuePtr<uint8>(DefaultObject)));
+		}
+	});
+
+	for (int32 Idx = 0; Idx < Properties.Num(); Idx++)
+	{
+		if (!IsSameValue(BeforeValues[Idx], AfterValues[Idx]))
+		{
+			UE_LOG(LogVisualStudioTools, Warning, TEXT("Benchmark property_values: different value for '%s'."), *Properties[Idx]->GetPathName());
+			Result.bSameResult = false;
+		}
+	}
+
+	return Result;
+}
+
+/** Per-property comparison of the CDOs, which `FClassLayout` replaced. */
+static TArray<FProperty*> GetChangedPropertiesListPerProperty(
+	UStruct* InStruct, const uint8* DataPtr, const uint8* DefaultDataPtr)
+{
+	TArray<FProperty*> Result;
+
+	const UClass* OwnerClass = Cast<UClass>(InStruct);
+
+	for (TFieldIterator<FProperty> It(OwnerClass, EFieldIteratorFlags::ExcludeSuper); It; ++It)
+	{
+		FProperty* Property = *It;
+		for (int32 Idx = 0; Idx < Property->ArrayDim; Idx++)
+		{
+			const uint8* PropertyValue = Property->ContainerPtrToValuePtr<uint8>(DataPtr, Idx);
+			const uint8* DefaultPropertyValue = Property->ContainerPtrToValuePtrForDefaults<uint8>(InStruct, DefaultDataPtr, Idx);
+
+			if (!Property->Identical(PropertyValue, DefaultPropertyValue))
+			{
+				Result.Add(Property);
+				break;
+			}
+		}
+	}
+
+	return Result;
+}
+
+/**
+* Compares a blueprint-like copy of the `Class` CDO against the CDO of each of its native parents,
+* as `MakeBlueprintRecord` does. With `bChangeProperty`, the first plain-old-data property declared
+* in `Class` is modified in the copy, so the bulk comparison has to fall back to the per-property check.
+*/
+static FResult RunChangedPropertiesBenchmark(UClass* Class, bool bChangeProperty, int32 Iterations)
+{
+	// The layouts are built once per scan, so they are not part of the timings.
+	FNativeClassCache ClassCache;
+	TArray<UClass*> Parents = GetNativeParents(Class);
+	for (UClass* Parent : Parents)
+	{
+		ClassCache.Get(Parent);
+	}
+
+	// A shallow copy is enough: it's only read, and the properties that own memory still point to the CDO.
+	const int32 Size = Class->GetPropertiesSize();
+	uint8* Data = static_cast<uint8*>(FMemory::Malloc(Size, Class->GetMinAlignment()));
+	ON_SCOPE_EXIT
+	{
+		FMemory::Free(Data);
+	};
+
+	FMemory::Memcpy(Data, Class->GetDefaultObject(), Size);
+
+	if (bChangeProperty)
+	{
+		for (const FClassLayout::FPropertyLayout& PropLayout : ClassCache.Get(Class).Layout.Properties)
+		{
+			if (PropLayout.Range != INDEX_NONE)
+			{
+				// Flipping the lowest bit keeps native bools valid.
+				Data[PropLayout.Offset] ^= 1;
+				break;
+			}
+		}
+	}
+
+	TArray<TArray<FProperty*>> BeforeChanges;
+	TArray<TArray<FProperty*>> AfterChanges;
+
+	FResult Result;
+	Result.Name = bChangeProperty ? TEXT("changed_properties/one_change") : TEXT("changed_properties/unchanged");
+	Result.Class = Class->GetName();
+	Result.Iterations = Iterations;
+
+	Result.Before = TimeIterations(Iterations, [&]
+	{
+		BeforeChanges.Reset();
+		for (UClass* Parent : Parents)
+		{
+			BeforeChanges.Add(GetChangedPropertiesListPerProperty(Parent, Data, reinterpret_cast<const uint8*>(Parent->GetDefaultObject(false))));
+		}
+	});
+
+	Result.After = TimeIterations(Iterations, [&]
+	{
+		AfterChanges.Reset();
+		for (UClass* Parent : Parents)
+		{
+			const FNativeClassInfo& ParentInfo = ClassCache.Get(Parent);
+			AfterChanges.Add(GetChangedPropertiesList(ParentInfo.Layout, Data, ParentInfo.DefaultObject));
+		}
+	});
+
+	// The layout checks the properties in the same order, so the lists must match exactly.
+	Result.bSameResult = BeforeChanges == AfterChanges;
+	return Result;
+}
+
+/** In-memory index keyed by the class name and by property and function name strings. */
+struct FStringKeyedIndex
+{
+	struct FPropertyRecord
+	{
+		FString Name;
+		FPropertyValue Value;
+	};
+
+	struct FParentRecord
+	{
+		FString ClassPath;
+		TArray<FPropertyRecord> Properties;
+		TArray<FString> Functions;
+	};
+
+	struct FClassEntry
+	{
+		const UClass* Class = nullptr;
+		TArray<int32> Blueprints;
+		TMap<FString, FPropertyEntry> Properties;
+		TMap<FString, FFunctionEntry> Functions;
+	};
+
+	TMap<FString, FClassEntry> Classes;
+	TMap<FString, const UClass*> ResolvedClasses;
+	TArray<FBlueprintEntry> Blueprints;
+
+	void AddBlueprint(const FString& Name, const FString& Path, const TArray<FParentRecord>& Parents)
+	{
+		int32 BlueprintIndex = Blueprints.Num();
+		bool bHasAnyParent = false;
+
+		for (const FParentRecord& ParentRecord : Parents)
+		{
+			const UClass* Parent = nullptr;
+			if (const UClass** Found = ResolvedClasses.Find(ParentRecord.ClassPath))
+			{
+				Parent = *Found;
+			}
+			else
+			{
+				Parent = FSoftClassPath(ParentRecord.ClassPath).ResolveClass();
+				ResolvedClasses.Add(ParentRecord.ClassPath, Parent);
+			}
+
+			if (Parent == nullptr)
+			{
+				continue;
+			}
+
+			bHasAnyParent = true;
+
+			FString ParentName = Parent->GetFName().ToString();
+			if (!Classes.Contains(ParentName))
+			{
+				Classes.Add(ParentName).Class = Parent;
+			}
+
+			FClassEntry& ClassEntry = Classes[ParentName];
+
+			ClassEntry.Blueprints.Add(BlueprintIndex);
+
+			for (const FPropertyRecord& PropRecord : ParentRecord.Properties)
+			{
+				if (!ClassEntry.Properties.Contains(PropRecord.Name))
+				{
+					FProperty* Property = FindFProperty<FProperty>(Parent, *PropRecord.Name);
+					if (Property == nullptr)
+					{
+						continue;
+					}
+
+					ClassEntry.Properties.Add(PropRecord.Name).Property = Property;
+				}
+
+				FPropertyEntry& PropEntry = ClassEntry.Properties[PropRecord.Name];
+				PropEntry.Blueprints.Add(BlueprintIndex);
+				PropEntry.Values.Add(PropRecord.Value);
+			}
+
+			for (const FString& FnName : ParentRecord.Functions)
+			{
+				if (!ClassEntry.Functions.Contains(FnName))
+				{
+					ClassEntry.Functions.Add(FnName);
+				}
+
+				FFunctionEntry& FuncEntry = ClassEntry.Functions[FnName];
+				FuncEntry.Blueprints.Add(BlueprintIndex);
+			}
+		}
+
+		if (bHasAnyParent)
+		{
+			check(Blueprints.Add({ Name, Path }) == BlueprintIndex);
+		}
+	}
+};
+
+/** Order-independent summary of the entries of an index, to compare the two implementations. */
+struct FIndexSummary
+{
+	int32 Classes = 0;
+	int32 Blueprints = 0;
+	int64 ClassRefs = 0;
+	int64 PropertyRefs = 0;
+	int64 FunctionRefs = 0;
+
+	template <typename ClassMapType>
+	static FIndexSummary Make(const ClassMapType& Classes, int32 BlueprintCount)
+	{
+		FIndexSummary Summary;
+		Summary.Classes = Classes.Num();
+		Summary.Blueprints = BlueprintCount;
+		for (const auto& ClassItem : Classes)
+		{
+			Summary.ClassRefs += ClassItem.Value.Blueprints.Num();
+			for (const auto& PropItem : ClassItem.Value.Properties)
+			{
+				Summary.PropertyRefs += PropItem.Value.Blueprints.Num();
+			}
+
+			for (const auto& FnItem : ClassItem.Value.Functions)
+			{
+				Summary.FunctionRefs += FnItem.Value.Blueprints.Num();
+			}
+		}
+
+		return Summary;
+	}
+
+	bool operator==(const FIndexSummary& Other) const
+	{
+		return Classes == Other.Classes && Blueprints == Other.Blueprints && ClassRefs == Other.ClassRefs
+			&& PropertyRefs == Other.PropertyRefs && FunctionRefs == Other.FunctionRefs;
+	}
+};
+
+/**
+* Builds the index of synthetic blueprints derived from `Class`, from the records as `MakeBlueprintRecord`
+* creates them: class paths and name strings before, class pointers and `FName`s after.
+* Each blueprint changes a few properties and implements a few functions of every native parent.
+*/
+static FResult RunIndexBenchmark(UClass* Class, int32 Iterations)
+{
+	static constexpr int32 BlueprintCount = 1000;
+	static constexpr int32 PropertiesPerParent = 4;
+	static constexpr int32 FunctionsPerParent = 2;
+
+	struct FParentInput
+	{
+		UClass* Class;
+		TArray<FProperty*> Properties;
+		TArray<UFunction*> Functions;
+	};
+
+	TArray<FParentInput> Parents;
+	for (UClass* Parent : GetNativeParents(Class))
+	{
+		FParentInput& Input = Parents.AddDefaulted_GetRef();
+		Input.Class = Parent;
+		for (TFieldIterator<FProperty> It(Parent, EFieldIteratorFlags::ExcludeSuper); It; ++It)
+		{
+			Input.Properties.Add(*It);
+		}
+
+		for (TFieldIterator<UFunction> It(Parent, EFieldIteratorFlags::ExcludeSuper); It; ++It)
+		{
+			Input.Functions.Add(*It);
+		}
+	}
+
+	TArray<FBlueprintEntry> Blueprints;
+	for (int32 BlueprintIndex = 0; BlueprintIndex < BlueprintCount; BlueprintIndex++)
+	{
+		const FString Name = FString::Printf(TEXT("BP_Benchmark%d_C"), BlueprintIndex);
+		Blueprints.Add({ Name, FString::Printf(TEXT("/Game/Benchmark/BP_Benchmark%d.%s"), BlueprintIndex, *Name) });
+	}
+
+	// Picks a stable, blueprint-dependent subset of the members of each parent.
+	auto ForEachPick = [](int32 BlueprintIndex, int32 Num, int32 MaxCount, auto&& Callback)
+	{
+		for (int32 Pick = 0; Pick < FMath::Min(Num, MaxCount); Pick++)
+		{
+			Callback((BlueprintIndex * 7 + Pick * 13) % Num);
+		}
+	};
+
+	FIndexSummary BeforeSummary;
+	FIndexSummary AfterSummary;
+
+	FResult Result;
+	Result.Name = TEXT("index");
+	Result.Class = Class->GetName();
+	Result.Iterations = Iterations;
+
+	Result.Before = TimeIterations(Iterations, [&]
+	{
+		FStringKeyedIndex Index;
+		for (int32 BlueprintIndex = 0; BlueprintIndex < BlueprintCount; BlueprintIndex++)
+		{
+			TArray<FStringKeyedIndex::FParentRecord> Records;
+			for (const FParentInput& Parent : Parents)
+			{
+				FStringKeyedIndex::FParentRecord& ParentRecord = Records.AddDefaulted_GetRef();
+				ParentRecord.ClassPath = Parent.Class->GetPathName();
+				ForEachPick(BlueprintIndex, Parent.Properties.Num(), PropertiesPerParent, [&](int32 Idx)
+				{
+					ParentRecord.Properties.AddDefaulted_GetRef().Name = Parent.Properties[Idx]->GetFName().ToString();
+				});
+				ForEachPick(BlueprintIndex, Parent.Functions.Num(), FunctionsPerParent, [&](int32 Idx)
+				{
+					ParentRecord.Functions.Add(Parent.Functions[Idx]->GetFName().ToString());
+				});
+			}
+
+			Index.AddBlueprint(Blueprints[BlueprintIndex].Name, Blueprints[BlueprintIndex].Path, Records);
+		}
+
+		BeforeSummary = FIndexSummary::Make(Index.Classes, Index.Blueprints.Num());
+	});
+
+	Result.After = TimeIterations(Iterations, [&]
+	{
+		FAssetIndex Index;
+		for (int32 BlueprintIndex = 0; BlueprintIndex < BlueprintCount; BlueprintIndex++)
+		{
+			FBlueprintRecord Record;
+			Record.Name = Blueprints[BlueprintIndex].Name;
+			Record.Path = Blueprints[BlueprintIndex].Path;
+			for (const FParentInput& Parent : Parents)
+			{
+				FParentRecord& ParentRecord = Record.Parents.AddDefaulted_GetRef();
+				ParentRecord.Class = Parent.Class;
+				ForEachPick(BlueprintIndex, Parent.Properties.Num(), PropertiesPerParent, [&](int32 Idx)
+				{
+					ParentRecord.Properties.AddDefaulted_GetRef().Name = Parent.Properties[Idx]->GetFName();
+				});
+				ForEachPick(BlueprintIndex, Parent.Functions.Num(), FunctionsPerParent, [&](int32 Idx)
+				{
+					ParentRecord.Functions.Add(Parent.Functions[Idx]->GetFName());
+				});
+			}
+
+			Index.AddBlueprint(Record);
+		}
+
+		AfterSummary = FIndexSummary::Make(Index.Classes, Index.Blueprints.Num());
+	});
+
+	Result.bSameResult = BeforeSummary == AfterSummary;
+	return Result;
+}
+} // namespace Benchmark
+} // namespace VisualStudioTools
+
+using namespace VisualStudioTools::Benchmark;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FIndexBenchmark, "VisualStudioTools.Benchmarks.Index",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FIndexBenchmark::RunTest(const FString& Parameters)
+{
+	for (UClass* Class : GetTargetClasses())
+	{
+		ReportResult(*this, RunIndexBenchmark(Class, BenchmarkIterations));
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPropertyValueBenchmark, "VisualStudioTools.Benchmarks.PropertyValues",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FPropertyValueBenchmark::RunTest(const FString& Parameters)
+{
+	for (UClass* Class : GetTargetClasses())
+	{
+		ReportResult(*this, RunPropertyValueBenchmark(Class, BenchmarkIterations));
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FChangedPropertiesBenchmark, "VisualStudioTools.Benchmarks.ChangedProperties",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FChangedPropertiesBenchmark::RunTest(const FString& Parameters)
+{
+	for (UClass* Class : GetTargetClasses())
+	{
+		ReportResult(*this, RunChangedPropertiesBenchmark(Class, false /*bChangeProperty*/, BenchmarkIterations));
+		ReportResult(*this, RunChangedPropertiesBenchmark(Class, true /*bChangeProperty*/, BenchmarkIterations));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,145 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "VSServerTransport.h"
+
+#include "Async/Async.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Guid.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace VisualStudioTools
+{
+/** Longest time a test waits for the other end, so a broken transport fails the test instead of hanging it. */
+static constexpr double TransportTestTimeoutSeconds = 10.0;
+
+/**
+* Connects both ends of a transport with a unique endpoint name: the client end created by `Listen`,
+* as Visual Studio does, and the server end created by `Connect`.
+*/
+static bool ConnectTestEndpoints(TUniquePtr<IServerConnection>& OutClient, TUniquePtr<IServerConnection>& OutServer)
+{
+	const FString EndpointName = FString::Printf(TEXT("VSServerTransportTest-%s"), *FGuid::NewGuid().ToString());
+	TUniquePtr<IServerTransport> ClientTransport = CreateServerTransport(EndpointName);
+	TUniquePtr<IServerTransport> ServerTransport = CreateServerTransport(EndpointName);
+
+	TFuture<TUniquePtr<IServerConnection>> Client = Async(EAsyncExecution::Thread, [&ClientTransport]()
+		{
+			return ClientTransport->Listen();
+		});
+
+	const double Deadline = FPlatformTime::Seconds() + TransportTestTimeoutSeconds;
+	while (!OutServer.IsValid() && FPlatformTime::Seconds() < Deadline)
+	{
+		OutServer = ServerTransport->Connect();
+	}
+
+	OutClient = Client.Get();
+	return OutClient.IsValid() && OutServer.IsValid();
+}
+
+/** Reads on another thread, so that a read that never returns fails the test. */
+static bool ReadWithTimeout(IServerConnection& Connection, TArray<uint8>& OutBytes, bool& bOutResult)
+{
+	TFuture<bool> Read = Async(EAsyncExecution::Thread, [&Connection, &OutBytes]()
+		{
+			return Connection.Read(OutBytes);
+		});
+
+	if (!Read.WaitFor(FTimespan::FromSeconds(TransportTestTimeoutSeconds)))
+	{
+		// Release the thread before the connection is destroyed.
+		Connection.StopReading();
+		Read.Wait();
+		return false;
+	}
+
+	bOutResult = Read.Get();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FServerTransportRoundTripTest, "VisualStudioTools.Server.Transport.RoundTrip",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FServerTransportRoundTripTest::RunTest(const FString& Parameters)
+{
+	TUniquePtr<IServerConnection> Client;
+	TUniquePtr<IServerConnection> Server;
+	if (!TestTrue(TEXT("Both ends connect"), ConnectTestEndpoints(Client, Server)))
+	{
+		return false;
+	}
+
+	const FTCHARToUTF8 Request(TEXT("-VSServerPing"));
+	TestTrue(TEXT("The client writes"), Client->Write(Request.Get(), Request.Length()));
+
+	TArray<uint8> Bytes;
+	bool bRead = false;
+	TestTrue(TEXT("The server read returns"), ReadWithTimeout(*Server, Bytes, bRead));
+	TestTrue(TEXT("The server reads the request"), bRead && Bytes.Num() == Request.Length());
+
+	TestTrue(TEXT("The server writes"), Server->Write("0", 1));
+
+	Bytes.Reset();
+	TestTrue(TEXT("The client read returns"), ReadWithTimeout(*Client, Bytes, bRead));
+	TestTrue(TEXT("The client reads the response"), bRead && Bytes.Num() == 1 && Bytes[0] == '0');
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FServerTransportDisconnectTest, "VisualStudioTools.Server.Transport.Disconnect",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FServerTransportDisconnectTest::RunTest(const FString& Parameters)
+{
+	TUniquePtr<IServerConnection> Client;
+	TUniquePtr<IServerConnection> Server;
+	if (!TestTrue(TEXT("Both ends connect"), ConnectTestEndpoints(Client, Server)))
+	{
+		return false;
+	}
+
+	// The server must see the closed connection as a failed read, and keep failing instead of returning empty data.
+	Client.Reset();
+	for (int32 Attempt = 0; Attempt < 2; Attempt++)
+	{
+		TArray<uint8> Bytes;
+		bool bRead = true;
+		TestTrue(TEXT("The read returns"), ReadWithTimeout(*Server, Bytes, bRead));
+		TestFalse(TEXT("The read fails after the client disconnects"), bRead);
+		TestEqual(TEXT("No data is read after the client disconnects"), Bytes.Num(), 0);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FServerTransportStopReadingTest, "VisualStudioTools.Server.Transport.StopReading",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FServerTransportStopReadingTest::RunTest(const FString& Parameters)
+{
+	TUniquePtr<IServerConnection> Client;
+	TUniquePtr<IServerConnection> Server;
+	if (!TestTrue(TEXT("Both ends connect"), ConnectTestEndpoints(Client, Server)))
+	{
+		return false;
+	}
+
+	TArray<uint8> Bytes;
+	TFuture<bool> Read = Async(EAsyncExecution::Thread, [&Server, &Bytes]()
+		{
+			return Server->Read(Bytes);
+		});
+
+	// Give the read time to block before interrupting it.
+	FPlatformProcess::Sleep(0.1f);
+	Server->StopReading();
+
+	TestTrue(TEXT("StopReading interrupts a pending read"), Read.WaitFor(FTimespan::FromSeconds(TransportTestTimeoutSeconds)));
+	Read.Wait();
+	TestFalse(TEXT("The interrupted read fails"), Read.Get());
+	return true;
+}
+} // namespace VisualStudioTools
+
+#endif // WITH_DEV_AUTOMATION_TESTS
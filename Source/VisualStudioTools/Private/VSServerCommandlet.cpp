@@ -1,30 +1,42 @@
 // Copyright 2022 (c) Microsoft. All rights reserved.
 
 #include "VSServerCommandlet.h"
+#include "BlueprintReferencesCommandlet.h"
+#include "CommandletCancellation.h"
+#include "VisualStudioToolsCommandlet.h"
 #include "VSTestAdapterCommandlet.h"
 
-#include "Windows/AllowWindowsPlatformTypes.h"
-
+#include "Async/Async.h"
+#include "DirectoryWatcherModule.h"
+#include "Dom/JsonObject.h"
+#include "IDirectoryWatcher.h"
+#include "Interfaces/IPluginManager.h"
 #include "HAL/PlatformNamedPipe.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
 #include "Runtime/Core/Public/Async/TaskGraphInterfaces.h"
 #include "Runtime/Core/Public/Containers/Ticker.h"
 #include "Runtime/Engine/Classes/Engine/World.h"
 #include "Runtime/Engine/Public/TimerManager.h"
 #include "Runtime/Launch/Resources/Version.h"
-#include "Runtime\CoreUObject\Public\UObject\UObjectGlobals.h"
-#include <chrono>
-#include <codecvt>
-#include <fstream>
+#include "Runtime/CoreUObject/Public/UObject/UObjectGlobals.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
 #include <string>
-#include <thread>
-#include <windows.h>
-
-#include "Windows/HideWindowsPlatformTypes.h"
 
 #include "VisualStudioTools.h"
+#include "VSServerProtocol.h"
+#include "VSServerTransport.h"
 
 static constexpr auto NamedPipeParam = TEXT("NamedPipe");
 static constexpr auto KillServerParam = TEXT("KillVSServer");
+static constexpr auto PingParam = TEXT("VSServerPing");
+static constexpr auto LatencyBenchmarkParam = TEXT("LatencyBenchmark");
+static constexpr auto LatencyBenchmarkTraceParam = TEXT("LatencyBenchmarkTrace");
 
 UVSServerCommandlet::UVSServerCommandlet()
 {
@@ -32,87 +44,924 @@ UVSServerCommandlet::UVSServerCommandlet()
 	HelpUsage = TEXT("<Editor-Cmd.exe> <path_to_uproject> -run=VSServer [-stdout -multiprocess -silent -unattended -AllowStdOutLogVerbosity -NoShaderCompile]");
 
 	HelpParamNames.Add(NamedPipeParam);
-	HelpParamDescriptions.Add(TEXT("[Required] The name of the named pipe used to communicate with Visual Studio."));
+	HelpParamDescriptions.Add(TEXT("[Required] The name of the named pipe used to communicate with Visual Studio. Outside of Windows, the path of a Unix domain socket, relative to the user temp directory."));
 
 	HelpParamNames.Add(KillServerParam);
-	HelpParamDescriptions.Add(TEXT("[Optional] Quit the server mode commandlet immediately."));
+	HelpParamDescriptions.Add(TEXT("[Optional] Quit the server mode commandlet, after answering the request."));
+
+	HelpParamNames.Add(PingParam);
+	HelpParamDescriptions.Add(TEXT("[Optional] Request answered immediately with a success result, to measure the latency of the server."));
+
+	HelpParamNames.Add(LatencyBenchmarkParam);
+	HelpParamDescriptions.Add(TEXT("[Optional] Number of ping requests sent to the server by a local client on the named pipe, using the framed protocol from `VSServerProtocol.h`. The client first checks that a legacy command line longer than 4 KB is answered, then logs the round trip times and throughput, and shuts down the server."));
+
+	HelpParamNames.Add(LatencyBenchmarkTraceParam);
+	HelpParamDescriptions.Add(TEXT("[Optional] Path to a trace of requests replayed by the benchmark client instead of the ping requests, each line being the JSON payload of a request. The trace is replayed as many times as requested by `LatencyBenchmark`."));
+}
+
+namespace VisualStudioTools
+{
+/** Number of requests sent at once by the benchmark client, to check that pipelined requests are answered in order. */
+static constexpr int32 BenchmarkPipelineDepth = 16;
+
+/** Length of the legacy command line sent by the benchmark client, longer than the 4 KB read buffer of the named pipe. */
+static constexpr int32 BenchmarkLegacyCommandLength = 8 * 1024;
+
+static bool WriteMessage(IServerConnection& Connection, ServerProtocol::EMessageType Type, uint32 RequestId, const void* Payload, int32 Size)
+{
+	std::vector<uint8_t> Frames;
+	ServerProtocol::WriteMessage(Frames, Type, RequestId, Payload, Size);
+	return Connection.Write(Frames.data(), static_cast<int32>(Frames.size()));
+}
+
+static bool WriteMessage(IServerConnection& Connection, ServerProtocol::EMessageType Type, uint32 RequestId, const FString& Payload)
+{
+	const FTCHARToUTF8 Converted(*Payload);
+	return WriteMessage(Connection, Type, RequestId, Converted.Get(), Converted.Length());
+}
+
+static bool WriteResponse(IServerConnection& Connection, uint32 RequestId, int32 Result, const FString& Error)
+{
+	FString Payload;
+	TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Json = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Payload);
+	Json->WriteObjectStart();
+	Json->WriteValue(TEXT("result"), Result);
+	if (!Error.IsEmpty())
+	{
+		Json->WriteValue(TEXT("error"), Error);
+	}
+	Json->WriteObjectEnd();
+	Json->Close();
+
+	return WriteMessage(Connection, ServerProtocol::EMessageType::Response, RequestId, Payload);
+}
+
+/**
+* Sends the output of a command to the client in `Data` messages, instead of writing it to a file.
+* The output is sent when the writer flushes it, e.g. after each line of the streamed formats, or when enough data is buffered.
+*/
+class FServerOutputArchive : public FArchive
+{
+public:
+	FServerOutputArchive(IServerConnection& InConnection, uint32 InRequestId)
+		: Connection(InConnection)
+		, RequestId(InRequestId)
+	{
+		SetIsSaving(true);
+	}
+
+	virtual void Serialize(void* Data, int64 Num) override
+	{
+		// The writers serialize small items, far from the limit of the buffer.
+		check(Num <= MAX_int32);
+		Buffer.Append(static_cast<const uint8*>(Data), static_cast<int32>(Num));
+		Position += Num;
+
+		if (Buffer.Num() >= ServerProtocol::MaxFramePayload)
+		{
+			Flush();
+		}
+	}
+
+	virtual void Flush() override
+	{
+		if (Buffer.Num() > 0 && !IsError())
+		{
+			if (!WriteMessage(Connection, ServerProtocol::EMessageType::Data, RequestId, Buffer.GetData(), Buffer.Num()))
+			{
+				SetError();
+			}
+		}
+		Buffer.Reset();
+	}
+
+	virtual bool Close() override
+	{
+		Flush();
+		return !IsError();
+	}
+
+	virtual int64 Tell() override { return Position; }
+
+	virtual int64 TotalSize() override { return Position; }
+
+	virtual FString GetArchiveName() const override { return TEXT("FServerOutputArchive"); }
+
+private:
+	IServerConnection& Connection;
+	const uint32 RequestId;
+	TArray<uint8> Buffer;
+	int64 Position = 0;
+};
+
+/**
+* Watches the content directories of the project for changes to packages, so the blueprint commands only
+* scan the asset registry again when it may be out of date. The engine content is not watched.
+* The directory watcher is ticked by the editor loop, which doesn't run in the commandlet, so it is ticked here.
+*/
+class FContentChangeTracker
+{
+public:
+	FContentChangeTracker()
+	{
+		FDirectoryWatcherModule* Module = FModuleManager::LoadModulePtr<FDirectoryWatcherModule>(TEXT("DirectoryWatcher"));
+		Watcher = Module != nullptr ? Module->Get() : nullptr;
+		if (Watcher == nullptr)
+		{
+			UE_LOG(LogVisualStudioTools, Warning, TEXT("Directory watcher unavailable, the asset registry is scanned again for every request."));
+			return;
+		}
+
+		TArray<FString> Directories = { FPaths::ProjectContentDir() };
+		const FString ProjectDir = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir());
+		for (const TSharedRef<IPlugin>& Plugin : IPluginManager::Get().GetEnabledPluginsWithContent())
+		{
+			if (FPaths::IsUnderDirectory(FPaths::ConvertRelativePathToFull(Plugin->GetBaseDir()), ProjectDir))
+			{
+				Directories.Add(Plugin->GetContentDir());
+			}
+		}
+
+		for (const FString& Directory : Directories)
+		{
+			FDelegateHandle Handle;
+			const FString FullDirectory = FPaths::ConvertRelativePathToFull(Directory);
+			if (!Watcher->RegisterDirectoryChangedCallback_Handle(
+					FullDirectory, IDirectoryWatcher::FDirectoryChanged::CreateRaw(this, &FContentChangeTracker::OnDirectoryChanged), Handle))
+			{
+				UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to watch %s, the asset registry is scanned again for every request."), *FullDirectory);
+				bWatchFailed = true;
+				continue;
+			}
+
+			Watches.Emplace(FullDirectory, Handle);
+		}
+	}
+
+	~FContentChangeTracker()
+	{
+		for (const TPair<FString, FDelegateHandle>& Watch : Watches)
+		{
+			Watcher->UnregisterDirectoryChangedCallback_Handle(Watch.Key, Watch.Value);
+		}
+	}
+
+	/**
+	* Returns whether packages may have changed since the previous call, on the game thread.
+	* Always true on the first call, since the content was not scanned by this process yet.
+	*/
+	bool ConsumeChanges()
+	{
+		if (Watcher == nullptr || bWatchFailed)
+		{
+			return true;
+		}
+
+		Watcher->Tick(0.0f);
+		const bool bResult = bChanged;
+		bChanged = false;
+		return bResult;
+	}
+
+private:
+	void OnDirectoryChanged(const TArray<FFileChangeData>& Changes)
+	{
+		for (const FFileChangeData& Change : Changes)
+		{
+			if (FPackageName::IsPackageExtension(*FPaths::GetExtension(Change.Filename, true /*bIncludeDot*/)))
+			{
+				bChanged = true;
+				return;
+			}
+		}
+	}
+
+	IDirectoryWatcher* Watcher = nullptr;
+	TArray<TPair<FString, FDelegateHandle>> Watches;
+	bool bWatchFailed = false;
+	bool bChanged = true;
+};
+
+/**
+* Runs one of the blueprint commandlets in this process, keeping the editor state warm for the next requests.
+*/
+template <typename CommandletType>
+static int32 RunBlueprintCommandlet(const FString& Params, FArchive* Output, FContentChangeTracker& ContentChanges, FString& OutError)
+{
+	if (Output == nullptr)
+	{
+		OutError = TEXT("The command requires the framed protocol.");
+		return 1;
+	}
+
+	CommandletType* Commandlet = NewObject<CommandletType>();
+	const int32 Result = Commandlet->RunInServer(Params, *Output, ContentChanges.ConsumeChanges());
+	if (!Output->Close())
+	{
+		OutError = TEXT("Failed to send the command output.");
+	}
+
+	// Release the blueprints, so the ones that change before the next request are loaded again.
+	// At a yield point, they are released after the interrupted command instead.
+	if (!IsRunningAtYieldPoint())
+	{
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	}
+	return Result;
+}
+
+/**
+* Runs a command of the game thread, for both protocols. Returns the exit code of the command.
+* `Output` receives the output of the commands that produce one, and is only available with the framed protocol.
+*/
+static int32 ExecuteCommand(ServerProtocol::ECommand Command, const FString& Params, FArchive* Output, FContentChangeTracker& ContentChanges, FString& OutError)
+{
+	switch (Command)
+	{
+	case ServerProtocol::ECommand::Ping:
+		// Answered right away, so that clients can measure the round trip of the server.
+		return 0;
+
+	case ServerProtocol::ECommand::TestAdapter:
+	{
+		UVSTestAdapterCommandlet* Commandlet = NewObject<UVSTestAdapterCommandlet>();
+		try
+		{
+			return Commandlet->Main(Params);
+		}
+		catch (const std::exception& ex)
+		{
+			UE_LOG(LogVisualStudioTools, Display, TEXT("Exception invoking VSTestAdapter commandlet: %s"), UTF8_TO_TCHAR(ex.what()));
+			OutError = UTF8_TO_TCHAR(ex.what());
+			return 1;
+		}
+	}
+
+	case ServerProtocol::ECommand::BlueprintIndex:
+		return RunBlueprintCommandlet<UVisualStudioToolsCommandlet>(Params, Output, ContentChanges, OutError);
+
+	case ServerProtocol::ECommand::BlueprintReferences:
+		return RunBlueprintCommandlet<UVsBlueprintReferencesCommandlet>(Params, Output, ContentChanges, OutError);
+
+	default:
+		OutError = TEXT("Unknown command.");
+		return 1;
+	}
+}
+
+/**
+* Request of the framed protocol, waiting for the game thread or running on it.
+*/
+struct FServerRequest
+{
+	uint32 Id = 0;
+	ServerProtocol::ECommand Command = ServerProtocol::ECommand::Unknown;
+	ServerProtocol::EPriority Priority = ServerProtocol::EPriority::Normal;
+	FString Params;
+	TSharedRef<FCancellationToken, ESPMode::ThreadSafe> Token = MakeShared<FCancellationToken, ESPMode::ThreadSafe>();
+};
+
+/**
+* Returns the priority of a request that does not set one. The queries that are usually quick are urgent,
+* so they are not stuck behind a test run, and the test runs yield to everything else.
+*/
+static ServerProtocol::EPriority GetDefaultPriority(ServerProtocol::ECommand Command, const FString& Params)
+{
+	switch (Command)
+	{
+	case ServerProtocol::ECommand::TestAdapter:
+		return Params.Contains(TEXT("-listtests")) ? ServerProtocol::EPriority::Urgent : ServerProtocol::EPriority::Background;
+	case ServerProtocol::ECommand::BlueprintReferences:
+		return Params.Contains(TEXT("-cache")) ? ServerProtocol::EPriority::Urgent : ServerProtocol::EPriority::Normal;
+	default:
+		return ServerProtocol::EPriority::Normal;
+	}
+}
+
+/**
+* Returns whether the command can run at the yield point of another one. The blueprint queries only load assets,
+* and skip their garbage collection when nested, and listing the tests only reads them, while the test adapter
+* would otherwise start a test run inside another one.
+*/
+static bool IsYieldSafe(ServerProtocol::ECommand Command, const FString& Params)
+{
+	switch (Command)
+	{
+	case ServerProtocol::ECommand::Ping:
+	case ServerProtocol::ECommand::BlueprintIndex:
+	case ServerProtocol::ECommand::BlueprintReferences:
+		return true;
+	case ServerProtocol::ECommand::TestAdapter:
+		return Params.Contains(TEXT("-listtests"));
+	default:
+		return false;
+	}
+}
+
+/**
+* Queue of the requests of a connection, shared by the thread that reads them and the game thread that runs them.
+*/
+class FRequestScheduler
+{
+public:
+	FRequestScheduler()
+		: WakeEvent(FPlatformProcess::GetSynchEventFromPool(false /*bIsManualReset*/))
+	{
+	}
+
+	~FRequestScheduler()
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	}
+
+	/** Queues a request. Returns false once the scheduler is closed. */
+	bool Push(FServerRequest&& Request)
+	{
+		{
+			FScopeLock Lock(&Mutex);
+			if (bClosed)
+			{
+				return false;
+			}
+
+			// Stable insertion after the requests with the same or a higher priority.
+			const int32 Index = Pending.IndexOfByPredicate([&](const FServerRequest& Other) { return Other.Priority > Request.Priority; });
+			Pending.Insert(MoveTemp(Request), Index == INDEX_NONE ? Pending.Num() : Index);
+		}
+
+		WakeEvent->Trigger();
+		return true;
+	}
+
+	/** Blocks until a request can run. Returns false when the scheduler is closed and no request is left. */
+	bool Pop(FServerRequest& OutRequest)
+	{
+		while (true)
+		{
+			{
+				FScopeLock Lock(&Mutex);
+				if (Pending.Num() > 0)
+				{
+					PopLocked(OutRequest, 0);
+					return true;
+				}
+
+				if (bClosed)
+				{
+					return false;
+				}
+			}
+
+			WakeEvent->Wait();
+		}
+	}
+
+	/**
+	* Takes the next urgent request that can run at a yield point, if any, without blocking.
+	* The other urgent requests stay queued until the running request is done.
+	*/
+	bool TryPopUrgent(FServerRequest& OutRequest)
+	{
+		FScopeLock Lock(&Mutex);
+		const int32 Index = Pending.IndexOfByPredicate([](const FServerRequest& Request)
+			{
+				return Request.Priority > ServerProtocol::EPriority::Urgent || IsYieldSafe(Request.Command, Request.Params);
+			});
+		if (Index == INDEX_NONE || Pending[Index].Priority > ServerProtocol::EPriority::Urgent)
+		{
+			return false;
+		}
+
+		PopLocked(OutRequest, Index);
+		return true;
+	}
+
+	void Finish(uint32 RequestId)
+	{
+		FScopeLock Lock(&Mutex);
+		Running.Remove(RequestId);
+	}
+
+	/**
+	* Cancels a request. A pending request is removed and returned in `OutRemoved`, to be answered by the caller,
+	* while a running one is asked to stop and answered when it does. Returns false if the request is unknown.
+	*/
+	bool Cancel(uint32 RequestId, TOptional<FServerRequest>& OutRemoved)
+	{
+		FScopeLock Lock(&Mutex);
+		const int32 Index = Pending.IndexOfByPredicate([&](const FServerRequest& Request) { return Request.Id == RequestId; });
+		if (Index != INDEX_NONE)
+		{
+			OutRemoved.Emplace(MoveTemp(Pending[Index]));
+			Pending.RemoveAt(Index);
+			return true;
+		}
+
+		if (const TSharedRef<FCancellationToken, ESPMode::ThreadSafe>* Token = Running.Find(RequestId))
+		{
+			(*Token)->Cancel();
+			return true;
+		}
+
+		return false;
+	}
+
+	/**
+	* Stops accepting requests and cancels the running ones. The pending requests are returned, to be answered by the caller.
+	* `Pop` returns false once the running requests are done.
+	*/
+	TArray<FServerRequest> Close()
+	{
+		TArray<FServerRequest> Removed;
+		{
+			FScopeLock Lock(&Mutex);
+			bClosed = true;
+			Removed = MoveTemp(Pending);
+			for (const auto& Item : Running)
+			{
+				Item.Value->Cancel();
+			}
+		}
+
+		WakeEvent->Trigger();
+		return Removed;
+	}
+
+private:
+	void PopLocked(FServerRequest& OutRequest, int32 Index)
+	{
+		OutRequest = MoveTemp(Pending[Index]);
+		Pending.RemoveAt(Index);
+		Running.Add(OutRequest.Id, OutRequest.Token);
+	}
+
+	FCriticalSection Mutex;
+	FEvent* WakeEvent;
+	TArray<FServerRequest> Pending;
+	TMap<uint32, TSharedRef<FCancellationToken, ESPMode::ThreadSafe>> Running;
+	bool bClosed = false;
+};
+
+/**
+* Serves a connection that uses the framed protocol from `VSServerProtocol.h`.
+* The requests are read on a separate thread, which answers the cheap ones right away, and run on the game thread.
+*/
+class FFramedSession
+{
+public:
+	FFramedSession(IServerConnection& InConnection, FContentChangeTracker& InContentChanges)
+		: Connection(InConnection)
+		, ContentChanges(InContentChanges)
+	{
+	}
+
+	/** Serves the connection until the client closes it or asks for a shutdown. Returns true on shutdown. */
+	bool Serve(const TArray<uint8>& InitialBytes)
+	{
+		TFuture<void> Reader = Async(EAsyncExecution::Thread, [this, InitialBytes]()
+			{
+				ReadRequests(InitialBytes);
+			});
+
+		FServerRequest Request;
+		while (Scheduler.Pop(Request))
+		{
+			RunRequest(Request);
+		}
+
+		// All the requests were answered, stop reading if it's still waiting for more.
+		Connection.StopReading();
+		Reader.Wait();
+
+		if (ShutdownRequestId.IsSet())
+		{
+			WriteResponse(Connection, ShutdownRequestId.GetValue(), 0, FString());
+			return true;
+		}
+
+		return false;
+	}
+
+private:
+	void ReadRequests(const TArray<uint8>& InitialBytes)
+	{
+		ServerProtocol::FMessageReader Reader;
+		Reader.Append(InitialBytes.GetData(), InitialBytes.Num());
+
+		while (true)
+		{
+			ServerProtocol::FMessage Message;
+			while (Reader.Next(Message))
+			{
+				if (!HandleMessage(Message))
+				{
+					// Shutting down, or the responses can't be written anymore.
+					Scheduler.Close();
+					return;
+				}
+			}
+
+			TArray<uint8> Bytes;
+			if (Reader.HasError() || !Connection.Read(Bytes))
+			{
+				if (Reader.HasError())
+				{
+					UE_LOG(LogVisualStudioTools, Warning, TEXT("Closing the server connection: %s"), UTF8_TO_TCHAR(Reader.GetError().c_str()));
+				}
+
+				// Nobody is left to read the responses, so only stop the requests.
+				Scheduler.Close();
+				return;
+			}
+
+			Reader.Append(Bytes.GetData(), Bytes.Num());
+		}
+	}
+
+	/** Handles a message on the reading thread. Returns false when no more requests should be read. */
+	bool HandleMessage(const ServerProtocol::FMessage& Message)
+	{
+		FServerRequest Request;
+		Request.Id = Message.RequestId;
+
+		FString CommandName;
+		FString PriorityName;
+		int64 Target = 0;
+
+		if (Message.Type != ServerProtocol::EMessageType::Request)
+		{
+			return WriteResponse(Connection, Request.Id, 1, TEXT("Expected a request message."));
+		}
+
+		const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Message.Payload.data()), static_cast<int32>(Message.Payload.size()));
+		TSharedPtr<FJsonObject> Json;
+
+		if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(FString(Converted.Length(), Converted.Get())), Json)
+			|| !Json.IsValid()
+			|| !Json->TryGetStringField(TEXT("command"), CommandName))
+		{
+			return WriteResponse(Connection, Request.Id, 1, TEXT("Invalid request."));
+		}
+
+		Json->TryGetStringField(TEXT("params"), Request.Params);
+		Request.Command = ServerProtocol::ParseCommand(TCHAR_TO_UTF8(*CommandName));
+		Request.Priority = GetDefaultPriority(Request.Command, Request.Params);
+		if (Json->TryGetStringField(TEXT("priority"), PriorityName) && !ServerProtocol::ParsePriority(TCHAR_TO_UTF8(*PriorityName), Request.Priority))
+		{
+			return WriteResponse(Connection, Request.Id, 1, TEXT("Invalid priority."));
+		}
+
+		switch (Request.Command)
+		{
+		case ServerProtocol::ECommand::Ping:
+			return WriteResponse(Connection, Request.Id, 0, FString());
+
+		case ServerProtocol::ECommand::Cancel:
+		{
+			TOptional<FServerRequest> Removed;
+			const bool bFound = Json->TryGetNumberField(TEXT("target"), Target) && Scheduler.Cancel(static_cast<uint32>(Target), Removed);
+			if (Removed.IsSet())
+			{
+				WriteResponse(Connection, Removed->Id, 1, TEXT("Cancelled."));
+			}
+			return WriteResponse(Connection, Request.Id, bFound ? 0 : 1, bFound ? FString() : TEXT("Unknown request."));
+		}
+
+		case ServerProtocol::ECommand::Shutdown:
+			// Answered by the game thread once the requests in progress are done.
+			ShutdownRequestId = Request.Id;
+			for (const FServerRequest& Removed : Scheduler.Close())
+			{
+				WriteResponse(Connection, Removed.Id, 1, TEXT("Cancelled, the server is shutting down."));
+			}
+			return false;
+
+		default:
+			if (!Scheduler.Push(MoveTemp(Request)))
+			{
+				return WriteResponse(Connection, Message.RequestId, 1, TEXT("The server is shutting down."));
+			}
+			return true;
+		}
+	}
+
+	/** Runs a request on the game thread, and the urgent ones that arrive while it is at a safe point. */
+	void RunRequest(const FServerRequest& Request)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+
+		FServerOutputArchive Output(Connection, Request.Id);
+		FString Error;
+		int32 Result = 0;
+		{
+			FScopedCancellationToken CancellationScope(*Request.Token);
+			FScopedYieldHandler YieldHandler([this]()
+				{
+					FServerRequest UrgentRequest;
+					while (Scheduler.TryPopUrgent(UrgentRequest))
+					{
+						RunRequest(UrgentRequest);
+					}
+				});
+
+			Result = ExecuteCommand(Request.Command, Request.Params, &Output, ContentChanges, Error);
+		}
+
+		Output.Close();
+		if (Request.Token->IsCancelled() && Error.IsEmpty())
+		{
+			Error = TEXT("Cancelled.");
+		}
+
+		Scheduler.Finish(Request.Id);
+		if (!WriteResponse(Connection, Request.Id, Result, Error))
+		{
+			UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to write the server response."));
+		}
+
+		UE_LOG(LogVisualStudioTools, Verbose, TEXT("Server request %u handled in %.3fms: %s %s"),
+			Request.Id, (FPlatformTime::Seconds() - StartTime) * 1000.0, UTF8_TO_TCHAR(ServerProtocol::LexToString(Request.Command)), *Request.Params);
+	}
+
+	IServerConnection& Connection;
+	FContentChangeTracker& ContentChanges;
+	FRequestScheduler Scheduler;
+
+	/** Set by the reading thread, and only read by the game thread after that thread is done. */
+	TOptional<uint32> ShutdownRequestId;
+};
+
+/**
+* Serves a request of the original protocol, where the command is guessed from the command line
+* and the response is "0" or "1". Returns true when the server should shut down.
+* The original protocol has no request IDs, so its requests are run one at a time as they are read, without the
+* scheduler of the framed protocol: no priorities, cancellation or yield points. Clients that need them use frames.
+*/
+static bool ServeLegacyRequest(IServerConnection& Connection, const TArray<uint8>& Bytes, FContentChangeTracker& ContentChanges)
+{
+	const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Bytes.GetData()), Bytes.Num());
+	const FString SubCommandletParams(Converted.Length(), Converted.Get());
+
+	// Determine which sub-commandlet to invoke, and write back result response.
+	ServerProtocol::ECommand Command = ServerProtocol::ECommand::Unknown;
+	if (SubCommandletParams.Contains("VSTestAdapter"))
+	{
+		Command = ServerProtocol::ECommand::TestAdapter;
+	}
+	else if (SubCommandletParams.Contains(PingParam))
+	{
+		Command = ServerProtocol::ECommand::Ping;
+	}
+	else if (SubCommandletParams.Contains(KillServerParam))
+	{
+		// When KillVSServer is passed in, end server mode once the request is answered.
+		Command = ServerProtocol::ECommand::Shutdown;
+	}
+
+	FString Error;
+	if (Command != ServerProtocol::ECommand::Shutdown)
+	{
+		ExecuteCommand(Command, SubCommandletParams, nullptr, ContentChanges, Error);
+	}
+
+	// The original protocol only reports whether the command was recognized.
+	const ANSICHAR* Result = Command == ServerProtocol::ECommand::Unknown ? "1" : "0";
+	if (!Connection.Write(Result, 1))
+	{
+		// The next read fails as well, and the server connects again.
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to write the server response."));
+	}
+
+	return Command == ServerProtocol::ECommand::Shutdown;
 }
 
-void UVSServerCommandlet::ExecuteSubCommandlet(FString ueServerNamedPipe)
+/**
+* Sends a legacy ping command line longer than the read buffer of the server, on its own connection since the
+* protocol is chosen per connection. The ping switch is at the end, so a command line read in several parts
+* gets the unknown command result for its first part.
+*/
+static bool RunLegacyCommandCheck(IServerTransport& Transport)
 {
-	char buffer[1024];
-	DWORD dwRead;
-	std::string result = "0";
+	TUniquePtr<IServerConnection> Connection = Transport.Listen();
+	if (!Connection.IsValid())
+	{
+		return false;
+	}
+
+	const FString CommandLine = FString::Printf(TEXT("-Padding=%s -%s"), *FString::ChrN(BenchmarkLegacyCommandLength, TEXT('x')), PingParam);
+	const FTCHARToUTF8 Converted(*CommandLine);
 
-	// Open the named pipe.
-	std::wstring pipeName = L"\\\\.\\pipe\\";
-	pipeName.append(ueServerNamedPipe.GetCharArray().GetData());
-	HANDLE HPipe = CreateFile(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
-	if (HPipe != INVALID_HANDLE_VALUE)
+	TArray<uint8> Response;
+	if (!Connection->Write(Converted.Get(), Converted.Length()) || !Connection->Read(Response))
 	{
-		ConnectNamedPipe(HPipe, NULL);
-		DWORD dwState;
-		BOOL bSuccess = GetNamedPipeHandleState(HPipe, &dwState, NULL, NULL, NULL, NULL, 0);
-		if (bSuccess)
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Long legacy command failed."));
+		return false;
+	}
+
+	if (Response.Num() != 1 || Response[0] != '0')
+	{
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Long legacy command of %d bytes was not read as a single message."), Converted.Length());
+		return false;
+	}
+
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Server answered a legacy command of %d bytes."), Converted.Length());
+	return true;
+}
+
+/**
+* Reference client of the framed protocol, playing the role of Visual Studio on the server transport.
+* Checks that a long legacy command line is read whole, logs the round trip times of the requests of
+* a trace over a single connection, pings by default, checks that pipelined requests are all answered,
+* and then shuts down the server.
+*/
+static void RunLatencyBenchmark(const FString& EndpointName, int32 Iterations, const FString& TracePath)
+{
+	// Each line of a trace is the JSON payload of a request, as sent by Visual Studio.
+	TArray<FString> Trace;
+	if (!TracePath.IsEmpty() && !FFileHelper::LoadFileToStringArray(Trace, *TracePath))
+	{
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to read the benchmark trace: %s"), *TracePath);
+		return;
+	}
+
+	Trace.RemoveAll([](const FString& Line) { return Line.TrimStartAndEnd().IsEmpty(); });
+	if (Trace.Num() == 0)
+	{
+		Trace.Add(FString::Printf(TEXT("{\"command\":\"%s\"}"), UTF8_TO_TCHAR(ServerProtocol::LexToString(ServerProtocol::ECommand::Ping))));
+	}
+
+	TUniquePtr<IServerTransport> Transport = CreateServerTransport(EndpointName);
+	RunLegacyCommandCheck(*Transport);
+
+	TUniquePtr<IServerConnection> Connection = Transport->Listen();
+	if (!Connection.IsValid())
+	{
+		return;
+	}
+
+	uint32 NextRequestId = 1;
+	auto SendRequests = [&](const FString& Payload, int32 Count)
+	{
+		const FTCHARToUTF8 Converted(*Payload);
+
+		std::vector<uint8_t> Frames;
+		for (int32 Index = 0; Index < Count; Index++)
 		{
-			// Read data from the named pipe.
-			ReadFile(HPipe, buffer, sizeof(buffer) - 1, &dwRead, NULL);
-			buffer[dwRead] = '\0';
-			std::string strSubCommandletParams(buffer, dwRead);
-			FString SubCommandletParams = FString(strSubCommandletParams.c_str());
+			ServerProtocol::WriteMessage(Frames, ServerProtocol::EMessageType::Request, NextRequestId++, Converted.Get(), Converted.Length());
+		}
 
-			// Determine which sub-commandlet to invoke, and write back result response.
-			if (SubCommandletParams.Contains("VSTestAdapter"))
+		return Connection->Write(Frames.data(), static_cast<int32>(Frames.size()));
+	};
+
+	ServerProtocol::FMessageReader Reader;
+	int64 OutputBytes = 0;
+	auto ReceiveResponses = [&](int32 Count)
+	{
+		ServerProtocol::FMessage Message;
+		while (Count > 0)
+		{
+			if (Reader.Next(Message))
 			{
-				UVSTestAdapterCommandlet *Commandlet = NewObject<UVSTestAdapterCommandlet>();
-				try
+				if (Message.Type == ServerProtocol::EMessageType::Response)
 				{
-					int32 subCommandletResult = Commandlet->Main(SubCommandletParams);
+					Count--;
 				}
-				catch (const std::exception &ex)
+				else
 				{
-					UE_LOG(LogVisualStudioTools, Display, TEXT("Exception invoking VSTestAdapter commandlet: %s"), UTF8_TO_TCHAR(ex.what()));
-					result = "0";
+					OutputBytes += Message.Payload.size();
 				}
+				continue;
 			}
-			else if (SubCommandletParams.Contains("KillVSServer"))
+
+			TArray<uint8> Bytes;
+			if (Reader.HasError() || !Connection->Read(Bytes))
 			{
-				// When KillVSServer is passed in, then kill the Unreal Editor process to end server mode.
-				exit(0);
+				return false;
 			}
-			else
+			Reader.Append(Bytes.GetData(), Bytes.Num());
+		}
+		return true;
+	};
+
+	TArray<double> Latencies;
+	const double TraceStartTime = FPlatformTime::Seconds();
+	bool bFailed = false;
+	for (int32 Iteration = 0; Iteration < Iterations && !bFailed; Iteration++)
+	{
+		for (const FString& Payload : Trace)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			if (!SendRequests(Payload, 1) || !ReceiveResponses(1))
 			{
-				// If cannot find which sub-commandlet to run, then return error.
-				result = "1";
+				UE_LOG(LogVisualStudioTools, Error, TEXT("Benchmark request failed: %s"), *Payload);
+				bFailed = true;
+				break;
 			}
 
-			WriteFile(HPipe, result.c_str(), result.size(), &dwRead, NULL);
+			Latencies.Add((FPlatformTime::Seconds() - StartTime) * 1000.0);
 		}
 	}
+	const double TraceTime = FPlatformTime::Seconds() - TraceStartTime;
+
+	if (Latencies.Num() > 0)
+	{
+		Latencies.Sort();
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Server latency over %d requests: { Min: %.3fms, P50: %.3fms, P99: %.3fms, Max: %.3fms }"),
+			Latencies.Num(), Latencies[0], Latencies[Latencies.Num() / 2], Latencies[Latencies.Num() * 99 / 100], Latencies.Last());
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Server throughput: %.1f requests/s, %.1f KB/s of output."),
+			Latencies.Num() / TraceTime, OutputBytes / 1024.0 / TraceTime);
+	}
+
+	const double PipelineStartTime = FPlatformTime::Seconds();
+	if (SendRequests(Trace[0], BenchmarkPipelineDepth) && ReceiveResponses(BenchmarkPipelineDepth))
+	{
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Server answered %d pipelined requests in %.3fms."),
+			BenchmarkPipelineDepth, (FPlatformTime::Seconds() - PipelineStartTime) * 1000.0);
+	}
+	else
+	{
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Pipelined benchmark requests failed."));
+	}
+
+	if (SendRequests(FString::Printf(TEXT("{\"command\":\"%s\"}"), UTF8_TO_TCHAR(ServerProtocol::LexToString(ServerProtocol::ECommand::Shutdown))), 1))
+	{
+		ReceiveResponses(1);
+	}
 }
+} // namespace VisualStudioTools
 
 int32 UVSServerCommandlet::Main(const FString &ServerParams)
 {
+	using namespace VisualStudioTools;
+
 	TArray<FString> Tokens;
 	TArray<FString> Switches;
 	TMap<FString, FString> ParamVals;
 
 	ParseCommandLine(*ServerParams, Tokens, Switches, ParamVals);
-	if (ParamVals.Contains(NamedPipeParam))
+	if (!ParamVals.Contains(NamedPipeParam))
 	{
-		FString ueServerNamedPipe = ParamVals[NamedPipeParam];
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Missing named pipe parameter."));
+		return 1;
+	}
 
-		// Infinite loop that listens to requests every second.
-		while (true)
+	TFuture<void> Benchmark;
+	if (const FString* Iterations = ParamVals.Find(LatencyBenchmarkParam))
+	{
+		Benchmark = Async(EAsyncExecution::Thread, [EndpointName = ParamVals[NamedPipeParam], Count = FCString::Atoi(**Iterations), TracePath = ParamVals.FindRef(LatencyBenchmarkTraceParam)]()
+			{
+				RunLatencyBenchmark(EndpointName, Count, TracePath);
+			});
+	}
+
+	TUniquePtr<IServerTransport> Transport = CreateServerTransport(ParamVals[NamedPipeParam]);
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Serving requests on: %s"), *Transport->GetAddress());
+
+	// Shared by all the connections, so only the first request scans the content again if nothing changes.
+	FContentChangeTracker ContentChanges;
+
+	// Serve requests until the server is asked to shut down, blocking on the transport instead of polling it.
+	TUniquePtr<IServerConnection> Connection;
+	bool bShutdown = false;
+	while (!bShutdown && !IsEngineExitRequested())
+	{
+		if (!Connection.IsValid())
 		{
-			std::this_thread::sleep_for(std::chrono::seconds(1));
-			ExecuteSubCommandlet(ueServerNamedPipe);
+			Connection = Transport->Connect();
+			if (!Connection.IsValid())
+			{
+				continue;
+			}
 		}
+
+		TArray<uint8> Bytes;
+		if (!Connection->Read(Bytes))
+		{
+			// The client closed its end, connect again for the next request.
+			Connection.Reset();
+			continue;
+		}
+
+		// The protocol is chosen by the first message of each connection.
+		if (ServerProtocol::IsFramed(Bytes.GetData(), Bytes.Num()))
+		{
+			FFramedSession Session(*Connection, ContentChanges);
+			bShutdown = Session.Serve(Bytes);
+			Connection.Reset();
+			continue;
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		bShutdown = ServeLegacyRequest(*Connection, Bytes, ContentChanges);
+
+		UE_LOG(LogVisualStudioTools, Verbose, TEXT("Server request handled in %.3fms."), (FPlatformTime::Seconds() - StartTime) * 1000.0);
 	}
-	else
+
+	if (Benchmark.IsValid())
 	{
-		UE_LOG(LogVisualStudioTools, Display, TEXT("Missing named pipe parameter."));
+		Benchmark.Wait();
 	}
 
-	return 1;
-}
\ No newline at end of file
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Server mode finished."));
+	return 0;
+}
@@ -23,7 +23,4 @@ public:
 
 public:
 	virtual int32 Main(const FString& Params) override;
-
-private:
-	void ExecuteSubCommandlet(FString ueServerNamedPipe);
 };
\ No newline at end of file
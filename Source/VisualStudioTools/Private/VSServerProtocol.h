@@ -0,0 +1,322 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+// Framing of the messages exchanged with the `VSServer` commandlet over its named pipe.
+// This header does not depend on the engine, so it can be shared with the clients of the server.
+//
+// Every message is sent as one or more frames, each one made of a fixed-size little-endian header
+// followed by `PayloadSize` bytes. Messages larger than `MaxFramePayload` are split into several frames
+// with the `FrameFlagContinued` flag set on all of them but the last one. Frames of different requests can be
+// interleaved, so several requests can be in flight over the same connection.
+//
+// A request is answered with any number of `Data` messages, carrying the output of the command as it
+// is produced, followed by exactly one `Response` message with the result. All of them have the ID of
+// the request.
+//
+// The payloads of the `Request` and `Response` messages are UTF-8 JSON objects:
+// - Request: `{ "command": "<name>", "params": "<command line>", "priority": "<priority>", "target": <request id> }`,
+//   with the names from `LexToString(ECommand)` and `LexToString(EPriority)`. Only `command` is required,
+//   and `target` is only used by `cancel`, to name the request to stop.
+//   The blueprint commands take the parameters of the `VisualStudioTools` and `VsBlueprintReferences` commandlets,
+//   without `-output`, and their output is sent in the `Data` messages instead of a file.
+// - Response: `{ "result": <exit code>, "error": "<message>" }`, where `error` is only set on failures.
+//
+// Requests are run in priority order, and the ones with the same priority in the order they were received.
+// `ping`, `cancel` and `shutdown` are answered right away, even while other requests are running.
+// Urgent `ping`, blueprint and test listing requests can also run at the safe points of a long one: between two
+// tests, and between two blueprints of a scan. The other urgent requests wait for it to finish, and a request run
+// at a safe point has none of its own.
+// A cancelled request stops at its next safe point and is answered with the output produced so far and an error.
+// `shutdown` cancels all the requests, waits for their responses to be sent and is answered last.
+//
+// Clients that do not start the connection with a frame are served with the original protocol, where
+// each pipe message is a command line and the response is "0" or "1". Those requests are run one at a time,
+// without priorities, cancellation or yield points.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace VisualStudioTools
+{
+namespace ServerProtocol
+{
+static constexpr uint32_t Magic = 0x50535356; // 'VSSP'
+static constexpr uint8_t Version = 1;
+static constexpr uint32_t HeaderSize = 16;
+static constexpr uint32_t MaxFramePayload = 64 * 1024;
+
+// Upper bound of a reassembled message, to reject corrupted streams before allocating for them.
+static constexpr uint32_t MaxMessageSize = 64 * 1024 * 1024;
+
+enum class EMessageType : uint8_t
+{
+	Request = 1,
+	Data = 2,
+	Response = 3,
+};
+
+// Set on every frame of a message but the last one.
+static constexpr uint8_t FrameFlagContinued = 1 << 0;
+
+enum class ECommand : uint8_t
+{
+	Unknown,
+	Ping,
+	TestAdapter,
+	Shutdown,
+	BlueprintIndex,
+	BlueprintReferences,
+	Cancel,
+};
+
+enum class EPriority : uint8_t
+{
+	Urgent,
+	Normal,
+	Background,
+};
+
+inline const char* LexToString(ECommand Command)
+{
+	switch (Command)
+	{
+	case ECommand::Ping:
+		return "ping";
+	case ECommand::TestAdapter:
+		return "test_adapter";
+	case ECommand::Shutdown:
+		return "shutdown";
+	case ECommand::BlueprintIndex:
+		return "blueprint_index";
+	case ECommand::BlueprintReferences:
+		return "blueprint_references";
+	case ECommand::Cancel:
+		return "cancel";
+	default:
+		return "unknown";
+	}
+}
+
+inline ECommand ParseCommand(std::string_view Name)
+{
+	for (ECommand Command : { ECommand::Ping, ECommand::TestAdapter, ECommand::Shutdown, ECommand::BlueprintIndex, ECommand::BlueprintReferences, ECommand::Cancel })
+	{
+		if (Name == LexToString(Command))
+		{
+			return Command;
+		}
+	}
+	return ECommand::Unknown;
+}
+
+inline const char* LexToString(EPriority Priority)
+{
+	switch (Priority)
+	{
+	case EPriority::Urgent:
+		return "urgent";
+	case EPriority::Background:
+		return "background";
+	default:
+		return "normal";
+	}
+}
+
+inline bool ParsePriority(std::string_view Name, EPriority& OutPriority)
+{
+	for (EPriority Priority : { EPriority::Urgent, EPriority::Normal, EPriority::Background })
+	{
+		if (Name == LexToString(Priority))
+		{
+			OutPriority = Priority;
+			return true;
+		}
+	}
+	return false;
+}
+
+struct FFrameHeader
+{
+	uint32_t Magic;
+	uint8_t Version;
+	EMessageType Type;
+	uint8_t Flags;
+	uint8_t Reserved;
+	uint32_t RequestId;
+	uint32_t PayloadSize;
+};
+
+static_assert(sizeof(FFrameHeader) == HeaderSize, "The frame header must match the wire layout.");
+
+struct FMessage
+{
+	EMessageType Type = EMessageType::Request;
+	uint32_t RequestId = 0;
+	std::vector<uint8_t> Payload;
+};
+
+/** Returns whether the data starts like a frame, to tell apart the clients of the original protocol. */
+inline bool IsFramed(const void* Data, size_t Size)
+{
+	uint32_t FirstWord = 0;
+	if (Size < sizeof(FirstWord))
+	{
+		return false;
+	}
+
+	std::memcpy(&FirstWord, Data, sizeof(FirstWord));
+	return FirstWord == Magic;
+}
+
+/** Appends the frames of a message to `Out`, splitting the payload as needed. */
+inline void WriteMessage(std::vector<uint8_t>& Out, EMessageType Type, uint32_t RequestId, const void* Payload, size_t Size)
+{
+	const uint8_t* Bytes = static_cast<const uint8_t*>(Payload);
+	size_t Offset = 0;
+	do
+	{
+		const uint32_t ChunkSize = static_cast<uint32_t>(Size - Offset < MaxFramePayload ? Size - Offset : MaxFramePayload);
+		const bool bLast = Offset + ChunkSize == Size;
+
+		FFrameHeader Header{};
+		Header.Magic = Magic;
+		Header.Version = Version;
+		Header.Type = Type;
+		Header.Flags = bLast ? 0 : FrameFlagContinued;
+		Header.RequestId = RequestId;
+		Header.PayloadSize = ChunkSize;
+
+		const size_t Start = Out.size();
+		Out.resize(Start + HeaderSize + ChunkSize);
+		std::memcpy(Out.data() + Start, &Header, HeaderSize);
+		if (ChunkSize > 0)
+		{
+			std::memcpy(Out.data() + Start + HeaderSize, Bytes + Offset, ChunkSize);
+		}
+
+		Offset += ChunkSize;
+	} while (Offset < Size);
+}
+
+inline void WriteMessage(std::vector<uint8_t>& Out, EMessageType Type, uint32_t RequestId, std::string_view Payload)
+{
+	WriteMessage(Out, Type, RequestId, Payload.data(), Payload.size());
+}
+
+/**
+* Reassembles the messages from the bytes received on a connection, in any split.
+* Once an invalid frame is found, the reader stays in the error state since the stream can't be resynchronized.
+*/
+class FMessageReader
+{
+public:
+	void Append(const void* Data, size_t Size)
+	{
+		const uint8_t* Bytes = static_cast<const uint8_t*>(Data);
+		Buffer.insert(Buffer.end(), Bytes, Bytes + Size);
+	}
+
+	/** Extracts the next complete message. Returns false when more data is needed or on errors. */
+	bool Next(FMessage& OutMessage)
+	{
+		while (Error.empty() && Buffer.size() - Offset >= HeaderSize)
+		{
+			FFrameHeader Header;
+			std::memcpy(&Header, Buffer.data() + Offset, HeaderSize);
+
+			if (Header.Magic != Magic)
+			{
+				Error = "Invalid frame header.";
+				return false;
+			}
+
+			if (Header.Version != Version)
+			{
+				Error = "Unsupported protocol version " + std::to_string(Header.Version) + ".";
+				return false;
+			}
+
+			if (Header.Type != EMessageType::Request && Header.Type != EMessageType::Data && Header.Type != EMessageType::Response)
+			{
+				Error = "Unknown message type " + std::to_string(static_cast<uint32_t>(Header.Type)) + ".";
+				return false;
+			}
+
+			if (Header.PayloadSize > MaxFramePayload)
+			{
+				Error = "Frame payload too large.";
+				return false;
+			}
+
+			if (Buffer.size() - Offset < HeaderSize + Header.PayloadSize)
+			{
+				break;
+			}
+
+			const uint8_t* Payload = Buffer.data() + Offset + HeaderSize;
+			Offset += HeaderSize + Header.PayloadSize;
+
+			const bool bFirstFrame = PartialMessages.find(Header.RequestId) == PartialMessages.end();
+			FMessage& Partial = PartialMessages[Header.RequestId];
+			if (bFirstFrame)
+			{
+				Partial.Type = Header.Type;
+				Partial.RequestId = Header.RequestId;
+			}
+			else if (Partial.Type != Header.Type)
+			{
+				Error = "Interleaved message types for request " + std::to_string(Header.RequestId) + ".";
+				return false;
+			}
+
+			if (Partial.Payload.size() + Header.PayloadSize > MaxMessageSize)
+			{
+				Error = "Message too large.";
+				return false;
+			}
+
+			Partial.Payload.insert(Partial.Payload.end(), Payload, Payload + Header.PayloadSize);
+
+			if ((Header.Flags & FrameFlagContinued) == 0)
+			{
+				OutMessage = std::move(Partial);
+				PartialMessages.erase(Header.RequestId);
+				Compact();
+				return true;
+			}
+		}
+
+		Compact();
+		return false;
+	}
+
+	bool HasError() const { return !Error.empty(); }
+
+	const std::string& GetError() const { return Error; }
+
+private:
+	void Compact()
+	{
+		// Drop the consumed bytes once they are a good part of the buffer, to avoid moving data on every frame.
+		if (Offset > 0 && Offset * 2 >= Buffer.size())
+		{
+			Buffer.erase(Buffer.begin(), Buffer.begin() + Offset);
+			Offset = 0;
+		}
+	}
+
+	std::vector<uint8_t> Buffer;
+	size_t Offset = 0;
+	std::map<uint32_t, FMessage> PartialMessages;
+	std::string Error;
+};
+} // namespace ServerProtocol
+} // namespace VisualStudioTools
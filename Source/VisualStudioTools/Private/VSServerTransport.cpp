@@ -0,0 +1,400 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "VSServerTransport.h"
+
+#include "HAL/PlatformProcess.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "VisualStudioTools.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#else
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace VisualStudioTools
+{
+/** Bounds of the back-off used while the endpoint does not exist, i.e. between the requests of the client. */
+static constexpr float MinConnectRetryInterval = 0.001f;
+static constexpr float MaxConnectRetryInterval = 0.05f;
+
+#if PLATFORM_WINDOWS
+/** Longest time to block waiting for the client to offer a pipe instance, before checking again. */
+static constexpr DWORD PipeWaitTimeoutMs = 1000;
+
+/**
+* Connection over a message-mode named pipe.
+* The pipe is opened for overlapped I/O, so that the responses can be written while a read is pending
+* on another thread, and that read can be interrupted.
+*/
+class FNamedPipeConnection : public IServerConnection
+{
+public:
+	explicit FNamedPipeConnection(HANDLE InHandle)
+		: Handle(InHandle)
+		, ReadEvent(CreateEventW(nullptr, true /*bManualReset*/, false /*bInitialState*/, nullptr))
+		, WriteEvent(CreateEventW(nullptr, true /*bManualReset*/, false /*bInitialState*/, nullptr))
+		, StopEvent(CreateEventW(nullptr, true /*bManualReset*/, false /*bInitialState*/, nullptr))
+	{
+	}
+
+	virtual ~FNamedPipeConnection() override
+	{
+		CloseHandle(Handle);
+		CloseHandle(ReadEvent);
+		CloseHandle(WriteEvent);
+		CloseHandle(StopEvent);
+	}
+
+	virtual bool Read(TArray<uint8>& OutBytes) override
+	{
+		uint8 Buffer[4096];
+		while (true)
+		{
+			OVERLAPPED Overlapped = {};
+			Overlapped.hEvent = ReadEvent;
+
+			DWORD BytesRead = 0;
+			BOOL bSuccess = ReadFile(Handle, Buffer, sizeof(Buffer), nullptr, &Overlapped);
+			const DWORD ReadError = bSuccess ? ERROR_SUCCESS : GetLastError();
+
+			// The read was not queued, e.g. the client closed its end, so there is no result to wait for.
+			if (!bSuccess && ReadError != ERROR_IO_PENDING && ReadError != ERROR_MORE_DATA)
+			{
+				return false;
+			}
+
+			if (ReadError == ERROR_IO_PENDING)
+			{
+				const HANDLE Events[] = { ReadEvent, StopEvent };
+				if (WaitForMultipleObjects(UE_ARRAY_COUNT(Events), Events, false /*bWaitAll*/, INFINITE) != WAIT_OBJECT_0)
+				{
+					CancelIoEx(Handle, &Overlapped);
+					GetOverlappedResult(Handle, &Overlapped, &BytesRead, true /*bWait*/);
+					return false;
+				}
+			}
+
+			bSuccess = GetOverlappedResult(Handle, &Overlapped, &BytesRead, true /*bWait*/);
+			OutBytes.Append(Buffer, BytesRead);
+
+			if (bSuccess)
+			{
+				return true;
+			}
+
+			// Messages longer than the buffer are read in several parts.
+			if (GetLastError() != ERROR_MORE_DATA)
+			{
+				return false;
+			}
+		}
+	}
+
+	virtual bool Write(const void* Data, int32 Size) override
+	{
+		FScopeLock Lock(&WriteLock);
+
+		OVERLAPPED Overlapped = {};
+		Overlapped.hEvent = WriteEvent;
+
+		DWORD BytesWritten = 0;
+		if (!WriteFile(Handle, Data, static_cast<DWORD>(Size), nullptr, &Overlapped) && GetLastError() != ERROR_IO_PENDING)
+		{
+			return false;
+		}
+
+		return GetOverlappedResult(Handle, &Overlapped, &BytesWritten, true /*bWait*/)
+			&& BytesWritten == static_cast<DWORD>(Size);
+	}
+
+	virtual void StopReading() override
+	{
+		SetEvent(StopEvent);
+	}
+
+private:
+	HANDLE Handle;
+	HANDLE ReadEvent;
+	HANDLE WriteEvent;
+	HANDLE StopEvent;
+	FCriticalSection WriteLock;
+};
+
+/**
+* Named pipe created by Visual Studio, which the server connects to as a client.
+* The connection is kept open after each request, so that a client that keeps its end open
+* can send the next request without waiting for the server to connect again.
+*/
+class FNamedPipeTransport : public IServerTransport
+{
+public:
+	explicit FNamedPipeTransport(const FString& Name)
+		: PipeName(FString(TEXT("\\\\.\\pipe\\")) + Name)
+	{
+	}
+
+	virtual TUniquePtr<IServerConnection> Connect() override
+	{
+		if (!WaitNamedPipeW(*PipeName, PipeWaitTimeoutMs))
+		{
+			// The pipe does not exist at all, so there is nothing to wait on. Back off until it is created.
+			if (GetLastError() == ERROR_FILE_NOT_FOUND)
+			{
+				FPlatformProcess::Sleep(RetryInterval);
+				RetryInterval = FMath::Min(RetryInterval * 2.0f, MaxConnectRetryInterval);
+			}
+			return nullptr;
+		}
+
+		HANDLE Handle = CreateFileW(*PipeName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+		if (Handle == INVALID_HANDLE_VALUE)
+		{
+			// Another client took the instance first, wait for the next one.
+			return nullptr;
+		}
+
+		// The client end opens in byte read mode, which would return the legacy command lines in arbitrary parts.
+		DWORD Mode = PIPE_READMODE_MESSAGE;
+		if (!SetNamedPipeHandleState(Handle, &Mode, nullptr, nullptr))
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to set the message read mode of the named pipe: %s (error %u)"), *PipeName, static_cast<uint32>(GetLastError()));
+			CloseHandle(Handle);
+			return nullptr;
+		}
+
+		RetryInterval = MinConnectRetryInterval;
+		return MakeUnique<FNamedPipeConnection>(Handle);
+	}
+
+	virtual TUniquePtr<IServerConnection> Listen() override
+	{
+		HANDLE Handle = CreateNamedPipeW(*PipeName, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED, PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT,
+			1 /*nMaxInstances*/, 4096 /*nOutBufferSize*/, 4096 /*nInBufferSize*/, 0 /*nDefaultTimeOut*/, nullptr);
+		if (Handle == INVALID_HANDLE_VALUE)
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to create the named pipe: %s"), *PipeName);
+			return nullptr;
+		}
+
+		OVERLAPPED Overlapped = {};
+		Overlapped.hEvent = CreateEventW(nullptr, true /*bManualReset*/, false /*bInitialState*/, nullptr);
+
+		bool bConnected = ConnectNamedPipe(Handle, &Overlapped) != 0;
+		if (!bConnected)
+		{
+			DWORD Unused = 0;
+			const DWORD Error = GetLastError();
+			bConnected = Error == ERROR_PIPE_CONNECTED
+				|| (Error == ERROR_IO_PENDING && GetOverlappedResult(Handle, &Overlapped, &Unused, true /*bWait*/));
+		}
+		CloseHandle(Overlapped.hEvent);
+
+		if (!bConnected)
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to connect the named pipe: %s"), *PipeName);
+			CloseHandle(Handle);
+			return nullptr;
+		}
+
+		return MakeUnique<FNamedPipeConnection>(Handle);
+	}
+
+	virtual const FString& GetAddress() const override
+	{
+		return PipeName;
+	}
+
+private:
+	const FString PipeName;
+	float RetryInterval = MinConnectRetryInterval;
+};
+#else
+/**
+* Connection over a Unix domain stream socket.
+*/
+class FSocketConnection : public IServerConnection
+{
+public:
+	explicit FSocketConnection(int InSocket)
+		: Socket(InSocket)
+	{
+	}
+
+	virtual ~FSocketConnection() override
+	{
+		close(Socket);
+	}
+
+	virtual bool Read(TArray<uint8>& OutBytes) override
+	{
+		uint8 Buffer[16 * 1024];
+		while (true)
+		{
+			const ssize_t BytesRead = recv(Socket, Buffer, sizeof(Buffer), 0);
+			if (BytesRead > 0)
+			{
+				OutBytes.Append(Buffer, static_cast<int32>(BytesRead));
+				return true;
+			}
+
+			// Zero bytes means the peer closed its end, or `StopReading` shut down the reads.
+			if (BytesRead == 0 || errno != EINTR)
+			{
+				return false;
+			}
+		}
+	}
+
+	virtual bool Write(const void* Data, int32 Size) override
+	{
+		FScopeLock Lock(&WriteLock);
+
+#if defined(MSG_NOSIGNAL)
+		// Report a closed peer as an error instead of raising SIGPIPE.
+		const int Flags = MSG_NOSIGNAL;
+#else
+		const int Flags = 0;
+#endif
+
+		const uint8* Bytes = static_cast<const uint8*>(Data);
+		int32 Offset = 0;
+		while (Offset < Size)
+		{
+			const ssize_t BytesWritten = send(Socket, Bytes + Offset, Size - Offset, Flags);
+			if (BytesWritten < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+			Offset += static_cast<int32>(BytesWritten);
+		}
+		return true;
+	}
+
+	virtual void StopReading() override
+	{
+		// Wakes up a blocked `recv`, which then returns 0.
+		shutdown(Socket, SHUT_RD);
+	}
+
+private:
+	const int Socket;
+	FCriticalSection WriteLock;
+};
+
+/**
+* Unix domain socket created by the client, which the server connects to.
+*/
+class FSocketTransport : public IServerTransport
+{
+public:
+	explicit FSocketTransport(const FString& Name)
+		: SocketPath(FPaths::IsRelative(Name) ? FPaths::Combine(FPlatformProcess::UserTempDir(), Name) : Name)
+	{
+	}
+
+	virtual TUniquePtr<IServerConnection> Connect() override
+	{
+		sockaddr_un Address;
+		const int Socket = MakeAddress(Address) ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+		if (Socket >= 0)
+		{
+			if (connect(Socket, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) == 0)
+			{
+				RetryInterval = MinConnectRetryInterval;
+				return MakeUnique<FSocketConnection>(Socket);
+			}
+			close(Socket);
+		}
+
+		// The socket does not exist or does not accept connections yet. Back off until it does.
+		FPlatformProcess::Sleep(RetryInterval);
+		RetryInterval = FMath::Min(RetryInterval * 2.0f, MaxConnectRetryInterval);
+		return nullptr;
+	}
+
+	virtual TUniquePtr<IServerConnection> Listen() override
+	{
+		sockaddr_un Address;
+		if (!MakeAddress(Address))
+		{
+			return nullptr;
+		}
+
+		const int ListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (ListenSocket < 0)
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to create the socket: %s"), *SocketPath);
+			return nullptr;
+		}
+
+		// Remove the socket file left behind by a previous client, if any.
+		unlink(Address.sun_path);
+
+		int Socket = -1;
+		if (bind(ListenSocket, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) == 0 && listen(ListenSocket, 1) == 0)
+		{
+			do
+			{
+				Socket = accept(ListenSocket, nullptr, nullptr);
+			} while (Socket < 0 && errno == EINTR);
+		}
+
+		close(ListenSocket);
+		unlink(Address.sun_path);
+
+		if (Socket < 0)
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to accept a connection on the socket: %s"), *SocketPath);
+			return nullptr;
+		}
+
+		return MakeUnique<FSocketConnection>(Socket);
+	}
+
+	virtual const FString& GetAddress() const override
+	{
+		return SocketPath;
+	}
+
+private:
+	bool MakeAddress(sockaddr_un& OutAddress) const
+	{
+		const FTCHARToUTF8 Path(*SocketPath);
+		if (Path.Length() >= static_cast<int32>(sizeof(OutAddress.sun_path)))
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Socket path too long: %s"), *SocketPath);
+			return false;
+		}
+
+		FMemory::Memzero(OutAddress);
+		OutAddress.sun_family = AF_UNIX;
+		FMemory::Memcpy(OutAddress.sun_path, Path.Get(), Path.Length());
+		return true;
+	}
+
+	const FString SocketPath;
+	float RetryInterval = MinConnectRetryInterval;
+};
+#endif
+
+TUniquePtr<IServerTransport> CreateServerTransport(const FString& Name)
+{
+#if PLATFORM_WINDOWS
+	return MakeUnique<FNamedPipeTransport>(Name);
+#else
+	return MakeUnique<FSocketTransport>(Name);
+#endif
+}
+} // namespace VisualStudioTools
@@ -0,0 +1,62 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace VisualStudioTools
+{
+/**
+* Connection between the `VSServer` commandlet and its client, independent of the platform.
+*/
+class IServerConnection
+{
+public:
+	virtual ~IServerConnection() = default;
+
+	/**
+	* Blocks until data is received and appends it.
+	* Named pipes return whole messages, while sockets return any part of the stream,
+	* so only the framed protocol is reliable on all the transports.
+	* Returns false if the connection was closed, or `StopReading` was called.
+	*/
+	virtual bool Read(TArray<uint8>& OutBytes) = 0;
+
+	/** Writes the data, from any thread. The writes are serialized, so the frames of different requests don't mix. */
+	virtual bool Write(const void* Data, int32 Size) = 0;
+
+	/** Interrupts the pending and future reads of the connection, from any thread. */
+	virtual void StopReading() = 0;
+};
+
+/**
+* Endpoint created by the client of the server, e.g. Visual Studio, that the server connects to.
+*/
+class IServerTransport
+{
+public:
+	virtual ~IServerTransport() = default;
+
+	/**
+	* Blocks until the client offers a connection, and connects to it.
+	* Returns null if there is nothing to connect to yet, after waiting for a bounded time.
+	*/
+	virtual TUniquePtr<IServerConnection> Connect() = 0;
+
+	/**
+	* Creates the endpoint as a client does, and blocks until the server connects to it.
+	* Used by the reference client of the latency benchmark.
+	*/
+	virtual TUniquePtr<IServerConnection> Listen() = 0;
+
+	/** Returns the platform address of the endpoint, for logging. */
+	virtual const FString& GetAddress() const = 0;
+};
+
+/**
+* Creates the transport of the current platform for the given endpoint name:
+* a named pipe on Windows, and a Unix domain socket elsewhere, in the user temp directory unless the name is a path.
+*/
+TUniquePtr<IServerTransport> CreateServerTransport(const FString& Name);
+} // namespace VisualStudioTools
@@ -2,6 +2,7 @@
 
 #include "VSTestAdapterCommandlet.h"
 
+#include "CommandletCancellation.h"
 #include "Runtime/Core/Public/Async/TaskGraphInterfaces.h"
 #include "Runtime/Core/Public/Containers/Ticker.h"
 #include "Runtime/Launch/Resources/Version.h"
@@ -110,6 +111,16 @@ static int32 RunTests(const FString& TestListFile, const FString& ResultsFile)
 
 	for (const FAutomationTestInfo& TestInfo : TestInfos)
 	{
+		// Between two tests, the requests waiting in the server can run without disturbing the test framework.
+		VisualStudioTools::YieldToUrgentRequests();
+
+		if (VisualStudioTools::IsCancellationRequested())
+		{
+			UE_LOG(LogVisualStudioTools, Warning, TEXT("Test run cancelled."));
+			AllSuccessful = false;
+			break;
+		}
+
 		const FString TestCommand = TestInfo.GetTestName();
 		const FString DisplayName = TestInfo.GetDisplayName();
 
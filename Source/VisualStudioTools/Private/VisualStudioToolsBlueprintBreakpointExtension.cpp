@@ -1,14 +1,9 @@
 #include "VisualStudioToolsBlueprintBreakpointExtension.h"
-#include "FSmartBSTR.h"
 #include <Modules/ModuleManager.h>
 #include <Framework/MultiBox/MultiBoxBuilder.h>
 #include <BlueprintGraphClasses.h>
 #include <EditorSubsystem.h>
-#include <unknwn.h>
-#include <Windows/WindowsPlatformStackWalk.h>
 #include <Subsystems/Subsystem.h>
-#include <Windows/WindowsPlatformMisc.h>
-#include <Windows/WindowsPlatformProcess.h>
 #include <SourceCodeNavigation.h>
 #include <GraphEditorModule.h>
 #include <Containers/Array.h>
@@ -26,13 +21,23 @@
 #include <Runtime/Launch/Resources/Version.h>
 #include <EditorStyleSet.h>
 
+#if PLATFORM_WINDOWS
+#include "FSmartBSTR.h"
+#include <unknwn.h>
+#include <Windows/WindowsPlatformStackWalk.h>
+#include <Windows/WindowsPlatformMisc.h>
+#include <Windows/WindowsPlatformProcess.h>
+
 #if ENGINE_MAJOR_VERSION < 5
 #include <DbgHelp.h>
 #include <Psapi.h>
 #endif
+#endif
 
 DEFINE_LOG_CATEGORY(LogUVisualStudioToolsBlueprintBreakpointExtension);
 
+#if PLATFORM_WINDOWS
+
 static const FName GraphEditorModuleName(TEXT("GraphEditor"));
 
 void UVisualStudioToolsBlueprintBreakpointExtension::Initialize(FSubsystemCollectionBase& Collection)
@@ -574,3 +579,13 @@ void UVisualStudioToolsBlueprintBreakpointExtension::ShowOperationResultNotifica
 	NotificationItem->SetCompletionState(bBreakpointAdded ? SNotificationItem::CS_Success : SNotificationItem::CS_Fail);
 	NotificationItem->ExpireAndFadeout();
 }
+#else
+// Breakpoints are set through the automation interface of Visual Studio, only available on Windows.
+void UVisualStudioToolsBlueprintBreakpointExtension::Initialize(FSubsystemCollectionBase& Collection)
+{
+}
+
+void UVisualStudioToolsBlueprintBreakpointExtension::Deinitialize()
+{
+}
+#endif
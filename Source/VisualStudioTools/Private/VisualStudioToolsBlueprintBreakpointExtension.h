@@ -6,9 +6,11 @@
 #include <EdGraph/EdGraphNode.h>
 #include <EdGraph/EdGraphPin.h>
 #include <GraphEditorModule.h>
+#include <Runtime/Launch/Resources/Version.h>
+#if PLATFORM_WINDOWS
 #include <VisualStudioDTE.h>
 #include <Microsoft/COMPointer.h>
-#include <Runtime/Launch/Resources/Version.h>
+#endif
 #include "VisualStudioToolsBlueprintBreakpointExtension.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogUVisualStudioToolsBlueprintBreakpointExtension, Log, All);
@@ -50,6 +52,7 @@ private:
 
 	FString GetProjectPath(const FString& ProjectDir);
 
+#if PLATFORM_WINDOWS
 	bool GetRunningVisualStudioDTE(TComPtr<EnvDTE::_DTE>& OutDTE);
 
 	void AttachDebuggerIfNecessary(const TComPtr<EnvDTE::Debugger>& Debugger);
@@ -61,4 +64,5 @@ private:
 
 	bool GetFunctionDefinitionLocation(const FString& FunctionSymbolName, const FString& FunctionModuleName, FString& SourceFilePath, uint32& SourceLineNumber);
 #endif
+#endif
 };
@@ -6,11 +6,19 @@
 #include "AssetRegistry/AssetRegistryModule.h"
 #include "Blueprint/BlueprintSupport.h"
 #include "BlueprintAssetHelpers.h"
+#include "BlueprintIndexBuilder.h"
+#include "BlueprintIndexCache.h"
+#include "BlueprintIndexFormat.h"
+#include "BlueprintIndexShards.h"
+#include "CommandletCancellation.h"
+#include "CommandletPerf.h"
 #include "Engine/BlueprintGeneratedClass.h"
-#include "JsonObjectConverter.h"
+#include "HAL/FileManager.h"
+#include "Misc/PackageName.h"
 #include "Misc/Paths.h"
 #include "Misc/ScopeExit.h"
 #include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonWriter.h"
 #include "SourceCodeNavigation.h"
 #include "UObject/CoreRedirects.h"
 #include "UObject/UObjectIterator.h"
@@ -19,35 +27,86 @@
 namespace VisualStudioTools
 {
 static const FName CategoryFName = TEXT("Category");
-static const FName ModuleNameFName = TEXT("ModuleName");
 
-static TArray<FProperty*> GetChangedPropertiesList(
-	UStruct* InStruct, const uint8* DataPtr, const uint8* DefaultDataPtr)
+/**
+* How much data is extracted for each blueprint. Only the `Parents` level can be
+* computed from the asset registry tags, the other ones require loading the blueprints.
+*/
+enum class EScanLevel : uint8
 {
-	TArray<FProperty*> Result;
+	Parents,
+	Functions,
+	Properties,
+};
 
-	const UClass* OwnerClass = Cast<UClass>(InStruct);
+static const TCHAR* LexToString(EScanLevel Level)
+{
+	switch (Level)
+	{
+	case EScanLevel::Parents:
+		return TEXT("parents");
+	case EScanLevel::Functions:
+		return TEXT("functions");
+	default:
+		return TEXT("properties");
+	}
+}
 
-	// Walk only in the properties defined in the current class, the super classes are processed individually
-	for (TFieldIterator<FProperty> It(OwnerClass, EFieldIteratorFlags::ExcludeSuper); It; ++It)
+static bool LexTryParseString(EScanLevel& OutLevel, const TCHAR* Value)
+{
+	for (EScanLevel Level : { EScanLevel::Parents, EScanLevel::Functions, EScanLevel::Properties })
 	{
-		FProperty* Property = *It;
-		for (int32 Idx = 0; Idx < Property->ArrayDim; Idx++)
+		if (FCString::Stricmp(Value, LexToString(Level)) == 0)
 		{
-			const uint8* PropertyValue = Property->ContainerPtrToValuePtr<uint8>(DataPtr, Idx);
-			const uint8* DefaultPropertyValue = Property->ContainerPtrToValuePtrForDefaults<uint8>(InStruct, DefaultDataPtr, Idx);
+			OutLevel = Level;
+			return true;
+		}
+	}
 
-			if (!Property->Identical(PropertyValue, DefaultPropertyValue))
-			{
-				Result.Add(Property);
-				break;
-			}
+	return false;
+}
+
+enum class EOutputFormat : uint8
+{
+	Json,
+	Ndjson,
+	Binary,
+};
+
+static const TCHAR* LexToString(EOutputFormat Format)
+{
+	switch (Format)
+	{
+	case EOutputFormat::Ndjson:
+		return TEXT("ndjson");
+	case EOutputFormat::Binary:
+		return TEXT("binary");
+	default:
+		return TEXT("json");
+	}
+}
+
+static bool LexTryParseString(EOutputFormat& OutFormat, const TCHAR* Value)
+{
+	for (EOutputFormat Format : { EOutputFormat::Json, EOutputFormat::Ndjson, EOutputFormat::Binary })
+	{
+		if (FCString::Stricmp(Value, LexToString(Format)) == 0)
+		{
+			OutFormat = Format;
+			return true;
 		}
 	}
 
-	return Result;
+	return false;
 }
 
+struct FScanOptions
+{
+	EScanLevel Level = EScanLevel::Properties;
+	int32 MaxInFlight = AssetHelpers::DefaultMaxInFlight;
+	int32 MaxMemoryMB = 0;
+};
+
 static bool FindBlueprintNativeParents(
 	const UClass* BlueprintGeneratedClass, TFunctionRef<void(UClass*)> Callback)
 {
@@ -65,164 +124,190 @@ static bool FindBlueprintNativeParents(
 	return bAnyNativeParent;
 }
 
-struct FPropertyEntry
+/**
+* Extracts the contribution of the blueprint to the index as plain data.
+* Returns false if the blueprint does not derive from any native class.
+*/
+static bool MakeBlueprintRecord(
+	const UBlueprintGeneratedClass* BlueprintGeneratedClass, EScanLevel Level, FNativeClassCache& ClassCache, FBlueprintRecord& OutRecord)
 {
-	FProperty* Property;
-	TArray<int32> Blueprints;
-};
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::MakeBlueprintRecord);
 
-struct FFunctionEntry
-{
-	UFunction* Function;
-	TArray<int32> Blueprints;
-};
+	if (BlueprintGeneratedClass == nullptr)
+	{
+		return false;
+	}
 
-struct FClassEntry
-{
-	const UClass* Class;
-	TArray<int32> Blueprints;
-	TMap<FString, FPropertyEntry> Properties;
-	TMap<FString, FFunctionEntry> Functions;
-};
+	OutRecord.Name = BlueprintGeneratedClass->GetName();
+	OutRecord.Path = BlueprintGeneratedClass->GetPathName();
 
-using ClassMap = TMap<FString, FClassEntry>;
+	const uint8* GeneratedClassDefault = reinterpret_cast<const uint8*>(BlueprintGeneratedClass->GetDefaultObject(false));
 
-struct FAssetIndex
-{
-	TSet<FString> AssetPathCache;
-	ClassMap Classes;
-	TArray<const UClass*> Blueprints;
+	// Functions defined directly in the BP class, which override the ones from the parents.
+	TSet<FName> BlueprintFunctions;
+	for (TFieldIterator<UFunction> It(BlueprintGeneratedClass, EFieldIteratorFlags::ExcludeSuper); It; ++It)
+	{
+		BlueprintFunctions.Add(It->GetFName());
+	}
 
-	void ProcessBlueprint(const UBlueprintGeneratedClass* BlueprintGeneratedClass)
+	return FindBlueprintNativeParents(BlueprintGeneratedClass, [&](UClass* Parent)
 	{
-		if (BlueprintGeneratedClass == nullptr)
-		{
-			return;
-		}
+		const FNativeClassInfo& ParentInfo = ClassCache.Get(Parent);
 
-		int32 BlueprintIndex = Blueprints.Num();
+		FParentRecord& ParentRecord = OutRecord.Parents.AddDefaulted_GetRef();
+		ParentRecord.Class = Parent;
 
-		bool bHasAnyParent = FindBlueprintNativeParents(BlueprintGeneratedClass, [&](UClass* Parent)
+		// Retrieve the properties from the parent class that changed in the Blueprint class, by comparing their CDOs.
+		if (Level >= EScanLevel::Properties && GeneratedClassDefault != nullptr && ParentInfo.DefaultObject != nullptr)
 		{
-			FString ParentName = Parent->GetFName().ToString();
-			if (!Classes.Contains(ParentName))
-			{
-				Classes.Add(ParentName).Class = Parent;
-			}
-
-			FClassEntry& ClassEntry = Classes[ParentName];
-
-			ClassEntry.Blueprints.Add(BlueprintIndex);
-
-			// Retrieve the properties from the parent class that changed in the Blueprint class, by comparing their CDOs.
-			UObject* GeneratedClassDefault = BlueprintGeneratedClass->GetDefaultObject(false);
-			UObject* SuperClassDefault = Parent->GetDefaultObject(false);
-			TArray<FProperty*> ChangedProperties = GetChangedPropertiesList(Parent, (uint8*)GeneratedClassDefault, (uint8*)SuperClassDefault);
+			TArray<FProperty*> ChangedProperties = GetChangedPropertiesList(ParentInfo.Layout, GeneratedClassDefault, ParentInfo.DefaultObject);
 
 			for (FProperty* Property : ChangedProperties)
 			{
-				FString PropertyName = Property->GetFName().ToString();
-				if (!ClassEntry.Properties.Contains(PropertyName))
-				{
-					ClassEntry.Properties.Add(PropertyName).Property = Property;
-				}
-
-				FPropertyEntry& PropEntry = ClassEntry.Properties[PropertyName];
-				PropEntry.Blueprints.Add(BlueprintIndex);
+				FPropertyRecord& PropRecord = ParentRecord.Properties.AddDefaulted_GetRef();
+				PropRecord.Name = Property->GetFName();
+				PropRecord.Value = MakePropertyValue(Property, Property->ContainerPtrToValuePtr<uint8>(GeneratedClassDefault));
 			}
+		}
 
-			// Iterate over the functions originally from the parent class
-			// and check if they are implemented in the BP class as well.
-			for (TFieldIterator<UFunction> It(Parent, EFieldIteratorFlags::ExcludeSuper); It; ++It)
+		// Check which of the functions originally from the parent class are implemented in the BP class as well.
+		if (BlueprintFunctions.Num() > 0)
+		{
+			for (FName FnName : ParentInfo.Functions)
 			{
-				UFunction* Fn = BlueprintGeneratedClass->FindFunctionByName((*It)->GetFName(), EIncludeSuperFlag::ExcludeSuper);
-				// If the function not present in the BP class directly, it means it was implemented. Otherwise, ignore.
-				if (!Fn)
+				if (BlueprintFunctions.Contains(FnName))
 				{
-					continue;
+					ParentRecord.Functions.Add(FnName);
 				}
+			}
+		}
+	});
+}
 
-				FString FnName = Fn->GetFName().ToString();
-				if (!ClassEntry.Functions.Contains(FnName))
-				{
-					ClassEntry.Functions.Add(FnName).Function = Fn;
-				}
+/**
+* Resolves the native parent class from the blueprint tags.
+* Most blueprints share a handful of native parents, so the redirect and class lookups are cached by tag value.
+*/
+struct FNativeParentResolver
+{
+	TMap<FString, const UClass*> Classes;
 
-				FFunctionEntry& FuncEntry = ClassEntry.Functions[FnName];
-				FuncEntry.Blueprints.Add(BlueprintIndex);
-			}
-		});
+	const UClass* Resolve(const FString& NativeParentTag)
+	{
+		if (const UClass** Cached = Classes.Find(NativeParentTag))
+		{
+			return *Cached;
+		}
 
-		if (bHasAnyParent)
+		const UClass* NativeParent = nullptr;
+		const FString NativeParentPath = FPackageName::ExportTextPathToObjectPath(NativeParentTag);
+		if (!NativeParentPath.IsEmpty())
 		{
-			check(Blueprints.Add(BlueprintGeneratedClass) == BlueprintIndex);
+			// The tag keeps the class name from when the asset was saved, which might have been redirected since.
+			const FCoreRedirectObjectName NativeParentName = FCoreRedirects::GetRedirectedName(
+				ECoreRedirectFlags::Type_Class, FCoreRedirectObjectName(NativeParentPath));
+
+			NativeParent = FSoftClassPath(NativeParentName.ToString()).ResolveClass();
+			if (NativeParent != nullptr && !NativeParent->HasAnyClassFlags(CLASS_Native))
+			{
+				NativeParent = nullptr;
+			}
 		}
 
-		return;
+		Classes.Add(NativeParentTag, NativeParent);
+		return NativeParent;
 	}
 };
 
-using JsonWriter = TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>;
-
-static bool ShouldSerializePropertyValue(FProperty* Property)
+/**
+* Builds the record of a blueprint using only the asset registry tags, without loading it.
+* The native parents are resolved from the closest one, which is always in memory.
+*/
+static bool MakeBlueprintRecordFromTags(const FAssetData& AssetData, FNativeParentResolver& Resolver, FBlueprintRecord& OutRecord)
 {
-	if (Property->ArrayDim > 1) // Skip properties that are not scalars
+	const FString GeneratedClassPath = FPackageName::ExportTextPathToObjectPath(AssetData.GetTagValueRef<FString>(FBlueprintTags::GeneratedClassPath));
+	const FString NativeParentTag = AssetData.GetTagValueRef<FString>(FBlueprintTags::NativeParentClassPath);
+	if (GeneratedClassPath.IsEmpty() || NativeParentTag.IsEmpty())
 	{
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Missing blueprint tags, consider re-saving it. Skipping. %s"), *AssetData.PackageName.ToString());
 		return false;
 	}
 
-	if (FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property))
+	const UClass* NativeParent = Resolver.Resolve(NativeParentTag);
+	if (NativeParent == nullptr)
 	{
-		return true;
+		UE_LOG(LogVisualStudioTools, Warning, TEXT("Failed to find native parent class. Skipping. { Blueprint: %s, NativeParent: %s }"), *GeneratedClassPath, *NativeParentTag);
+		return false;
 	}
 
-	if (FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+	OutRecord.Name = FPackageName::ObjectPathToObjectName(GeneratedClassPath);
+	OutRecord.Path = GeneratedClassPath;
+
+	for (const UClass* Class = NativeParent; Class; Class = Class->GetSuperClass())
 	{
-		UEnum* EnumDef = NumericProperty->GetIntPropertyEnum();
-		if (EnumDef != NULL)
+		// Ignore the root `UObject` class, same as `FindBlueprintNativeParents`.
+		if (Class->HasAnyClassFlags(CLASS_Native) && Class->GetFName() != NAME_Object)
 		{
-			return true;
+			OutRecord.Parents.AddDefaulted_GetRef().Class = Class;
 		}
+	}
 
-		if (NumericProperty->IsFloatingPoint())
-		{
-			return true;
-		}
+	return OutRecord.Parents.Num() > 0;
+}
 
-		if (NumericProperty->IsInteger())
-		{
-			return true;
-		}
-	}
+using JsonWriter = TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>;
 
-	if (FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+static void SerializeBlueprints(TSharedRef<JsonWriter>& Json, const TArray<FBlueprintEntry>& Items)
+{
+	Json->WriteArrayStart();
+	for (const FBlueprintEntry& Blueprint : Items)
 	{
-		return true;
+		Json->WriteObjectStart();
+
+		Json->WriteValue(TEXT("name"), Blueprint.Name);
+		Json->WriteValue(TEXT("path"), Blueprint.Path);
+		Json->WriteObjectEnd();
 	}
+	Json->WriteArrayEnd();
+}
 
-	if (FStrProperty* StringProperty = CastField<FStrProperty>(Property))
+static void SerializePropertyValue(TSharedRef<JsonWriter>& Json, const FPropertyValue& Value)
+{
+	switch (Value.Kind)
 	{
-		return true;
+	case FPropertyValue::EKind::Bool:
+		Json->WriteValue(TEXT("value"), Value.bBool);
+		break;
+	case FPropertyValue::EKind::Number:
+		Json->WriteValue(TEXT("value"), Value.Number);
+		break;
+	case FPropertyValue::EKind::String:
+		Json->WriteValue(TEXT("value"), Value.String);
+		break;
+	default:
+		break;
 	}
+}
 
-	return false;
+static FString GetClassDisplayName(const UClass* Class)
+{
+	return FString::Printf(TEXT("%s%s"), Class->GetPrefixCPP(), *Class->GetName());
 }
 
-static void SerializeBlueprints(TSharedRef<JsonWriter>& Json, TArray<const UClass*> Items)
+static void SerializePropertyMetadata(TSharedRef<JsonWriter>& Json, const FProperty* Property)
 {
-	Json->WriteArrayStart();
-	for (const UClass* Blueprint : Items)
+	Json->WriteIdentifierPrefix(TEXT("metadata"));
 	{
 		Json->WriteObjectStart();
-
-		Json->WriteValue(TEXT("name"), Blueprint->GetName());
-		Json->WriteValue(TEXT("path"), Blueprint->GetPathName());
+		if (Property->HasMetaData(CategoryFName))
+		{
+			Json->WriteValue(TEXT("categories"), Property->GetMetaData(CategoryFName));
+		}
 		Json->WriteObjectEnd();
 	}
-	Json->WriteArrayEnd();
 }
 
-static void SerializeProperties(TSharedRef<JsonWriter>& Json, FClassEntry& Entry, TArray<const UClass*>& Blueprints)
+static void SerializeProperties(TSharedRef<JsonWriter>& Json, const FClassEntry& Entry)
 {
 	Json->WriteArrayStart();
 	for (auto& Item : Entry.Properties)
@@ -233,35 +318,19 @@ static void SerializeProperties(TSharedRef<JsonWriter>& Json, FClassEntry& Entry
 
 		Json->WriteObjectStart();
 
-		Json->WriteValue(TEXT("name"), PropName);
+		Json->WriteValue(TEXT("name"), PropName.ToString());
 
-		Json->WriteIdentifierPrefix(TEXT("metadata"));
-		{
-			Json->WriteObjectStart();
-			if (Property->HasMetaData(CategoryFName))
-			{
-				Json->WriteValue(TEXT("categories"), Property->GetMetaData(CategoryFName));
-			}
-			Json->WriteObjectEnd();
-		}
+		SerializePropertyMetadata(Json, Property);
 
 		Json->WriteIdentifierPrefix(TEXT("values"));
 		{
 			Json->WriteArrayStart();
-			for (auto& BlueprintEntry : PropEntry.Blueprints)
+			for (int32 Idx = 0; Idx < PropEntry.Blueprints.Num(); Idx++)
 			{
 				Json->WriteObjectStart();
 
-				Json->WriteValue(TEXT("blueprint"), BlueprintEntry);
-
-				UObject* GeneratedClassDefault = Blueprints[BlueprintEntry]->GetDefaultObject(false);
-				const uint8* PropData = PropEntry.Property->ContainerPtrToValuePtr<uint8>(GeneratedClassDefault);
-
-				if (ShouldSerializePropertyValue(PropEntry.Property))
-				{
-					TSharedPtr<FJsonValue> JsonValue = FJsonObjectConverter::UPropertyToJsonValue(Property, PropData);
-					FJsonSerializer::Serialize(JsonValue.ToSharedRef(), TEXT("value"), Json);
-				}
+				Json->WriteValue(TEXT("blueprint"), PropEntry.Blueprints[Idx]);
+				SerializePropertyValue(Json, PropEntry.Values[Idx]);
 
 				Json->WriteObjectEnd();
 			}
@@ -273,7 +342,7 @@ static void SerializeProperties(TSharedRef<JsonWriter>& Json, FClassEntry& Entry
 	Json->WriteArrayEnd();
 }
 
-static void SerializeFunctions(TSharedRef<JsonWriter>& Json, FClassEntry& Entry)
+static void SerializeFunctions(TSharedRef<JsonWriter>& Json, const FClassEntry& Entry)
 {
 	Json->WriteArrayStart();
 	for (auto& Item : Entry.Functions)
@@ -281,27 +350,26 @@ static void SerializeFunctions(TSharedRef<JsonWriter>& Json, FClassEntry& Entry)
 		auto& Name = Item.Key;
 		auto& FnEntry = Item.Value;
 		Json->WriteObjectStart();
-		Json->WriteValue(TEXT("name"), Name);
+		Json->WriteValue(TEXT("name"), Name.ToString());
 		Json->WriteValue(TEXT("blueprints"), FnEntry.Blueprints);
 		Json->WriteObjectEnd();
 	}
 	Json->WriteArrayEnd();
 }
 
-static void SerializeClasses(TSharedRef<JsonWriter>& Json, ClassMap& Items, TArray<const UClass*> Blueprints)
+static void SerializeClasses(TSharedRef<JsonWriter>& Json, const ClassMap& Items)
 {
 	Json->WriteArrayStart();
 	for (auto& Item : Items)
 	{
-		auto& ClassName = Item.Key;
 		auto& Entry = Item.Value;
 		Json->WriteObjectStart();
-		Json->WriteValue(TEXT("name"), FString::Printf(TEXT("%s%s"), Entry.Class->GetPrefixCPP(), *Entry.Class->GetName()));
+		Json->WriteValue(TEXT("name"), GetClassDisplayName(Entry.Class));
 
 		Json->WriteValue(TEXT("blueprints"), Entry.Blueprints);
 
 		Json->WriteIdentifierPrefix(TEXT("properties"));
-		SerializeProperties(Json, Entry, Blueprints);
+		SerializeProperties(Json, Entry);
 
 		Json->WriteIdentifierPrefix(TEXT("functions"));
 		SerializeFunctions(Json, Entry);
@@ -311,8 +379,93 @@ static void SerializeClasses(TSharedRef<JsonWriter>& Json, ClassMap& Items, TArr
 	Json->WriteArrayEnd();
 }
 
-static void SerializeToIndex(FAssetIndex Index, FArchive& IndexFile)
+using FBlueprintRecordSink = TFunctionRef<void(const FBlueprintRecord&)>;
+
+/**
+* Time spent on each phase of the scan, and the memory used while loading the blueprints.
+*/
+struct FScanStats
+{
+	FPerfTime Query;
+	FPerfTime Load;
+	FPerfTime Extract;
+	FPerfTime Output;
+	AssetHelpers::FLoadStats Memory;
+
+	/** Emits a record to the sink, accounting the time spent there as output. */
+	void Emit(FBlueprintRecordSink OnBlueprint, const FBlueprintRecord& Record)
+	{
+		FScopedPerfTimer Timer(Output);
+		OnBlueprint(Record);
+	}
+};
+
+static void SerializePerfTime(TSharedRef<JsonWriter>& Json, const TCHAR* Name, const FPerfTime& Time)
+{
+	Json->WriteIdentifierPrefix(Name);
+	Json->WriteObjectStart();
+	Json->WriteValue(TEXT("wall_seconds"), Time.Wall);
+	Json->WriteValue(TEXT("cpu_seconds"), Time.Cpu);
+	Json->WriteObjectEnd();
+}
+
+/**
+* Writes the scan instrumentation. It's written last, so the output phase and the bytes written
+* cover everything in the file except the metadata itself.
+*/
+static void SerializeMetadata(TSharedRef<JsonWriter>& Json, const FScanStats& Stats, int64 BytesWritten)
+{
+	constexpr double BytesPerMB = 1024.0 * 1024.0;
+	const AssetHelpers::FLoadStats& LoadStats = Stats.Memory;
+
+	Json->WriteObjectStart();
+
+	Json->WriteIdentifierPrefix(TEXT("memory"));
+	Json->WriteObjectStart();
+	Json->WriteValue(TEXT("peak_mb"), LoadStats.PeakUsedMemory / BytesPerMB);
+	Json->WriteValue(TEXT("average_mb"), LoadStats.GetAverageUsedMemory() / BytesPerMB);
+	Json->WriteValue(TEXT("gc_count"), LoadStats.GCCount);
+	Json->WriteValue(TEXT("gc_seconds"), LoadStats.GCTime.Wall);
+	Json->WriteObjectEnd();
+
+	Json->WriteIdentifierPrefix(TEXT("perf"));
+	Json->WriteObjectStart();
+
+	Json->WriteIdentifierPrefix(TEXT("phases"));
+	Json->WriteObjectStart();
+	SerializePerfTime(Json, TEXT("query"), Stats.Query);
+	SerializePerfTime(Json, TEXT("load"), Stats.Load);
+	SerializePerfTime(Json, TEXT("extract"), Stats.Extract);
+	SerializePerfTime(Json, TEXT("gc"), LoadStats.GCTime);
+	SerializePerfTime(Json, TEXT("output"), Stats.Output);
+	Json->WriteObjectEnd();
+
+	Json->WriteIdentifierPrefix(TEXT("slowest_loads"));
+	Json->WriteArrayStart();
+	for (const AssetHelpers::FAssetLoadTime& Load : LoadStats.SlowestLoads)
+	{
+		Json->WriteObjectStart();
+		Json->WriteValue(TEXT("path"), Load.Path);
+		Json->WriteValue(TEXT("seconds"), Load.Seconds);
+		Json->WriteObjectEnd();
+	}
+	Json->WriteArrayEnd();
+
+	// The peak of the whole process, which also covers the phases that don't load blueprints.
+	const uint64 PeakUsedMemory = FMath::Max<uint64>(LoadStats.PeakUsedMemory, FPlatformMemory::GetStats().PeakUsedPhysical);
+	Json->WriteValue(TEXT("bytes_written"), BytesWritten);
+	Json->WriteValue(TEXT("peak_memory_mb"), PeakUsedMemory / BytesPerMB);
+
+	Json->WriteObjectEnd();
+
+	Json->WriteObjectEnd();
+}
+
+static void SerializeToIndex(const FAssetIndex& Index, FScanStats& Stats, FArchive& IndexFile)
 {
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::SerializeToIndex);
+	const FPerfTime Start = FPerfTime::Now();
+
 	TSharedRef<JsonWriter> Json = JsonWriter::Create(&IndexFile);
 
 	Json->WriteObjectStart();
@@ -321,39 +474,322 @@ static void SerializeToIndex(FAssetIndex Index, FArchive& IndexFile)
 	SerializeBlueprints(Json, Index.Blueprints);
 
 	Json->WriteIdentifierPrefix(TEXT("classes"));
-	SerializeClasses(Json, Index.Classes, Index.Blueprints);
+	SerializeClasses(Json, Index.Classes);
+
+	Stats.Output += FPerfTime::Now() - Start;
+
+	Json->WriteIdentifierPrefix(TEXT("metadata"));
+	SerializeMetadata(Json, Stats, IndexFile.Tell());
 
 	Json->WriteObjectEnd();
 	Json->Close();
 }
 
-static TArray<FString> GetModulesByPath(const FString& InDir)
+static uint32 AddBinaryString(BinaryIndex::FBinaryIndexWriter& Writer, const FString& Value)
+{
+	const FTCHARToUTF8 Utf8(*Value);
+	return Writer.AddString(std::string_view(Utf8.Get(), Utf8.Length()));
+}
+
+static BinaryIndex::FBinaryValue MakeBinaryValue(int32 Blueprint, const FPropertyValue& Value, BinaryIndex::FBinaryIndexWriter& Writer)
+{
+	using namespace BinaryIndex;
+
+	FBinaryValue Result = {};
+	Result.Blueprint = Blueprint;
+
+	switch (Value.Kind)
+	{
+	case FPropertyValue::EKind::Bool:
+		Result.Kind = EValueKind::Bool;
+		Result.Payload = Value.bBool ? 1 : 0;
+		break;
+	case FPropertyValue::EKind::Number:
+		Result.Kind = EValueKind::Number;
+		FMemory::Memcpy(&Result.Payload, &Value.Number, sizeof(double));
+		break;
+	case FPropertyValue::EKind::String:
+		Result.Kind = EValueKind::String;
+		Result.Payload = AddBinaryString(Writer, Value.String);
+		break;
+	default:
+		Result.Kind = EValueKind::None;
+		break;
+	}
+
+	return Result;
+}
+
+/**
+* Writes the same data as `SerializeToIndex` in the layout described in `BlueprintIndexFormat.h`,
+* so the consumers can map the file and query it without parsing.
+*/
+static void SerializeToBinaryIndex(const FAssetIndex& Index, FArchive& IndexFile)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::SerializeToBinaryIndex);
+
+	using namespace BinaryIndex;
+
+	FBinaryIndexWriter Writer;
+	for (const FBlueprintEntry& Blueprint : Index.Blueprints)
+	{
+		Writer.Blueprints.push_back({ AddBinaryString(Writer, Blueprint.Name), AddBinaryString(Writer, Blueprint.Path) });
+	}
+
+	for (const auto& Item : Index.Classes)
+	{
+		const FClassEntry& Entry = Item.Value;
+
+		FBinaryClass Class = {};
+		Class.Name = AddBinaryString(Writer, GetClassDisplayName(Entry.Class));
+		Class.FirstBlueprintRef = static_cast<uint32>(Writer.BlueprintRefs.size());
+		Class.BlueprintCount = Entry.Blueprints.Num();
+		Class.FirstProperty = static_cast<uint32>(Writer.Properties.size());
+		Class.PropertyCount = Entry.Properties.Num();
+		Class.FirstFunction = static_cast<uint32>(Writer.Functions.size());
+		Class.FunctionCount = Entry.Functions.Num();
+		Writer.Classes.push_back(Class);
+
+		for (int32 Blueprint : Entry.Blueprints)
+		{
+			Writer.BlueprintRefs.push_back(static_cast<uint32>(Blueprint));
+		}
+
+		for (const auto& PropItem : Entry.Properties)
+		{
+			const FPropertyEntry& PropEntry = PropItem.Value;
+
+			FBinaryProperty Property = {};
+			Property.Name = AddBinaryString(Writer, PropItem.Key.ToString());
+			Property.Categories = PropEntry.Property->HasMetaData(CategoryFName)
+				? AddBinaryString(Writer, PropEntry.Property->GetMetaData(CategoryFName))
+				: InvalidString;
+			Property.FirstValue = static_cast<uint32>(Writer.Values.size());
+			Property.ValueCount = PropEntry.Blueprints.Num();
+			Writer.Properties.push_back(Property);
+
+			for (int32 Idx = 0; Idx < PropEntry.Blueprints.Num(); Idx++)
+			{
+				Writer.Values.push_back(MakeBinaryValue(PropEntry.Blueprints[Idx], PropEntry.Values[Idx], Writer));
+			}
+		}
+
+		for (const auto& FnItem : Entry.Functions)
+		{
+			FBinaryFunction Function = {};
+			Function.Name = AddBinaryString(Writer, FnItem.Key.ToString());
+			Function.FirstBlueprintRef = static_cast<uint32>(Writer.BlueprintRefs.size());
+			Function.BlueprintCount = FnItem.Value.Blueprints.Num();
+			Writer.Functions.push_back(Function);
+
+			for (int32 Blueprint : FnItem.Value.Blueprints)
+			{
+				Writer.BlueprintRefs.push_back(static_cast<uint32>(Blueprint));
+			}
+		}
+	}
+
+	std::vector<uint8_t> Bytes;
+	Writer.Write(Bytes);
+	IndexFile.Serialize(Bytes.data(), static_cast<int64>(Bytes.size()));
+}
+
+/**
+* Writes the index as newline-delimited JSON while the blueprints are processed,
+* instead of grouping them by class at the end of the scan. Each line is a self-contained object:
+* - `{"type":"property","class":...,"name":...,"metadata":{...}}` the first time a changed property is seen.
+* - `{"type":"blueprint","blueprint":<index>,"name":...,"path":...,"classes":[...]}` for each blueprint.
+* - `{"type":"end","blueprint_count":<count>,"metadata":{...}}` once the scan is complete.
+* Only the set of property definitions already written is kept in memory.
+*/
+class FIndexStreamWriter
+{
+public:
+	explicit FIndexStreamWriter(FArchive& InArchive)
+		: Archive(InArchive)
+	{
+	}
+
+	void AddBlueprint(const FBlueprintRecord& Record)
+	{
+		TArray<TPair<const UClass*, const FParentRecord*>> Parents;
+		for (const FParentRecord& ParentRecord : Record.Parents)
+		{
+			if (const UClass* Parent = Resolver.Resolve(ParentRecord))
+			{
+				Parents.Emplace(Parent, &ParentRecord);
+				WritePropertyDefinitions(Parent, ParentRecord);
+			}
+		}
+
+		if (Parents.Num() == 0)
+		{
+			return;
+		}
+
+		WriteLine([&](TSharedRef<JsonWriter>& Json)
+		{
+			Json->WriteValue(TEXT("type"), TEXT("blueprint"));
+			Json->WriteValue(TEXT("blueprint"), BlueprintCount);
+			Json->WriteValue(TEXT("name"), Record.Name);
+			Json->WriteValue(TEXT("path"), Record.Path);
+
+			Json->WriteIdentifierPrefix(TEXT("classes"));
+			Json->WriteArrayStart();
+			for (const auto& Parent : Parents)
+			{
+				Json->WriteObjectStart();
+				Json->WriteValue(TEXT("name"), GetClassDisplayName(Parent.Key));
+
+				Json->WriteIdentifierPrefix(TEXT("properties"));
+				Json->WriteArrayStart();
+				for (const FPropertyRecord& PropRecord : Parent.Value->Properties)
+				{
+					Json->WriteObjectStart();
+					Json->WriteValue(TEXT("name"), PropRecord.Name.ToString());
+					SerializePropertyValue(Json, PropRecord.Value);
+					Json->WriteObjectEnd();
+				}
+				Json->WriteArrayEnd();
+
+				Json->WriteIdentifierPrefix(TEXT("functions"));
+				Json->WriteArrayStart();
+				for (FName FnName : Parent.Value->Functions)
+				{
+					Json->WriteValue(FnName.ToString());
+				}
+				Json->WriteArrayEnd();
+
+				Json->WriteObjectEnd();
+			}
+			Json->WriteArrayEnd();
+		});
+
+		BlueprintCount++;
+	}
+
+	void Close(const FScanStats& Stats)
+	{
+		const int64 BytesWritten = Archive.Tell();
+		WriteLine([&](TSharedRef<JsonWriter>& Json)
+		{
+			Json->WriteValue(TEXT("type"), TEXT("end"));
+			Json->WriteValue(TEXT("blueprint_count"), BlueprintCount);
+			Json->WriteIdentifierPrefix(TEXT("metadata"));
+			SerializeMetadata(Json, Stats, BytesWritten);
+		});
+	}
+
+	int32 Num() const { return BlueprintCount; }
+
+private:
+	void WritePropertyDefinitions(const UClass* Parent, const FParentRecord& ParentRecord)
+	{
+		for (const FPropertyRecord& PropRecord : ParentRecord.Properties)
+		{
+			bool bAlreadyWritten = false;
+			WrittenProperties.Add(MakeTuple(Parent, PropRecord.Name), &bAlreadyWritten);
+			if (bAlreadyWritten)
+			{
+				continue;
+			}
+
+			const FProperty* Property = FindFProperty<FProperty>(Parent, PropRecord.Name);
+			if (Property == nullptr)
+			{
+				continue;
+			}
+
+			WriteLine([&](TSharedRef<JsonWriter>& Json)
+			{
+				Json->WriteValue(TEXT("type"), TEXT("property"));
+				Json->WriteValue(TEXT("class"), GetClassDisplayName(Parent));
+				Json->WriteValue(TEXT("name"), PropRecord.Name.ToString());
+				SerializePropertyMetadata(Json, Property);
+			});
+		}
+	}
+
+	void WriteLine(TFunctionRef<void(TSharedRef<JsonWriter>&)> Body)
+	{
+		TSharedRef<JsonWriter> Json = JsonWriter::Create(&Archive);
+		Json->WriteObjectStart();
+		Body(Json);
+		Json->WriteObjectEnd();
+		Json->Close();
+
+		TCondensedJsonPrintPolicy<TCHAR>::WriteChar(&Archive, TEXT('\n'));
+
+		// Let the consumer read the line right away.
+		Archive.Flush();
+	}
+
+	FArchive& Archive;
+	FClassResolver Resolver;
+	TSet<TPair<const UClass*, FName>> WrittenProperties;
+	int32 BlueprintCount = 0;
+};
+
+struct FModuleInfo
 {
-	TArray<FString> OutResult;
-	Algo::TransformIf(
-		FSourceCodeNavigation::GetSourceFileDatabase().GetModuleNames(),
-		OutResult,
-		[&](const FString& Module) {
-			return FPaths::IsUnderDirectory(Module, InDir);
-		},
-		[](const FString& Module) {
+	FName Name;
+	FString BuildFilePath;
+};
+
+/**
+* Modules known to the source code database, which is expensive to query.
+* The list does not change while the commandlet runs, so it is only built once.
+*/
+static const TArray<FModuleInfo>& GetSourceModules()
+{
+	static const TArray<FModuleInfo> Modules = []()
+	{
+		TArray<FModuleInfo> Result;
+		Algo::Transform(
+			FSourceCodeNavigation::GetSourceFileDatabase().GetModuleNames(),
+			Result,
+			[](const FString& Module) {
 #if 0
-			// Old version assumes that each module is in a folder with the same name as the module
-			return FPaths::GetBaseFilename(FPaths::GetPath(*Module));
+				// Old version assumes that each module is in a folder with the same name as the module
+				FString TempString = FPaths::GetBaseFilename(FPaths::GetPath(*Module));
 #else
-			// New version assumes that each module is in a file with the name Module.Build.cs
-			FString TempString = FPaths::GetBaseFilename(*Module);
-			TempString.RemoveFromEnd(TEXT(".Build"));
-			return TempString;
+				// New version assumes that each module is in a file with the name Module.Build.cs
+				FString TempString = FPaths::GetBaseFilename(*Module);
+				TempString.RemoveFromEnd(TEXT(".Build"));
 #endif
-		});
+				return FModuleInfo{ FName(*TempString), Module };
+			});
+		return Result;
+	}();
+
+	return Modules;
+}
+
+static TSet<FName> GetModulesByPath(const FString& InDir)
+{
+	TSet<FName> OutResult;
+	for (const FModuleInfo& Module : GetSourceModules())
+	{
+		if (FPaths::IsUnderDirectory(Module.BuildFilePath, InDir))
+		{
+			OutResult.Add(Module.Name);
+		}
+	}
 
 	return OutResult;
 }
 
 static void GetNativeClassesByPath(const FString& InDir, TArray<TWeakObjectPtr<UClass>>& OutClasses)
 {
-	TArray<FString> Modules = GetModulesByPath(InDir);
+	const TSet<FName> Modules = GetModulesByPath(InDir);
+	if (Modules.Num() == 0)
+	{
+		return;
+	}
+
+	// Native classes live in the `/Script/<Module>` package of their module,
+	// so the match is resolved once per package instead of once per class.
+	TMap<const UPackage*, bool> PackageMatches;
 
 	for (TObjectIterator<UClass> ClassIt; ClassIt; ++ClassIt)
 	{
@@ -363,19 +799,21 @@ static void GetNativeClassesByPath(const FString& InDir, TArray<TWeakObjectPtr<U
 			continue;
 		}
 
-		FAssetData ClassAssetData(TestClass);
-		FString ModuleName = ClassAssetData.GetTagValueRef<FString>(ModuleNameFName);
+		const UPackage* Package = TestClass->GetOutermost();
+		bool* bMatches = PackageMatches.Find(Package);
+		if (bMatches == nullptr)
+		{
+			bMatches = &PackageMatches.Add(Package, Modules.Contains(FPackageName::GetShortFName(Package->GetFName())));
+		}
 
-		if (!ModuleName.IsEmpty() && Modules.Contains(ModuleName))
+		if (*bMatches)
 		{
 			OutClasses.Add(TestClass);
 		}
 	}
 }
 
-static void RunAssetScan(
-	FAssetIndex& Index,
-	const TArray<TWeakObjectPtr<UClass>>& FilterBaseClasses)
+static TArray<FAssetData> FindTargetAssets(const TArray<TWeakObjectPtr<UClass>>& FilterBaseClasses)
 {
 	FARFilter Filter;
 	Filter.bRecursivePaths = true;
@@ -411,18 +849,276 @@ static void RunAssetScan(
 
 	TArray<FAssetData> TargetAssets;
 	AssetRegistry.GetAssets(Filter, TargetAssets);
+	return TargetAssets;
+}
+
+/**
+* Finds the blueprints derived from any native class.
+* A tag filter with every native class is too expensive for the asset registry to evaluate,
+* so all the blueprints are queried at once and their native parent tags are resolved instead.
+*/
+static TArray<FAssetData> FindAllTargetAssets()
+{
+	FARFilter Filter;
+	Filter.bRecursivePaths = true;
+	Filter.bRecursiveClasses = true;
+	AssetHelpers::SetBlueprintClassFilter(Filter);
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+
+	TArray<FAssetData> TargetAssets;
+	AssetRegistry.GetAssets(Filter, TargetAssets);
+
+	FNativeParentResolver Resolver;
+	TargetAssets.RemoveAll([&](const FAssetData& AssetData)
+		{
+			FString NativeParentTag;
+			return !AssetData.GetTagValue(FBlueprintTags::NativeParentClassPath, NativeParentTag)
+				|| Resolver.Resolve(NativeParentTag) == nullptr;
+		});
+
+	return TargetAssets;
+}
+
+/**
+* Loads the assets and extracts their records, splitting the time between loading and extraction.
+*/
+static void LoadAndExtract(
+	const TArray<FAssetData>& TargetAssets,
+	const FScanOptions& Options,
+	FScanStats& Stats,
+	TFunctionRef<void(UBlueprintGeneratedClass*, const FAssetData&)> Callback)
+{
+	const FPerfTime ExtractStart = Stats.Extract;
+	const FPerfTime OutputStart = Stats.Output;
+	const FPerfTime GCStart = Stats.Memory.GCTime;
+	FPerfTime Total;
+	{
+		FScopedPerfTimer TotalTimer(Total);
+		AssetHelpers::ForEachAsset(TargetAssets,
+			[&](UBlueprintGeneratedClass* BlueprintGeneratedClass, const FAssetData& AssetData)
+			{
+				const FPerfTime OutputBefore = Stats.Output;
+				FPerfTime Elapsed;
+				{
+					FScopedPerfTimer CallbackTimer(Elapsed);
+					Callback(BlueprintGeneratedClass, AssetData);
+				}
+
+				// Output time is already accounted by the sink.
+				Stats.Extract += Elapsed - (Stats.Output - OutputBefore);
+			},
+			Options.MaxInFlight,
+			Options.MaxMemoryMB,
+			&Stats.Memory);
+	}
+
+	// Whatever is not accounted by the other phases was spent waiting for the assets to load.
+	Stats.Load += Total - (Stats.Extract - ExtractStart) - (Stats.Output - OutputStart) - (Stats.Memory.GCTime - GCStart);
+}
+
+static void RunAssetScan(
+	const TArray<FAssetData>& TargetAssets,
+	const FScanOptions& Options,
+	FScanStats& Stats,
+	FBlueprintRecordSink OnBlueprint)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::RunAssetScan);
+
+	if (Options.Level == EScanLevel::Parents)
+	{
+		FNativeParentResolver Resolver;
+		for (const FAssetData& AssetData : TargetAssets)
+		{
+			YieldToUrgentRequests();
+
+			FBlueprintRecord Record;
+			bool bHasParents = false;
+			{
+				FScopedPerfTimer Timer(Stats.Extract);
+				bHasParents = MakeBlueprintRecordFromTags(AssetData, Resolver, Record);
+			}
 
-	AssetHelpers::ForEachAsset(TargetAssets,
+			if (bHasParents)
+			{
+				Stats.Emit(OnBlueprint, Record);
+			}
+		}
+
+		return;
+	}
+
+	FNativeClassCache ClassCache;
+	LoadAndExtract(TargetAssets, Options, Stats,
 		[&](UBlueprintGeneratedClass* BlueprintGeneratedClass, const FAssetData& /*AssetData*/)
 		{
-			Index.ProcessBlueprint(BlueprintGeneratedClass);
+			FBlueprintRecord Record;
+			if (MakeBlueprintRecord(BlueprintGeneratedClass, Options.Level, ClassCache, Record))
+			{
+				Stats.Emit(OnBlueprint, Record);
+			}
+		});
+}
+
+/**
+* Only loads the blueprints that changed since the cache was written and reuses the
+* cached records for the remaining ones. The records are added to the index in the
+* same order as a full scan, so the output is identical.
+*/
+static void RunIncrementalAssetScan(
+	const TArray<FAssetData>& TargetAssets,
+	const FScanOptions& Options,
+	FBlueprintIndexCache& Cache,
+	FScanStats& Stats,
+	FBlueprintRecordSink OnBlueprint)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::RunIncrementalAssetScan);
+
+	TSet<FName> LivePackages;
+	TArray<FAssetData> ChangedAssets;
+	for (const FAssetData& AssetData : TargetAssets)
+	{
+		LivePackages.Add(AssetData.PackageName);
+		if (!Cache.Find(AssetData.PackageName, Cache.GetPackageStamp(AssetData)))
+		{
+			ChangedAssets.Add(AssetData);
+		}
+	}
+
+	// Drop the blueprints that were deleted or no longer match the filter.
+	Cache.Prune(LivePackages);
+
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Blueprint cache: %d up to date, %d to load."),
+		TargetAssets.Num() - ChangedAssets.Num(), ChangedAssets.Num());
+
+	// Records of packages that could not be stamped are not cached, keep them around for this run.
+	TMap<FName, FBlueprintRecord> UncachedRecords;
+
+	FNativeClassCache ClassCache;
+	LoadAndExtract(ChangedAssets, Options, Stats,
+		[&](UBlueprintGeneratedClass* BlueprintGeneratedClass, const FAssetData& AssetData)
+		{
+			// Blueprints without native parents are cached too, to avoid loading them again.
+			FBlueprintRecord Record;
+			MakeBlueprintRecord(BlueprintGeneratedClass, Options.Level, ClassCache, Record);
+
+			const FPackageStamp Stamp = Cache.GetPackageStamp(AssetData);
+			if (Stamp.IsValid())
+			{
+				Cache.Update(AssetData.PackageName, Stamp, MoveTemp(Record));
+			}
+			else
+			{
+				UncachedRecords.Add(AssetData.PackageName, MoveTemp(Record));
+			}
 		});
+
+	for (const FAssetData& AssetData : TargetAssets)
+	{
+		const FBlueprintRecord* Record = Cache.Find(AssetData.PackageName, Cache.GetPackageStamp(AssetData));
+		if (Record == nullptr)
+		{
+			Record = UncachedRecords.Find(AssetData.PackageName);
+		}
+
+		if (Record != nullptr && Record->Parents.Num() > 0)
+		{
+			Stats.Emit(OnBlueprint, *Record);
+		}
+	}
+}
+
+static void ScanAssets(
+	const TArray<FAssetData>& TargetAssets,
+	const FScanOptions& Options,
+	const FString* CachePath,
+	FScanStats& Stats,
+	FBlueprintRecordSink OnBlueprint)
+{
+	// The tags are already in memory, so there is nothing to gain from the cache on that level.
+	if (CachePath != nullptr && Options.Level != EScanLevel::Parents)
+	{
+		FBlueprintIndexCache Cache(LexToString(Options.Level));
+		Cache.Load(*CachePath);
+		RunIncrementalAssetScan(TargetAssets, Options, Cache, Stats, OnBlueprint);
+		Cache.Save(*CachePath);
+	}
+	else
+	{
+		RunAssetScan(TargetAssets, Options, Stats, OnBlueprint);
+	}
+}
+
+/**
+* Splits the scan across several commandlet processes and emits their records in shard order.
+* Each shard scans a contiguous range of the sorted assets, so the records are in the same order
+* as a scan in a single process, and the merged index is identical.
+*/
+static bool RunShardedScan(
+	int32 ShardCount,
+	TFunctionRef<FString(int32 ShardIndex, const FString& ShardFile)> GetShardParams,
+	double TimeoutSeconds,
+	FScanStats& Stats,
+	FBlueprintRecordSink OnBlueprint)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::RunShardedScan);
+
+	const FString ShardDir = FPaths::ConvertRelativePathToFull(FPaths::ProjectIntermediateDir() / TEXT("VisualStudioTools"));
+	IFileManager::Get().MakeDirectory(*ShardDir, true /*Tree*/);
+
+	TArray<FString> ShardFiles;
+	for (int32 ShardIndex = 0; ShardIndex < ShardCount; ShardIndex++)
+	{
+		ShardFiles.Add(FPaths::CreateTempFilename(*ShardDir, TEXT("Shard"), TEXT(".bin")));
+	}
+
+	ON_SCOPE_EXIT
+	{
+		for (const FString& ShardFile : ShardFiles)
+		{
+			IFileManager::Get().Delete(*ShardFile, false /*RequireExists*/, false /*EvenReadOnly*/, true /*Quiet*/);
+		}
+	};
+
+	bool bSuccess = false;
+	{
+		FScopedPerfTimer Timer(Stats.Load);
+		bSuccess = RunShardProcesses(ShardCount, [&](int32 ShardIndex) { return GetShardParams(ShardIndex, ShardFiles[ShardIndex]); }, TimeoutSeconds);
+	}
+
+	if (!bSuccess)
+	{
+		return false;
+	}
+
+	for (const FString& ShardFile : ShardFiles)
+	{
+		FShardResult Result;
+		if (!LoadShardResult(ShardFile, Result))
+		{
+			return false;
+		}
+
+		MergeLoadStats(Stats.Memory, Result.LoadStats);
+		for (const FBlueprintRecord& Record : Result.Records)
+		{
+			Stats.Emit(OnBlueprint, Record);
+		}
+	}
+
+	return true;
 }
 
 } // namespace VS
 
 static constexpr auto FilterSwitch = TEXT("filter");
 static constexpr auto FullSwitch = TEXT("full");
+static constexpr auto CacheSwitch = TEXT("cache");
+static constexpr auto LevelSwitch = TEXT("level");
+static constexpr auto FormatSwitch = TEXT("format");
+static constexpr auto ShardsSwitch = TEXT("shards");
+static constexpr auto ShardSwitch = TEXT("shard");
+static constexpr auto ShardTimeoutSwitch = TEXT("shardtimeout");
 
 UVisualStudioToolsCommandlet::UVisualStudioToolsCommandlet()
 	: Super()
@@ -433,9 +1129,27 @@ UVisualStudioToolsCommandlet::UVisualStudioToolsCommandlet()
 	HelpParamDescriptions.Add(TEXT("[Optional] Scan only blueprints derived from native classes under the provided path. Defaults to `FPaths::ProjectDir`. Incompatible with `-full`."));
 
 	HelpParamNames.Add(FullSwitch);
-	HelpParamDescriptions.Add(TEXT("[Optional] Scan blueprints derived from native classes from ALL modules, include the Engine. This can be _very slow_ for large projects. Incompatible with `-filter`."));
+	HelpParamDescriptions.Add(TEXT("[Optional] Scan blueprints derived from native classes from ALL modules, include the Engine. The blueprints are still loaded, so this can be slow for large projects. Incompatible with `-filter`."));
+
+	HelpParamNames.Add(CacheSwitch);
+	HelpParamDescriptions.Add(TEXT("[Optional] Path to a cache file with the data extracted from each blueprint. When set, only the blueprints that changed since the previous run are loaded."));
 
-	HelpUsage = TEXT("<Editor-Cmd.exe> <path_to_uproject> -run=VisualStudioTools -output=<path_to_output_file> [-filter=<subdir_native_classes>|-full] [-unattended -noshadercompile -nosound -nullrhi -nocpuprofilertrace -nocrashreports -nosplash]");
+	HelpParamNames.Add(LevelSwitch);
+	HelpParamDescriptions.Add(TEXT("[Optional] Data to extract from each blueprint: `parents`, `functions` or `properties`. Defaults to `properties`. With `parents`, the blueprints are not loaded and only the derived classes are reported."));
+
+	HelpParamNames.Add(FormatSwitch);
+	HelpParamDescriptions.Add(TEXT("[Optional] Output format: `json`, `ndjson` or `binary`. Defaults to `json`. With `ndjson`, each blueprint is written as a separate line as soon as it is processed. With `binary`, the index is written in the memory-mappable layout from `BlueprintIndexFormat.h`."));
+
+	HelpParamNames.Add(ShardsSwitch);
+	HelpParamDescriptions.Add(TEXT("[Optional] Number of commandlet processes that scan the blueprints in parallel. Each one loads a separate range of the blueprints, and their results are merged into the same output as a single process."));
+
+	HelpParamNames.Add(ShardTimeoutSwitch);
+	HelpParamDescriptions.Add(TEXT("[Optional] Time limit in seconds for the processes launched with `-shards`. The ones still running after it are terminated and the scan fails. Defaults to one hour, use 0 to wait for as long as they take."));
+
+	HelpParamNames.Add(ShardSwitch);
+	HelpParamDescriptions.Add(TEXT("[Internal] Scan only the given range of the blueprints, as `<index>/<count>`, and write a partial result to be merged by the process that launched it with `-shards`."));
+
+	HelpUsage = TEXT("<Editor-Cmd.exe> <path_to_uproject> -run=VisualStudioTools -output=<path_to_output_file> [-filter=<subdir_native_classes>|-full] [-level=parents|functions|properties] [-format=json|ndjson|binary] [-cache=<path_to_cache_file>] [-shards=<count> [-shardtimeout=<seconds>]] [-projectcontent] [-unattended -noshadercompile -nosound -nullrhi -nocpuprofilertrace -nocrashreports -nosplash]");
 }
 
 int32 UVisualStudioToolsCommandlet::Run(
@@ -456,37 +1170,212 @@ int32 UVisualStudioToolsCommandlet::Run(
 		return -1;
 	}
 
-	TArray<TWeakObjectPtr<UClass>> FilterBaseClasses;
-	if (!bFullScan)
+	FScanOptions Options;
+	Options.MaxInFlight = MaxAssetsInFlight;
+	Options.MaxMemoryMB = MaxMemoryMB;
+
+	if (const FString* Level = ParamVals.Find(LevelSwitch))
 	{
-		if (Filter)
+		if (!LexTryParseString(Options.Level, **Level))
 		{
-			FPaths::NormalizeDirectoryName(*Filter);
-			GetNativeClassesByPath(*Filter, FilterBaseClasses);
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Invalid scan level: %s."), **Level);
+			PrintHelp();
+			return -1;
 		}
-		else
+	}
+
+	EOutputFormat Format = EOutputFormat::Json;
+	if (const FString* FormatValue = ParamVals.Find(FormatSwitch))
+	{
+		if (!LexTryParseString(Format, **FormatValue))
 		{
-			GetNativeClassesByPath(FPaths::ProjectDir(), FilterBaseClasses);
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Invalid output format: %s."), **FormatValue);
+			PrintHelp();
+			return -1;
 		}
 	}
-	else
+
+	FShardSpec Shard;
+	const FString* ShardValue = ParamVals.Find(ShardSwitch);
+	if (ShardValue != nullptr && !Shard.Parse(*ShardValue))
 	{
-		for (TObjectIterator<UClass> ClassIt; ClassIt; ++ClassIt)
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Invalid shard: %s."), **ShardValue);
+		PrintHelp();
+		return -1;
+	}
+
+	const int32 ShardCount = FMath::Max(1, FCString::Atoi(*ParamVals.FindRef(ShardsSwitch)));
+	if (ShardCount > 1 && ShardValue != nullptr)
+	{
+		UE_LOG(LogVisualStudioTools, Error, TEXT("Incompatible shard options."));
+		PrintHelp();
+		return -1;
+	}
+
+	const FString* CachePath = ParamVals.Find(CacheSwitch);
+
+	double ShardTimeoutSeconds = DefaultShardTimeoutSeconds;
+	if (const FString* ShardTimeoutValue = ParamVals.Find(ShardTimeoutSwitch))
+	{
+		ShardTimeoutSeconds = FMath::Max(0.0, FCString::Atod(**ShardTimeoutValue));
+	}
+
+	// The shard processes get the parameters of this one as they were given, except for the ones that only apply
+	// to the merged output, and the cache, since each process scans different blueprints.
+	auto GetShardParams = [&](int32 ShardIndex, const FString& ShardFile)
+	{
+		FString Params = FString::Printf(TEXT("\"%s\" -run=VisualStudioTools -output=\"%s\" -%s=%d/%d"),
+			*FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *ShardFile, ShardSwitch, ShardIndex, ShardCount);
+
+		const TCHAR* Remaining = *CommandParams;
+		FString Token;
+		while (FParse::Token(Remaining, Token, false /*UseEscape*/))
 		{
-			UClass* TestClass = *ClassIt;
-			if (!TestClass->HasAnyClassFlags(CLASS_Native))
+			// The positional tokens, e.g. the project, are already part of the shard parameters.
+			if (!Token.StartsWith(TEXT("-")))
+			{
+				continue;
+			}
+
+			FString Name = Token.Mid(1);
+			FString Value;
+			const bool bHasValue = Name.Split(TEXT("="), &Name, &Value);
+
+			if (Name == TEXT("run") || Name == TEXT("output") || Name == ShardsSwitch || Name == FormatSwitch)
 			{
+				// The legacy `-output <path>` style has the value in the next token.
+				if (Name == TEXT("output") && !bHasValue)
+				{
+					FParse::Token(Remaining, Token, false /*UseEscape*/);
+				}
+
 				continue;
 			}
 
-			FilterBaseClasses.Add(TestClass);
+			if (Name == CacheSwitch && bHasValue)
+			{
+				Params += FString::Printf(TEXT(" -%s=\"%s.shard%dof%d\""), CacheSwitch, *Value.TrimQuotes(), ShardIndex, ShardCount);
+				continue;
+			}
+
+			// Quoted parts are kept in the token, so only the tokens that were quoted as a whole need it again.
+			Params += Token.Contains(TEXT(" ")) && !Token.Contains(TEXT("\""))
+				? FString::Printf(TEXT(" \"%s\""), *Token)
+				: TEXT(" ") + Token;
+		}
+
+		return Params;
+	};
+
+	FScanStats Stats;
+
+	// Produces the records of the target blueprints, in a stable order.
+	auto ProduceRecords = [&](FBlueprintRecordSink OnBlueprint)
+	{
+		if (ShardCount > 1)
+		{
+			return RunShardedScan(ShardCount, GetShardParams, ShardTimeoutSeconds, Stats, OnBlueprint);
+		}
+
+		TArray<FAssetData> TargetAssets;
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::FindTargetAssets);
+			FScopedPerfTimer Timer(Stats.Query);
+			if (bFullScan)
+			{
+				AssetHelpers::ScanAssetRegistry({}, bRescanAssetRegistry);
+				TargetAssets = FindAllTargetAssets();
+			}
+			else
+			{
+				if (Filter)
+				{
+					FPaths::NormalizeDirectoryName(*Filter);
+				}
+
+				const FString FilterDir = Filter ? *Filter : FPaths::ProjectDir();
+				// Blueprints in the engine and in any plugin can derive from the filtered classes, so every root
+				// is scanned unless asked otherwise.
+				AssetHelpers::ScanAssetRegistry(bProjectContentOnly ? AssetHelpers::GetContentPaths(FilterDir) : TArray<FString>(), bRescanAssetRegistry);
+
+				TArray<TWeakObjectPtr<UClass>> FilterBaseClasses;
+				GetNativeClassesByPath(FilterDir, FilterBaseClasses);
+				TargetAssets = FindTargetAssets(FilterBaseClasses);
+			}
+
+			SortTargetAssets(TargetAssets);
+			if (Shard.Count > 1)
+			{
+				TargetAssets = Shard.Select(TargetAssets);
+			}
+		}
+
+		ScanAssets(TargetAssets, Options, CachePath, Stats, OnBlueprint);
+		return true;
+	};
+
+	// Shard processes write the plain records, the process that launched them builds the index.
+	if (ShardValue != nullptr)
+	{
+		FShardResult Result;
+		ProduceRecords([&](const FBlueprintRecord& Record) { Result.Records.Add(Record); });
+		Result.LoadStats = Stats.Memory;
+
+		if (!SaveShardResult(OutArchive, Result))
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to write shard result."));
+			return -1;
 		}
+
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Found %d blueprints in shard %d/%d."), Result.Records.Num(), Shard.Index, Shard.Count);
+		return 0;
 	}
 
-	FAssetIndex Index;
-	RunAssetScan(Index, FilterBaseClasses);
-	SerializeToIndex(Index, OutArchive);
-	UE_LOG(LogVisualStudioTools, Display, TEXT("Found %d blueprints."), Index.Blueprints.Num());
+	int32 BlueprintCount = 0;
+	if (Format == EOutputFormat::Ndjson)
+	{
+		FIndexStreamWriter Writer(OutArchive);
+		if (!ProduceRecords([&](const FBlueprintRecord& Record) { Writer.AddBlueprint(Record); }))
+		{
+			return -1;
+		}
+
+		// The lines of the blueprints were already timed as they were written. The last line only has the
+		// metadata, which is not part of the output phase, and can't time itself while it is serialized.
+		Writer.Close(Stats);
+		BlueprintCount = Writer.Num();
+	}
+	else
+	{
+		FAssetIndex Index;
+		if (!ProduceRecords([&](const FBlueprintRecord& Record) { Index.AddBlueprint(Record); }))
+		{
+			return -1;
+		}
+
+		if (Format == EOutputFormat::Binary)
+		{
+			FScopedPerfTimer Timer(Stats.Output);
+			SerializeToBinaryIndex(Index, OutArchive);
+		}
+		else
+		{
+			SerializeToIndex(Index, Stats, OutArchive);
+		}
+
+		BlueprintCount = Index.Blueprints.Num();
+	}
+
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Found %d blueprints."), BlueprintCount);
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Scan timings (wall/cpu): { Query: %.3fs/%.3fs, Load: %.3fs/%.3fs, Extract: %.3fs/%.3fs, GC: %.3fs/%.3fs, Output: %.3fs/%.3fs }"),
+		Stats.Query.Wall, Stats.Query.Cpu, Stats.Load.Wall, Stats.Load.Cpu, Stats.Extract.Wall, Stats.Extract.Cpu,
+		Stats.Memory.GCTime.Wall, Stats.Memory.GCTime.Cpu, Stats.Output.Wall, Stats.Output.Cpu);
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Memory: { Peak: %llu MB, Average: %llu MB, GC: %d collections }"),
+		Stats.Memory.PeakUsedMemory / (1024 * 1024), Stats.Memory.GetAverageUsedMemory() / (1024 * 1024), Stats.Memory.GCCount);
+	for (const AssetHelpers::FAssetLoadTime& Load : Stats.Memory.SlowestLoads)
+	{
+		UE_LOG(LogVisualStudioTools, Display, TEXT("Slow load: %.3fs %s"), Load.Seconds, *Load.Path);
+	}
 
 	return 0;
 }
@@ -3,18 +3,24 @@
 
 #include "VisualStudioToolsCommandletBase.h"
 
-#include "Windows/AllowWindowsPlatformTypes.h"
-
+#include "BlueprintAssetHelpers.h"
+#include "CommandletPerf.h"
 #include "HAL/FileManager.h"
 #include "Misc/Paths.h"
 #include "VisualStudioTools.h"
 
-#include "Windows/HideWindowsPlatformTypes.h"
-
 static constexpr auto HelpSwitch = TEXT("help");
 static constexpr auto OutputSwitch = TEXT("output");
+static constexpr auto MaxInFlightSwitch = TEXT("maxinflight");
+static constexpr auto MaxMemorySwitch = TEXT("maxmemorymb");
+static constexpr auto ProjectContentSwitch = TEXT("projectcontent");
+static constexpr auto FullRegistryScanSwitch = TEXT("fullregistryscan");
 
 UVisualStudioToolsCommandletBase::UVisualStudioToolsCommandletBase()
+	: MaxAssetsInFlight(VisualStudioTools::AssetHelpers::DefaultMaxInFlight)
+	, MaxMemoryMB(0)
+	, bProjectContentOnly(false)
+	, bRescanAssetRegistry(false)
 {
 	IsClient = false;
 	IsEditor = true;
@@ -25,6 +31,18 @@ UVisualStudioToolsCommandletBase::UVisualStudioToolsCommandletBase()
 	HelpParamNames.Add(OutputSwitch);
 	HelpParamDescriptions.Add(TEXT("[Required] The file path to write the command output."));
 
+	HelpParamNames.Add(MaxInFlightSwitch);
+	HelpParamDescriptions.Add(TEXT("[Optional] Maximum number of blueprints loaded asynchronously at the same time. Defaults to 8, use 1 to load them one at a time."));
+
+	HelpParamNames.Add(MaxMemorySwitch);
+	HelpParamDescriptions.Add(TEXT("[Optional] Memory budget in megabytes. When the process goes over it, the blueprints already processed are garbage collected before loading more. Disabled by default."));
+
+	HelpParamNames.Add(ProjectContentSwitch);
+	HelpParamDescriptions.Add(TEXT("[Optional] Scan only the project content and the content of the plugins under the project, instead of waiting for the asset registry to discover all the content. Faster, but the blueprints in the engine and the other plugins are missing from the results. Ignored with `-fullregistryscan`."));
+
+	HelpParamNames.Add(FullRegistryScanSwitch);
+	HelpParamDescriptions.Add(TEXT("[Optional] Wait for the asset registry to discover all the content, including the engine and all plugins. This is the default, and overrides `-projectcontent`."));
+
 	HelpParamNames.Add(HelpSwitch);
 	HelpParamDescriptions.Add(TEXT("[Optional] Print this help message and quit the commandlet immediately."));
 }
@@ -42,11 +60,25 @@ void UVisualStudioToolsCommandletBase::PrintHelp() const
 
 int32 UVisualStudioToolsCommandletBase::Main(const FString& Params)
 {
+	return RunCommand(Params, nullptr);
+}
+
+int32 UVisualStudioToolsCommandletBase::RunInServer(const FString& Params, FArchive& OutArchive, bool bForceRescan)
+{
+	bRescanAssetRegistry = bForceRescan;
+	return RunCommand(Params, &OutArchive);
+}
+
+int32 UVisualStudioToolsCommandletBase::RunCommand(const FString& Params, FArchive* InOutArchive)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VisualStudioTools::Main);
+
 	TArray<FString> Tokens;
 	TArray<FString> Switches;
 	TMap<FString, FString> ParamVals;
 
 	ParseCommandLine(*Params, Tokens, Switches, ParamVals);
+	CommandParams = Params;
 
 	if (Switches.Contains(HelpSwitch))
 	{
@@ -64,7 +96,7 @@ int32 UVisualStudioToolsCommandletBase::Main(const FString& Params)
 
 	FString FullPath = ParamVals.FindRef(OutputSwitch);
 
-	if (FullPath.IsEmpty() && !FParse::Value(*Params, TEXT("output "), FullPath))
+	if (InOutArchive == nullptr && FullPath.IsEmpty() && !FParse::Value(*Params, TEXT("output "), FullPath))
 	{
 		// VS:1678426 - Initial version was using `-output "path-to-file"` (POSIX style).
 		// However, that does not support paths with spaces, even when surrounded with
@@ -77,12 +109,37 @@ int32 UVisualStudioToolsCommandletBase::Main(const FString& Params)
 		return -1;
 	}
 
-	TUniquePtr<FArchive> OutArchive{ IFileManager::Get().CreateFileWriter(*FullPath) };
-	if (!OutArchive)
+	if (const FString* MaxInFlight = ParamVals.Find(MaxInFlightSwitch))
 	{
-		UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to create index with path: %s."), *FullPath);
-		return -1;
+		MaxAssetsInFlight = FMath::Max(1, FCString::Atoi(**MaxInFlight));
+	}
+
+	bProjectContentOnly = Switches.Contains(ProjectContentSwitch) && !Switches.Contains(FullRegistryScanSwitch);
+
+	if (const FString* MaxMemory = ParamVals.Find(MaxMemorySwitch))
+	{
+		MaxMemoryMB = FMath::Max(0, FCString::Atoi(**MaxMemory));
 	}
 
-    return this->Run(Tokens, Switches, ParamVals, *OutArchive);
+	TUniquePtr<FArchive> OutFile;
+	if (InOutArchive == nullptr)
+	{
+		OutFile.Reset(IFileManager::Get().CreateFileWriter(*FullPath));
+		if (!OutFile)
+		{
+			UE_LOG(LogVisualStudioTools, Error, TEXT("Failed to create index with path: %s."), *FullPath);
+			return -1;
+		}
+	}
+
+	FArchive* OutArchive = InOutArchive != nullptr ? InOutArchive : OutFile.Get();
+
+	const VisualStudioTools::FPerfTime Start = VisualStudioTools::FPerfTime::Now();
+	const int32 Result = this->Run(Tokens, Switches, ParamVals, *OutArchive);
+	const VisualStudioTools::FPerfTime Elapsed = VisualStudioTools::FPerfTime::Now() - Start;
+
+	UE_LOG(LogVisualStudioTools, Display, TEXT("Commandlet finished in %.3fs (%.3fs CPU), wrote %lld bytes, peak memory %llu MB."),
+		Elapsed.Wall, Elapsed.Cpu, OutArchive->Tell(), FPlatformMemory::GetStats().PeakUsedPhysical / (1024 * 1024));
+
+	return Result;
 }
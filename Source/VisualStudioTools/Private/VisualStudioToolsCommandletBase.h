@@ -16,14 +16,43 @@ class UVisualStudioToolsCommandletBase
 public:
 	int32 Main(const FString& Params) override;
 
+	/**
+	* Runs the command in a long-lived editor process, with the output written to the given archive
+	* instead of the `-output` file, reusing the loaded modules and classes.
+	* `bForceRescan` scans the content paths again, to pick up the files changed since the previous
+	* command. Otherwise the assets discovered by the previous commands are used as they are.
+	*/
+	int32 RunInServer(const FString& Params, FArchive& OutArchive, bool bForceRescan);
+
 protected:
 	UVisualStudioToolsCommandletBase();
 	
 	void PrintHelp() const;
 
+	/** Maximum number of blueprint assets requested ahead of the one being processed. */
+	int32 MaxAssetsInFlight;
+
+	/** Process memory, in megabytes, above which garbage is collected between blueprints. Zero disables it. */
+	int32 MaxMemoryMB;
+
+	/**
+	* Whether to scan only the content paths relevant to the command, instead of waiting for the whole asset registry.
+	* Opt-in, since the blueprints in the engine and the other plugins are then missing from the results.
+	*/
+	bool bProjectContentOnly;
+
+	/** Whether the content paths must be scanned again, because they may have changed since they were discovered. */
+	bool bRescanAssetRegistry;
+
+	/** Parameters of the command being run, as given to `Main` or `RunInServer`. */
+	FString CommandParams;
+
 	virtual int32 Run(
 		TArray<FString>& Tokens,
 		TArray<FString>& Switches,
 		TMap<FString, FString>& ParamVals,
 		FArchive& OutArchive) PURE_VIRTUAL(UVisualStudioToolsCommandletBase::Run, return 0;);
+
+private:
+	int32 RunCommand(const FString& Params, FArchive* InOutArchive);
 };
\ No newline at end of file
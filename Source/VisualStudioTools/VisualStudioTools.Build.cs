@@ -58,6 +58,7 @@ public class VisualStudioTools : ModuleRules
                 "ApplicationCore",
                 "AssetRegistry",
                 "CoreUObject",
+                "DirectoryWatcher",
                 "Engine",
                 "Json",
                 "JsonUtilities",
@@ -69,10 +70,16 @@ public class VisualStudioTools : ModuleRules
                 "EditorSubsystem",
                 "MainFrame",
                 "BlueprintGraph",
-                "VisualStudioDTE",
                 "EditorStyle",
                 "Projects"
             }
         );
+
+        // The blueprint breakpoints use the automation interface of Visual Studio,
+        // while the commandlets and the server also run on the other editor platforms.
+        if (Target.Platform == UnrealTargetPlatform.Win64)
+        {
+            PrivateDependencyModuleNames.Add("VisualStudioDTE");
+        }
     }
 }
@@ -0,0 +1,284 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "BlueprintIndexFormat.h"
+#include "TestHarness.h"
+
+#include <cstdlib>
+
+using namespace VisualStudioTools;
+using namespace VisualStudioTools::BinaryIndex;
+
+// Checked-in output of `FBinaryIndexWriter` for `MakeSampleIndex`, the writer used by `-format=binary`.
+// Regenerate it with `VSTOOLS_UPDATE_FIXTURES=1` when the format version changes.
+static const char* SampleIndexFixture = "BlueprintIndex.vsbi";
+
+static FBinaryValue MakeValue(uint32_t Blueprint, EValueKind Kind, uint64_t Payload)
+{
+	FBinaryValue Value{};
+	Value.Blueprint = Blueprint;
+	Value.Kind = Kind;
+	Value.Payload = Payload;
+	return Value;
+}
+
+/** Builds the index of two blueprints deriving from `ACharacter`, in the order used by `SerializeToBinaryIndex`. */
+static std::vector<uint8_t> MakeSampleIndex()
+{
+	FBinaryIndexWriter Writer;
+	Writer.Blueprints.push_back({ Writer.AddString("BP_Hero_C"), Writer.AddString("/Game/Characters/BP_Hero.BP_Hero") });
+	Writer.Blueprints.push_back({ Writer.AddString("BP_Enemy_C"), Writer.AddString("/Game/Characters/BP_Enemy.BP_Enemy") });
+
+	FBinaryClass Character{};
+	Character.Name = Writer.AddString("ACharacter");
+	Character.FirstBlueprintRef = static_cast<uint32_t>(Writer.BlueprintRefs.size());
+	Character.BlueprintCount = 2;
+	Character.FirstProperty = static_cast<uint32_t>(Writer.Properties.size());
+	Character.PropertyCount = 2;
+	Character.FirstFunction = static_cast<uint32_t>(Writer.Functions.size());
+	Character.FunctionCount = 1;
+	Writer.Classes.push_back(Character);
+	Writer.BlueprintRefs.push_back(0);
+	Writer.BlueprintRefs.push_back(1);
+
+	FBinaryProperty CanJump{};
+	CanJump.Name = Writer.AddString("bCanJump");
+	CanJump.Categories = Writer.AddString("Character Movement");
+	CanJump.FirstValue = static_cast<uint32_t>(Writer.Values.size());
+	CanJump.ValueCount = 2;
+	Writer.Properties.push_back(CanJump);
+	Writer.Values.push_back(MakeValue(0, EValueKind::Bool, 1));
+	Writer.Values.push_back(MakeValue(1, EValueKind::Bool, 0));
+
+	FBinaryProperty JumpMaxHoldTime{};
+	JumpMaxHoldTime.Name = Writer.AddString("JumpMaxHoldTime");
+	JumpMaxHoldTime.Categories = InvalidString;
+	JumpMaxHoldTime.FirstValue = static_cast<uint32_t>(Writer.Values.size());
+	JumpMaxHoldTime.ValueCount = 1;
+	Writer.Properties.push_back(JumpMaxHoldTime);
+
+	const double HoldTime = 0.25;
+	uint64_t HoldTimeBits = 0;
+	std::memcpy(&HoldTimeBits, &HoldTime, sizeof(double));
+	Writer.Values.push_back(MakeValue(1, EValueKind::Number, HoldTimeBits));
+
+	FBinaryFunction Jump{};
+	Jump.Name = Writer.AddString("Jump");
+	Jump.FirstBlueprintRef = static_cast<uint32_t>(Writer.BlueprintRefs.size());
+	Jump.BlueprintCount = 1;
+	Writer.Functions.push_back(Jump);
+	Writer.BlueprintRefs.push_back(1);
+
+	FBinaryClass Actor{};
+	Actor.Name = Writer.AddString("AActor");
+	Actor.FirstBlueprintRef = static_cast<uint32_t>(Writer.BlueprintRefs.size());
+	Actor.BlueprintCount = 1;
+	Actor.FirstProperty = static_cast<uint32_t>(Writer.Properties.size());
+	Actor.PropertyCount = 1;
+	Actor.FirstFunction = static_cast<uint32_t>(Writer.Functions.size());
+	Writer.Classes.push_back(Actor);
+	Writer.BlueprintRefs.push_back(0);
+
+	FBinaryProperty LifeSpan{};
+	LifeSpan.Name = Writer.AddString("InitialLifeSpan");
+	LifeSpan.Categories = Writer.AddString("Actor");
+	LifeSpan.FirstValue = static_cast<uint32_t>(Writer.Values.size());
+	LifeSpan.ValueCount = 2;
+	Writer.Properties.push_back(LifeSpan);
+	Writer.Values.push_back(MakeValue(0, EValueKind::String, Writer.AddString("Character Movement")));
+	Writer.Values.push_back(MakeValue(1, EValueKind::None, 0));
+
+	std::vector<uint8_t> Bytes;
+	Writer.Write(Bytes);
+	return Bytes;
+}
+
+template <typename T>
+static void Patch(std::vector<uint8_t>& Bytes, size_t Offset, T Value)
+{
+	std::memcpy(Bytes.data() + Offset, &Value, sizeof(T));
+}
+
+TEST_CASE("Writer output matches the checked-in fixture")
+{
+	const std::vector<uint8_t> Bytes = MakeSampleIndex();
+
+	if (std::getenv("VSTOOLS_UPDATE_FIXTURES") != nullptr)
+	{
+		CHECK(Tests::WriteFile(Tests::GetFixturePath(SampleIndexFixture), Bytes));
+	}
+
+	std::vector<uint8_t> Fixture;
+	CHECK(Tests::ReadFile(Tests::GetFixturePath(SampleIndexFixture), Fixture));
+	CHECK(Fixture == Bytes);
+}
+
+TEST_CASE("Reader round trip of the fixture")
+{
+	std::vector<uint8_t> Bytes;
+	CHECK(Tests::ReadFile(Tests::GetFixturePath(SampleIndexFixture), Bytes));
+
+	FBinaryIndexReader Reader;
+	CHECK(Reader.Open(Bytes.data(), Bytes.size()));
+
+	const FBinaryHeader& Header = Reader.GetHeader();
+	CHECK(Header.BlueprintCount == 2);
+	CHECK(Header.ClassCount == 2);
+	CHECK(Header.PropertyCount == 3);
+	CHECK(Header.FunctionCount == 1);
+	CHECK(Header.ValueCount == 5);
+	CHECK(Header.BlueprintRefCount == 4);
+
+	// "Character Movement" is used as a category and as a value, and stored once.
+	CHECK(Header.StringCount == 12);
+
+	CHECK(Reader.GetString(Reader.GetBlueprint(1).Name) == "BP_Enemy_C");
+	CHECK(Reader.GetString(Reader.GetBlueprint(1).Path) == "/Game/Characters/BP_Enemy.BP_Enemy");
+
+	const int64_t CharacterIdx = Reader.FindClass("ACharacter");
+	CHECK(CharacterIdx == 0);
+	CHECK(Reader.FindClass("AActor") == 1);
+	CHECK(Reader.FindClass("APawn") == -1);
+	CHECK(Reader.FindClass("") == -1);
+
+	const FBinaryClass Character = Reader.GetClass(static_cast<uint32_t>(CharacterIdx));
+	CHECK(Reader.GetBlueprintRef(Character.FirstBlueprintRef + 1) == 1);
+
+	const FBinaryProperty CanJump = Reader.GetProperty(Character.FirstProperty);
+	CHECK(Reader.GetString(CanJump.Name) == "bCanJump");
+	CHECK(Reader.GetString(CanJump.Categories) == "Character Movement");
+	CHECK(Reader.GetValue(CanJump.FirstValue).Kind == EValueKind::Bool);
+	CHECK(Reader.GetValue(CanJump.FirstValue).Payload == 1);
+
+	const FBinaryProperty HoldTime = Reader.GetProperty(Character.FirstProperty + 1);
+	CHECK(HoldTime.Categories == InvalidString);
+	CHECK(Reader.GetString(HoldTime.Categories).empty());
+	CHECK(Reader.GetValue(HoldTime.FirstValue).Kind == EValueKind::Number);
+	CHECK(FBinaryIndexReader::GetNumber(Reader.GetValue(HoldTime.FirstValue)) == 0.25);
+
+	const FBinaryFunction Jump = Reader.GetFunction(Character.FirstFunction);
+	CHECK(Reader.GetString(Jump.Name) == "Jump");
+	CHECK(Jump.BlueprintCount == 1);
+	CHECK(Reader.GetBlueprintRef(Jump.FirstBlueprintRef) == 1);
+
+	const FBinaryProperty LifeSpan = Reader.GetProperty(Reader.GetClass(1).FirstProperty);
+	const FBinaryValue StringValue = Reader.GetValue(LifeSpan.FirstValue);
+	CHECK(StringValue.Kind == EValueKind::String);
+	CHECK(Reader.GetString(static_cast<uint32_t>(StringValue.Payload)) == "Character Movement");
+	CHECK(Reader.GetValue(LifeSpan.FirstValue + 1).Kind == EValueKind::None);
+}
+
+TEST_CASE("Sections are aligned")
+{
+	const std::vector<uint8_t> Bytes = MakeSampleIndex();
+
+	FBinaryIndexReader Reader;
+	CHECK(Reader.Open(Bytes.data(), Bytes.size()));
+
+	const FBinaryHeader& Header = Reader.GetHeader();
+	for (uint64_t Offset : { Header.StringOffsetsOffset, Header.StringDataOffset, Header.BlueprintsOffset, Header.ClassesOffset,
+			 Header.PropertiesOffset, Header.FunctionsOffset, Header.ValuesOffset, Header.BlueprintRefsOffset })
+	{
+		CHECK(Offset % SectionAlignment == 0);
+	}
+}
+
+TEST_CASE("Empty index")
+{
+	std::vector<uint8_t> Bytes;
+	FBinaryIndexWriter().Write(Bytes);
+
+	FBinaryIndexReader Reader;
+	CHECK(Reader.Open(Bytes.data(), Bytes.size()));
+	CHECK(Reader.GetHeader().StringCount == 0);
+	CHECK(Reader.FindClass("AActor") == -1);
+	CHECK(Reader.GetString(0).empty());
+}
+
+TEST_CASE("Open rejects truncated files")
+{
+	const std::vector<uint8_t> Bytes = MakeSampleIndex();
+
+	FBinaryIndexReader Reader;
+	CHECK(!Reader.Open(nullptr, 0));
+
+	// The last section is not empty, so every truncation cuts a section.
+	for (size_t Size = 0; Size < Bytes.size(); Size++)
+	{
+		const std::vector<uint8_t> Truncated(Bytes.begin(), Bytes.begin() + Size);
+		CHECK(!Reader.Open(Truncated.data(), Truncated.size()));
+	}
+}
+
+TEST_CASE("Open rejects invalid headers")
+{
+	const std::vector<uint8_t> Bytes = MakeSampleIndex();
+	FBinaryIndexReader Reader;
+
+	std::vector<uint8_t> BadMagic = Bytes;
+	Patch<uint32_t>(BadMagic, offsetof(FBinaryHeader, Magic), 0x12345678);
+	CHECK(!Reader.Open(BadMagic.data(), BadMagic.size()));
+
+	std::vector<uint8_t> BadVersion = Bytes;
+	Patch<uint32_t>(BadVersion, offsetof(FBinaryHeader, Version), Version + 1);
+	CHECK(!Reader.Open(BadVersion.data(), BadVersion.size()));
+
+	std::vector<uint8_t> Misaligned = Bytes;
+	uint64_t ClassesOffset = 0;
+	std::memcpy(&ClassesOffset, Bytes.data() + offsetof(FBinaryHeader, ClassesOffset), sizeof(uint64_t));
+	Patch<uint64_t>(Misaligned, offsetof(FBinaryHeader, ClassesOffset), ClassesOffset + 4);
+	CHECK(!Reader.Open(Misaligned.data(), Misaligned.size()));
+
+	std::vector<uint8_t> OutOfBounds = Bytes;
+	Patch<uint64_t>(OutOfBounds, offsetof(FBinaryHeader, ValuesOffset), uint64_t(Bytes.size()) + SectionAlignment);
+	CHECK(!Reader.Open(OutOfBounds.data(), OutOfBounds.size()));
+
+	// A count so large that the section length overflows 32 bits must not wrap around.
+	std::vector<uint8_t> HugeCount = Bytes;
+	Patch<uint32_t>(HugeCount, offsetof(FBinaryHeader, ValueCount), 0xFFFFFFFF);
+	CHECK(!Reader.Open(HugeCount.data(), HugeCount.size()));
+
+	// The end of the string data is read from the offsets table.
+	std::vector<uint8_t> HugeStrings = Bytes;
+	uint64_t StringOffsetsOffset = 0;
+	uint32_t StringCount = 0;
+	std::memcpy(&StringOffsetsOffset, Bytes.data() + offsetof(FBinaryHeader, StringOffsetsOffset), sizeof(uint64_t));
+	std::memcpy(&StringCount, Bytes.data() + offsetof(FBinaryHeader, StringCount), sizeof(uint32_t));
+	Patch<uint32_t>(HugeStrings, static_cast<size_t>(StringOffsetsOffset + StringCount * sizeof(uint32_t)), 0x7FFFFFFF);
+	CHECK(!Reader.Open(HugeStrings.data(), HugeStrings.size()));
+}
+
+TEST_CASE("GetString handles invalid indices and offsets")
+{
+	std::vector<uint8_t> Bytes = MakeSampleIndex();
+
+	FBinaryIndexReader Reader;
+	CHECK(Reader.Open(Bytes.data(), Bytes.size()));
+
+	const uint32_t StringCount = Reader.GetHeader().StringCount;
+	CHECK(!Reader.GetString(StringCount - 1).empty());
+	CHECK(Reader.GetString(StringCount).empty());
+	CHECK(Reader.GetString(InvalidString).empty());
+
+	// An offset table that goes backwards yields an empty string instead of a huge one.
+	const uint64_t StringOffsetsOffset = Reader.GetHeader().StringOffsetsOffset;
+	Patch<uint32_t>(Bytes, static_cast<size_t>(StringOffsetsOffset + sizeof(uint32_t)), 0);
+	Patch<uint32_t>(Bytes, static_cast<size_t>(StringOffsetsOffset), 5);
+	CHECK(Reader.Open(Bytes.data(), Bytes.size()));
+	CHECK(Reader.GetString(0).empty());
+}
+
+TEST_CASE("Records out of range read as zero")
+{
+	const std::vector<uint8_t> Bytes = MakeSampleIndex();
+
+	FBinaryIndexReader Reader;
+	CHECK(Reader.Open(Bytes.data(), Bytes.size()));
+
+	// Past the end of the file, the accessors return empty records instead of reading out of bounds.
+	CHECK(Reader.GetBlueprintRef(0xFFFFFFFF) == 0);
+	CHECK(Reader.GetValue(0xFFFFFFFF).Payload == 0);
+	CHECK(Reader.GetClass(0xFFFFFFFF).Name == 0);
+}
+
+TEST_MAIN()
@@ -0,0 +1,662 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "BlueprintPackageReader.h"
+#include "TestHarness.h"
+
+#include <cstdlib>
+#include <limits>
+#include <random>
+
+using namespace VisualStudioTools;
+using namespace VisualStudioTools::PackageReader;
+
+// Checked-in packages written by `WritePackage` for `MakeUE4Package` and `MakeUE5Package`.
+// They are not saved by the editor: they follow the layout of `FPackageFileSummary` and of the asset registry
+// data saved by the engine versions in their name, with only the sections before the asset registry data filled in.
+// Regenerate them with `VSTOOLS_UPDATE_FIXTURES=1` when the packages below change.
+static const char* UE4PackageFixture = "BlueprintUE4.uasset";
+static const char* UE5PackageFixture = "BlueprintUE5.uasset";
+
+/**
+* Header of an editor package, with the versions that select the optional fields of the summary.
+*/
+struct FPackageSpec
+{
+	int32_t LegacyFileVersion = -7;
+	int32_t FileVersionUE4 = 522;
+	int32_t FileVersionUE5 = 0;
+	uint32_t PackageFlags = 0;
+	int32_t CustomVersionCount = 2;
+	int32_t CompressedChunkCount = 0;
+	std::string PackageName = "/Game/Characters/BP_Hero";
+	std::vector<FAssetTags> Assets;
+};
+
+/** Little-endian writer of the engine archive types. */
+class FPackageWriter
+{
+public:
+	std::vector<uint8_t> Bytes;
+
+	template <typename T>
+	void Write(T Value)
+	{
+		const uint8_t* Data = reinterpret_cast<const uint8_t*>(&Value);
+		Bytes.insert(Bytes.end(), Data, Data + sizeof(T));
+	}
+
+	void WriteZeros(size_t Count)
+	{
+		Bytes.insert(Bytes.end(), Count, 0);
+	}
+
+	/** Writes a `FString`: Latin-1 with a positive length, or UTF-16 with a negative length if any character needs it. */
+	void WriteString(const std::string& Utf8)
+	{
+		if (Utf8.empty())
+		{
+			Write<int32_t>(0);
+			return;
+		}
+
+		const std::u16string Utf16 = ToUtf16(Utf8);
+		bool bAnsi = true;
+		for (char16_t Unit : Utf16)
+		{
+			bAnsi = bAnsi && Unit < 0x80;
+		}
+
+		if (bAnsi)
+		{
+			Write<int32_t>(static_cast<int32_t>(Utf16.size() + 1));
+			for (char16_t Unit : Utf16)
+			{
+				Write<uint8_t>(static_cast<uint8_t>(Unit));
+			}
+			Write<uint8_t>(0);
+		}
+		else
+		{
+			Write<int32_t>(-static_cast<int32_t>(Utf16.size() + 1));
+			for (char16_t Unit : Utf16)
+			{
+				Write<uint16_t>(Unit);
+			}
+			Write<uint16_t>(0);
+		}
+	}
+
+	void Patch(size_t Offset, int32_t Value)
+	{
+		std::memcpy(Bytes.data() + Offset, &Value, sizeof(Value));
+	}
+
+private:
+	static std::u16string ToUtf16(const std::string& Utf8)
+	{
+		std::u16string Result;
+		for (size_t Idx = 0; Idx < Utf8.size();)
+		{
+			const uint8_t Lead = static_cast<uint8_t>(Utf8[Idx]);
+			const int Length = Lead < 0x80 ? 1 : Lead < 0xE0 ? 2 : Lead < 0xF0 ? 3 : 4;
+			uint32_t CodePoint = Length == 1 ? Lead : Lead & (0xFF >> (Length + 1));
+			for (int Continuation = 1; Continuation < Length; Continuation++)
+			{
+				CodePoint = (CodePoint << 6) | (static_cast<uint8_t>(Utf8[Idx + Continuation]) & 0x3F);
+			}
+
+			if (CodePoint >= 0x10000)
+			{
+				CodePoint -= 0x10000;
+				Result += static_cast<char16_t>(0xD800 + (CodePoint >> 10));
+				Result += static_cast<char16_t>(0xDC00 + (CodePoint & 0x3FF));
+			}
+			else
+			{
+				Result += static_cast<char16_t>(CodePoint);
+			}
+
+			Idx += Length;
+		}
+
+		return Result;
+	}
+};
+
+/** Writes the package summary in the order of `operator<<(FArchive&, FPackageFileSummary&)`, followed by the asset registry data. */
+static std::vector<uint8_t> WritePackage(const FPackageSpec& Spec)
+{
+	const int32_t UE4 = Spec.FileVersionUE4;
+	const int32_t UE5 = Spec.FileVersionUE5;
+	const bool bFilterEditorOnly = (Spec.PackageFlags & PackageFlagFilterEditorOnly) != 0;
+
+	FPackageWriter Writer;
+	Writer.Write<uint32_t>(PackageFileTag);
+	Writer.Write<int32_t>(Spec.LegacyFileVersion);
+	if (Spec.LegacyFileVersion != -4)
+	{
+		Writer.Write<int32_t>(864); // LegacyUE3Version
+	}
+
+	Writer.Write<int32_t>(UE4);
+	if (Spec.LegacyFileVersion <= -8)
+	{
+		Writer.Write<int32_t>(UE5);
+	}
+
+	Writer.Write<int32_t>(0); // FileVersionLicenseeUE
+
+	Writer.Write<int32_t>(Spec.CustomVersionCount);
+	for (int32_t Idx = 0; Idx < Spec.CustomVersionCount; Idx++)
+	{
+		Writer.Write<uint32_t>(0x12345678u + Idx); // Key
+		Writer.WriteZeros(12);
+		Writer.Write<int32_t>(Idx + 1); // Version
+	}
+
+	if (UE5 >= UE5Version::PackageSavedHash)
+	{
+		Writer.WriteZeros(20); // SavedHash
+	}
+
+	const size_t TotalHeaderSizeOffset = Writer.Bytes.size();
+	Writer.Write<int32_t>(0); // TotalHeaderSize
+	Writer.WriteString(Spec.PackageName);
+	Writer.Write<uint32_t>(Spec.PackageFlags);
+	Writer.Write<int32_t>(0); // NameCount
+	Writer.Write<int32_t>(0); // NameOffset
+
+	if (UE5 >= UE5Version::AddSoftObjectPathList)
+	{
+		Writer.WriteZeros(8); // SoftObjectPathsCount, SoftObjectPathsOffset
+	}
+
+	if (!bFilterEditorOnly && UE4 >= UE4Version::AddedPackageSummaryLocalizationId)
+	{
+		Writer.WriteString("5D3A6C1E4B9F2A7D8E0C1B2A3F4D5E6F"); // LocalizationId
+	}
+
+	if (UE4 >= UE4Version::SerializeTextInPackages)
+	{
+		Writer.WriteZeros(8); // GatherableTextDataCount, GatherableTextDataOffset
+	}
+
+	Writer.WriteZeros(16); // ExportCount, ExportOffset, ImportCount, ImportOffset
+
+	if (UE5 >= UE5Version::VerseCells)
+	{
+		Writer.WriteZeros(16); // CellExportCount, CellExportOffset, CellImportCount, CellImportOffset
+	}
+
+	if (UE5 >= UE5Version::MetadataSerializationOffset)
+	{
+		Writer.WriteZeros(4); // MetaDataOffset
+	}
+
+	Writer.WriteZeros(4); // DependsOffset
+
+	if (UE4 >= UE4Version::AddStringAssetReferencesMap)
+	{
+		Writer.WriteZeros(8); // SoftPackageReferencesCount, SoftPackageReferencesOffset
+	}
+
+	if (UE4 >= UE4Version::AddedSearchableNames)
+	{
+		Writer.WriteZeros(4); // SearchableNamesOffset
+	}
+
+	Writer.WriteZeros(4); // ThumbnailTableOffset
+
+	if (UE5 < UE5Version::PackageSavedHash)
+	{
+		Writer.WriteZeros(16); // Guid
+	}
+
+	if (!bFilterEditorOnly)
+	{
+		if (UE4 >= UE4Version::AddedPackageOwner)
+		{
+			Writer.WriteZeros(16); // PersistentGuid
+		}
+
+		if (UE4 >= UE4Version::AddedPackageOwner && UE4 < UE4Version::NonOuterPackageImport)
+		{
+			Writer.WriteZeros(16); // OwnerPersistentGuid
+		}
+	}
+
+	Writer.Write<int32_t>(1); // Generations
+	Writer.Write<int32_t>(1); // ExportCount
+	Writer.Write<int32_t>(12); // NameCount
+
+	if (UE4 >= UE4Version::EngineVersionObject)
+	{
+		Writer.Write<uint16_t>(UE5 != 0 ? 5 : 4); // SavedByEngineVersion
+		Writer.Write<uint16_t>(UE5 != 0 ? 3 : 27);
+		Writer.Write<uint16_t>(2);
+		Writer.Write<uint32_t>(0);
+		Writer.WriteString(UE5 != 0 ? "++UE5+Release-5.3" : "++UE4+Release-4.27");
+	}
+	else
+	{
+		Writer.Write<int32_t>(0); // EngineChangelist
+	}
+
+	if (UE4 >= UE4Version::PackageSummaryHasCompatibleEngineVersion)
+	{
+		Writer.Write<uint16_t>(UE5 != 0 ? 5 : 4); // CompatibleWithEngineVersion
+		Writer.Write<uint16_t>(UE5 != 0 ? 3 : 27);
+		Writer.Write<uint16_t>(0);
+		Writer.Write<uint32_t>(0);
+		Writer.WriteString(UE5 != 0 ? "++UE5+Release-5.3" : "++UE4+Release-4.27");
+	}
+
+	Writer.Write<uint32_t>(0); // CompressionFlags
+	Writer.Write<int32_t>(Spec.CompressedChunkCount);
+	Writer.Write<uint32_t>(0xA1B2C3D4); // PackageSource
+	Writer.Write<int32_t>(0); // AdditionalPackagesToCook
+
+	if (Spec.LegacyFileVersion > -7)
+	{
+		Writer.Write<int32_t>(0); // NumTextureAllocations
+	}
+
+	const size_t AssetRegistryDataOffset = Writer.Bytes.size();
+	Writer.Write<int32_t>(0); // AssetRegistryDataOffset
+
+	// The rest of the summary and the tables in between are never read.
+	Writer.WriteZeros(64);
+	Writer.Patch(TotalHeaderSizeOffset, static_cast<int32_t>(Writer.Bytes.size()));
+	Writer.Patch(AssetRegistryDataOffset, static_cast<int32_t>(Writer.Bytes.size()));
+
+	if (UE4 >= UE4Version::AssetRegistryDependencyFlags)
+	{
+		Writer.Write<int64_t>(0); // DependencyDataOffset
+	}
+
+	Writer.Write<int32_t>(static_cast<int32_t>(Spec.Assets.size()));
+	for (const FAssetTags& Asset : Spec.Assets)
+	{
+		Writer.WriteString(Asset.ObjectPath);
+		Writer.WriteString(Asset.ClassName);
+		Writer.Write<int32_t>(static_cast<int32_t>(Asset.Tags.size()));
+		for (const auto& Tag : Asset.Tags)
+		{
+			Writer.WriteString(Tag.first);
+			Writer.WriteString(Tag.second);
+		}
+	}
+
+	return Writer.Bytes;
+}
+
+/** A 4.27 package with a blueprint and its blueprint parent. */
+static FPackageSpec MakeUE4Package()
+{
+	FPackageSpec Spec;
+	Spec.LegacyFileVersion = -7;
+	Spec.FileVersionUE4 = 522;
+	Spec.Assets.push_back({ "BP_Hero", "Blueprint", {
+		{ "BlueprintType", "BPTYPE_Normal" },
+		{ std::string(GeneratedClassTag), "BlueprintGeneratedClass'/Game/Characters/BP_Hero.BP_Hero_C'" },
+		{ std::string(ParentClassTag), "BlueprintGeneratedClass'/Game/Characters/BP_Base.BP_Base_C'" },
+		{ std::string(NativeParentClassTag), "Class'/Script/Engine.Character'" },
+	} });
+
+	return Spec;
+}
+
+/** A 5.3 package with a blueprint with non-Latin-1 tags, and an asset that is not a blueprint. */
+static FPackageSpec MakeUE5Package()
+{
+	FPackageSpec Spec;
+	Spec.LegacyFileVersion = -8;
+	Spec.FileVersionUE4 = 522;
+	Spec.FileVersionUE5 = 1009;
+	Spec.PackageName = "/Game/Props/BP_Door";
+	Spec.Assets.push_back({ "/Game/Props/BP_Door.BP_Door", "/Script/Engine.Blueprint", {
+		{ std::string(GeneratedClassTag), "/Script/Engine.BlueprintGeneratedClass'/Game/Props/BP_Door.BP_Door_C'" },
+		{ std::string(ParentClassTag), "/Script/CoreUObject.Class'/Script/Engine.Actor'" },
+		{ std::string(NativeParentClassTag), "/Script/CoreUObject.Class'/Script/Engine.Actor'" },
+		{ "Description", "Porte d\xC3\xA9rob\xC3\xA9""e \xF0\x9F\x9A\xAA" },
+	} });
+	Spec.Assets.push_back({ "/Game/Props/BP_Door.Thumbnail", "/Script/Engine.Texture2D", {} });
+
+	return Spec;
+}
+
+static bool ReadFixture(const char* Name, std::vector<uint8_t>& OutBytes)
+{
+	return Tests::ReadFile(Tests::GetFixturePath(Name), OutBytes);
+}
+
+static bool HasTag(const FAssetTags& Asset, std::string_view Name, std::string_view Value)
+{
+	const std::string* Found = Asset.FindTag(Name);
+	return Found != nullptr && *Found == Value;
+}
+
+/** Reads the package and checks that a failed read leaves the output untouched. Returns whether it succeeded. */
+static bool ReadChecked(const std::vector<uint8_t>& Bytes)
+{
+	std::vector<FAssetTags> Assets(1);
+	Assets[0].ObjectPath = "Sentinel";
+
+	const bool bRead = ReadAssetTags(Bytes.data(), Bytes.size(), Assets);
+	CHECK(!Assets.empty() && Assets[0].ObjectPath == "Sentinel");
+	if (!bRead)
+	{
+		CHECK(Assets.size() == 1);
+	}
+
+	// Whatever was read must be usable by the index builder.
+	FBlueprintIndexBuilder Builder;
+	for (size_t Idx = 1; Idx < Assets.size(); Idx++)
+	{
+		Builder.AddAsset(Assets[Idx]);
+	}
+	CHECK(!Builder.ToJson().empty());
+
+	return bRead;
+}
+
+TEST_CASE("Writer output matches the checked-in fixtures")
+{
+	const std::pair<const char*, std::vector<uint8_t>> Packages[] = {
+		{ UE4PackageFixture, WritePackage(MakeUE4Package()) },
+		{ UE5PackageFixture, WritePackage(MakeUE5Package()) },
+	};
+
+	for (const auto& Package : Packages)
+	{
+		if (std::getenv("VSTOOLS_UPDATE_FIXTURES") != nullptr)
+		{
+			CHECK(Tests::WriteFile(Tests::GetFixturePath(Package.first), Package.second));
+		}
+
+		std::vector<uint8_t> Fixture;
+		CHECK(ReadFixture(Package.first, Fixture));
+		CHECK(Fixture == Package.second);
+	}
+}
+
+TEST_CASE("Reads the tags of a UE4 package")
+{
+	std::vector<uint8_t> Bytes;
+	CHECK(ReadFixture(UE4PackageFixture, Bytes));
+
+	std::vector<FAssetTags> Assets;
+	CHECK(ReadAssetTags(Bytes.data(), Bytes.size(), Assets));
+	CHECK(Assets.size() == 1);
+	if (Assets.size() != 1)
+	{
+		return;
+	}
+
+	CHECK(Assets[0].ObjectPath == "BP_Hero");
+	CHECK(Assets[0].ClassName == "Blueprint");
+	CHECK(Assets[0].Tags.size() == 4);
+	CHECK(HasTag(Assets[0], "BlueprintType", "BPTYPE_Normal"));
+	CHECK(HasTag(Assets[0], ParentClassTag, "BlueprintGeneratedClass'/Game/Characters/BP_Base.BP_Base_C'"));
+	CHECK(HasTag(Assets[0], NativeParentClassTag, "Class'/Script/Engine.Character'"));
+	CHECK(Assets[0].FindTag("Missing") == nullptr);
+}
+
+TEST_CASE("Reads the tags of a UE5 package")
+{
+	std::vector<uint8_t> Bytes;
+	CHECK(ReadFixture(UE5PackageFixture, Bytes));
+
+	std::vector<FAssetTags> Assets;
+	CHECK(ReadAssetTags(Bytes.data(), Bytes.size(), Assets));
+	CHECK(Assets.size() == 2);
+	if (Assets.size() != 2)
+	{
+		return;
+	}
+
+	CHECK(Assets[0].ObjectPath == "/Game/Props/BP_Door.BP_Door");
+	CHECK(Assets[0].ClassName == "/Script/Engine.Blueprint");
+	CHECK(HasTag(Assets[0], ParentClassTag, "/Script/CoreUObject.Class'/Script/Engine.Actor'"));
+	CHECK(HasTag(Assets[0], NativeParentClassTag, "/Script/CoreUObject.Class'/Script/Engine.Actor'"));
+	CHECK(HasTag(Assets[0], "Description", "Porte d\xC3\xA9rob\xC3\xA9""e \xF0\x9F\x9A\xAA"));
+	CHECK(Assets[1].ObjectPath == "/Game/Props/BP_Door.Thumbnail");
+	CHECK(Assets[1].Tags.empty());
+}
+
+TEST_CASE("Reads every known summary layout")
+{
+	const std::pair<int32_t, int32_t> Versions[] = {
+		{ -6, 0 }, { -7, 0 }, { -8, 1004 }, { -8, UE5Version::AddSoftObjectPathList }, { -8, UE5Version::MetadataSerializationOffset },
+		{ -9, UE5Version::VerseCells }, { -9, UE5Version::PackageSavedHash },
+	};
+
+	for (const auto& Version : Versions)
+	{
+		for (const int32_t UE4 : { UE4Version::AddedPackageOwner, UE4Version::AssetRegistryDependencyFlags, 522 })
+		{
+			FPackageSpec Spec = MakeUE4Package();
+			Spec.LegacyFileVersion = Version.first;
+			Spec.FileVersionUE4 = UE4;
+			Spec.FileVersionUE5 = Version.second;
+
+			const std::vector<uint8_t> Bytes = WritePackage(Spec);
+			std::vector<FAssetTags> Assets;
+			CHECK(ReadAssetTags(Bytes.data(), Bytes.size(), Assets));
+			CHECK(Assets.size() == 1 && Assets[0].Tags.size() == 4);
+		}
+	}
+}
+
+TEST_CASE("Index JSON of the fixtures")
+{
+	FBlueprintIndexBuilder Builder;
+	for (const char* Fixture : { UE4PackageFixture, UE5PackageFixture })
+	{
+		std::vector<uint8_t> Bytes;
+		CHECK(ReadFixture(Fixture, Bytes));
+		CHECK(Builder.AddPackage(Bytes.data(), Bytes.size()));
+	}
+
+	CHECK(Builder.GetBlueprintCount() == 2);
+	CHECK(Builder.ToJson() ==
+		"{\"blueprints\":["
+		"{\"name\":\"BP_Hero_C\",\"path\":\"/Game/Characters/BP_Hero.BP_Hero_C\"},"
+		"{\"name\":\"BP_Door_C\",\"path\":\"/Game/Props/BP_Door.BP_Door_C\"}],"
+		"\"classes\":["
+		"{\"name\":\"Character\",\"blueprints\":[0]},"
+		"{\"name\":\"Actor\",\"blueprints\":[1]}]}");
+
+	const std::string Prefixed = Builder.ToJson([](std::string_view ClassPath) { return "A" + std::string(GetObjectName(ClassPath)); });
+	CHECK(Prefixed.find("{\"name\":\"ACharacter\",\"blueprints\":[0]}") != std::string::npos);
+}
+
+TEST_CASE("JSON strings are escaped")
+{
+	FBlueprintIndexBuilder Builder;
+	Builder.AddAsset({ "BP", "Blueprint", {
+		{ std::string(GeneratedClassTag), "'/Game/A\"B\\C\n\x01.BP_C'" },
+		{ std::string(NativeParentClassTag), "'/Script/Engine.Actor'" },
+	} });
+
+	CHECK(Builder.ToJson().find("\"path\":\"/Game/A\\\"B\\\\C\\n\\u0001.BP_C\"") != std::string::npos);
+}
+
+TEST_CASE("Assets without blueprint tags are not indexed")
+{
+	FBlueprintIndexBuilder Builder;
+	Builder.AddAsset({ "Texture", "Texture2D", {} });
+	Builder.AddAsset({ "BP", "Blueprint", { { std::string(GeneratedClassTag), "'/Game/BP.BP_C'" } } });
+	Builder.AddAsset({ "BP", "Blueprint", { { std::string(GeneratedClassTag), "" }, { std::string(NativeParentClassTag), "''" } } });
+
+	CHECK(Builder.GetBlueprintCount() == 0);
+	CHECK(Builder.ToJson() == "{\"blueprints\":[],\"classes\":[]}");
+}
+
+TEST_CASE("Rejects packages that can't be read without the engine")
+{
+	auto IsRejected = [](FPackageSpec Spec)
+	{
+		const std::vector<uint8_t> Bytes = WritePackage(Spec);
+		return !ReadChecked(Bytes);
+	};
+
+	FPackageSpec Spec = MakeUE5Package();
+	CHECK(!IsRejected(Spec));
+
+	FPackageSpec Cooked = Spec;
+	Cooked.PackageFlags |= PackageFlagFilterEditorOnly;
+	CHECK(IsRejected(Cooked));
+
+	FPackageSpec Unversioned = Spec;
+	Unversioned.FileVersionUE4 = 0;
+	CHECK(IsRejected(Unversioned));
+
+	FPackageSpec TooOld = Spec;
+	TooOld.FileVersionUE4 = UE4Version::OldestLoadable - 1;
+	CHECK(IsRejected(TooOld));
+
+	FPackageSpec UnknownLegacyVersion = Spec;
+	UnknownLegacyVersion.LegacyFileVersion = OldestLegacyFileVersion - 1;
+	CHECK(IsRejected(UnknownLegacyVersion));
+
+	FPackageSpec Compressed = Spec;
+	Compressed.CompressedChunkCount = 1;
+	CHECK(IsRejected(Compressed));
+
+	FPackageSpec NegativeCustomVersions = Spec;
+	NegativeCustomVersions.CustomVersionCount = -1;
+	CHECK(IsRejected(NegativeCustomVersions));
+
+	std::vector<uint8_t> BadTag = WritePackage(Spec);
+	BadTag[0] ^= 0xFF;
+	CHECK(!ReadChecked(BadTag));
+
+	CHECK(!ReadChecked({}));
+	std::vector<FAssetTags> Assets;
+	CHECK(!ReadAssetTags(nullptr, 128, Assets));
+}
+
+TEST_CASE("Rejects every truncation")
+{
+	for (const char* Fixture : { UE4PackageFixture, UE5PackageFixture })
+	{
+		std::vector<uint8_t> Bytes;
+		CHECK(ReadFixture(Fixture, Bytes));
+		CHECK(ReadChecked(Bytes));
+
+		// Copied into a buffer of the exact size, so the sanitizers catch any read past the end.
+		for (size_t Size = 0; Size < Bytes.size(); Size++)
+		{
+			const std::vector<uint8_t> Truncated(Bytes.begin(), Bytes.begin() + Size);
+			CHECK(!ReadChecked(Truncated));
+		}
+	}
+}
+
+TEST_CASE("Survives corrupted counts, lengths and offsets")
+{
+	static constexpr int32_t Int32Max = std::numeric_limits<int32_t>::max();
+	static constexpr int32_t Int32Min = std::numeric_limits<int32_t>::min();
+
+	for (const char* Fixture : { UE4PackageFixture, UE5PackageFixture })
+	{
+		std::vector<uint8_t> Bytes;
+		CHECK(ReadFixture(Fixture, Bytes));
+
+		const int32_t Size = static_cast<int32_t>(Bytes.size());
+		const int32_t Values[] = { 0, 1, -1, 12, Size - 1, Size, Size + 1, Int32Max / 12 + 1, Int32Max, Int32Min, Int32Min + 1 };
+
+		// Every field is a 32-bit value or starts with one, so this covers every count, length and offset.
+		for (size_t Offset = 0; Offset + sizeof(int32_t) <= Bytes.size(); Offset++)
+		{
+			for (const int32_t Value : Values)
+			{
+				std::vector<uint8_t> Corrupted = Bytes;
+				std::memcpy(Corrupted.data() + Offset, &Value, sizeof(Value));
+				ReadChecked(Corrupted);
+			}
+		}
+	}
+}
+
+TEST_CASE("Survives random corruption")
+{
+	std::mt19937 Random(0x5653);
+
+	for (const char* Fixture : { UE4PackageFixture, UE5PackageFixture })
+	{
+		std::vector<uint8_t> Bytes;
+		CHECK(ReadFixture(Fixture, Bytes));
+
+		std::uniform_int_distribution<size_t> OffsetDistribution(0, Bytes.size() - 1);
+		std::uniform_int_distribution<int> ByteDistribution(0, 255);
+		std::uniform_int_distribution<int> CountDistribution(1, 8);
+
+		for (int Iteration = 0; Iteration < 20000; Iteration++)
+		{
+			std::vector<uint8_t> Corrupted = Bytes;
+			for (int Mutation = CountDistribution(Random); Mutation > 0; Mutation--)
+			{
+				Corrupted[OffsetDistribution(Random)] = static_cast<uint8_t>(ByteDistribution(Random));
+			}
+
+			// Some mutations also cut the package short.
+			if (Iteration % 4 == 0)
+			{
+				Corrupted.resize(OffsetDistribution(Random));
+			}
+
+			ReadChecked(Corrupted);
+		}
+	}
+}
+
+TEST_CASE("String bounds")
+{
+	auto ReadStrings = [](const std::vector<uint8_t>& Bytes, int Count)
+	{
+		FPackageArchive Ar(Bytes.data(), Bytes.size());
+		std::string Last;
+		for (int Idx = 0; Idx < Count; Idx++)
+		{
+			Last = Ar.ReadString();
+		}
+		return std::make_pair(Ar.IsError(), Last);
+	};
+
+	FPackageWriter Writer;
+	Writer.WriteString("Hero");
+	CHECK(ReadStrings(Writer.Bytes, 1) == std::make_pair(false, std::string("Hero")));
+	CHECK(ReadStrings(Writer.Bytes, 2).first);
+
+	// Lengths past the end, in either encoding.
+	for (const int32_t Length : { 6, -3, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min() })
+	{
+		FPackageWriter Bad;
+		Bad.Write<int32_t>(Length);
+		Bad.Write<uint32_t>(0x00410041);
+		CHECK(ReadStrings(Bad.Bytes, 1).first);
+	}
+
+	// A lone high surrogate is kept as a code point instead of reading past the terminator.
+	FPackageWriter Surrogate;
+	Surrogate.Write<int32_t>(-2);
+	Surrogate.Write<uint16_t>(0xD800);
+	Surrogate.Write<uint16_t>(0);
+	const auto Result = ReadStrings(Surrogate.Bytes, 1);
+	CHECK(!Result.first && Result.second == "\xED\xA0\x80");
+
+	FPackageArchive Ar(Writer.Bytes.data(), Writer.Bytes.size());
+	Ar.Seek(-1);
+	CHECK(Ar.IsError());
+
+	FPackageArchive Skipper(Writer.Bytes.data(), Writer.Bytes.size());
+	Skipper.Skip(Writer.Bytes.size());
+	CHECK(!Skipper.IsError());
+	Skipper.Skip(1);
+	CHECK(Skipper.IsError());
+}
+
+TEST_MAIN()
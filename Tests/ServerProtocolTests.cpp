@@ -0,0 +1,426 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#include "TestHarness.h"
+#include "VSServerProtocol.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace VisualStudioTools;
+using namespace VisualStudioTools::ServerProtocol;
+
+/** Builds a single frame by hand, to test the reader with frames that `WriteMessage` never produces. */
+static std::vector<uint8_t> MakeFrame(
+	EMessageType Type, uint32_t RequestId, uint8_t Flags, const std::vector<uint8_t>& Payload, uint32_t FrameMagic = Magic, uint8_t FrameVersion = Version)
+{
+	FFrameHeader Header{};
+	Header.Magic = FrameMagic;
+	Header.Version = FrameVersion;
+	Header.Type = Type;
+	Header.Flags = Flags;
+	Header.RequestId = RequestId;
+	Header.PayloadSize = static_cast<uint32_t>(Payload.size());
+
+	std::vector<uint8_t> Frame(HeaderSize + Payload.size());
+	std::memcpy(Frame.data(), &Header, HeaderSize);
+	if (!Payload.empty())
+	{
+		std::memcpy(Frame.data() + HeaderSize, Payload.data(), Payload.size());
+	}
+
+	return Frame;
+}
+
+static std::vector<uint8_t> MakePayload(size_t Size, uint8_t Seed)
+{
+	std::vector<uint8_t> Payload(Size);
+	for (size_t Idx = 0; Idx < Size; Idx++)
+	{
+		Payload[Idx] = static_cast<uint8_t>(Seed + Idx * 31);
+	}
+
+	return Payload;
+}
+
+static void Append(std::vector<uint8_t>& Out, const std::vector<uint8_t>& Bytes)
+{
+	Out.insert(Out.end(), Bytes.begin(), Bytes.end());
+}
+
+/** Feeds the stream in chunks of the given sizes, repeated as needed, and collects the messages. */
+static std::vector<FMessage> ReadAll(const std::vector<uint8_t>& Stream, const std::vector<size_t>& ChunkSizes, FMessageReader& Reader)
+{
+	std::vector<FMessage> Messages;
+	size_t Offset = 0;
+	for (size_t Chunk = 0; Offset < Stream.size(); Chunk++)
+	{
+		const size_t ChunkSize = std::min(ChunkSizes[Chunk % ChunkSizes.size()], Stream.size() - Offset);
+		Reader.Append(Stream.data() + Offset, ChunkSize);
+		Offset += ChunkSize;
+
+		FMessage Message;
+		while (Reader.Next(Message))
+		{
+			Messages.push_back(std::move(Message));
+		}
+	}
+
+	return Messages;
+}
+
+static std::vector<FMessage> ReadAll(const std::vector<uint8_t>& Stream, const std::vector<size_t>& ChunkSizes)
+{
+	FMessageReader Reader;
+	std::vector<FMessage> Messages = ReadAll(Stream, ChunkSizes, Reader);
+	CHECK(!Reader.HasError());
+	return Messages;
+}
+
+static bool IsSameMessage(const FMessage& Message, EMessageType Type, uint32_t RequestId, const std::vector<uint8_t>& Payload)
+{
+	return Message.Type == Type && Message.RequestId == RequestId && Message.Payload == Payload;
+}
+
+/** Messages of every size class around the frame boundaries, including empty ones. */
+static const size_t MessageSizes[] = { 0, 1, HeaderSize - 1, HeaderSize, HeaderSize + 1, MaxFramePayload - 1, MaxFramePayload, MaxFramePayload + 1, 3 * MaxFramePayload + 7 };
+
+static std::vector<uint8_t> MakeSampleStream(std::vector<std::vector<uint8_t>>& OutPayloads)
+{
+	std::vector<uint8_t> Stream;
+	uint32_t RequestId = 1;
+	for (size_t Size : MessageSizes)
+	{
+		OutPayloads.push_back(MakePayload(Size, static_cast<uint8_t>(RequestId)));
+		WriteMessage(Stream, EMessageType::Request, RequestId++, OutPayloads.back().data(), Size);
+	}
+
+	return Stream;
+}
+
+static void CheckSampleMessages(const std::vector<FMessage>& Messages, const std::vector<std::vector<uint8_t>>& Payloads)
+{
+	CHECK(Messages.size() == Payloads.size());
+	for (size_t Idx = 0; Idx < Messages.size() && Idx < Payloads.size(); Idx++)
+	{
+		CHECK(IsSameMessage(Messages[Idx], EMessageType::Request, static_cast<uint32_t>(Idx + 1), Payloads[Idx]));
+	}
+}
+
+TEST_CASE("Frames of WriteMessage")
+{
+	std::vector<uint8_t> Empty;
+	WriteMessage(Empty, EMessageType::Response, 7, "");
+	CHECK(Empty.size() == HeaderSize);
+
+	FFrameHeader Header;
+	std::memcpy(&Header, Empty.data(), HeaderSize);
+	CHECK(Header.Magic == Magic && Header.Version == Version && Header.Type == EMessageType::Response);
+	CHECK(Header.Flags == 0 && Header.Reserved == 0 && Header.RequestId == 7 && Header.PayloadSize == 0);
+
+	// A payload that fills its frames exactly doesn't need an empty last frame.
+	std::vector<uint8_t> Exact;
+	WriteMessage(Exact, EMessageType::Data, 1, MakePayload(2 * MaxFramePayload, 0).data(), 2 * MaxFramePayload);
+	CHECK(Exact.size() == 2 * (HeaderSize + MaxFramePayload));
+	std::memcpy(&Header, Exact.data(), HeaderSize);
+	CHECK(Header.Flags == FrameFlagContinued && Header.PayloadSize == MaxFramePayload);
+	std::memcpy(&Header, Exact.data() + HeaderSize + MaxFramePayload, HeaderSize);
+	CHECK(Header.Flags == 0 && Header.PayloadSize == MaxFramePayload);
+}
+
+TEST_CASE("Messages of every size in a single read")
+{
+	std::vector<std::vector<uint8_t>> Payloads;
+	const std::vector<uint8_t> Stream = MakeSampleStream(Payloads);
+	CheckSampleMessages(ReadAll(Stream, { Stream.size() }), Payloads);
+}
+
+TEST_CASE("Messages split at every byte")
+{
+	std::vector<std::vector<uint8_t>> Payloads;
+	const std::vector<uint8_t> Stream = MakeSampleStream(Payloads);
+	CheckSampleMessages(ReadAll(Stream, { 1 }), Payloads);
+}
+
+TEST_CASE("Messages split in two at every offset")
+{
+	// Small messages, so every split point of the stream can be tested.
+	std::vector<uint8_t> Stream;
+	std::vector<std::vector<uint8_t>> Payloads;
+	for (uint32_t RequestId = 1; RequestId <= 4; RequestId++)
+	{
+		Payloads.push_back(MakePayload(RequestId * 5 - 5, static_cast<uint8_t>(RequestId)));
+		WriteMessage(Stream, EMessageType::Request, RequestId, Payloads.back().data(), Payloads.back().size());
+	}
+
+	for (size_t Split = 0; Split <= Stream.size(); Split++)
+	{
+		CheckSampleMessages(ReadAll(Stream, { Split == 0 ? Stream.size() : Split, Stream.size() }), Payloads);
+	}
+}
+
+TEST_CASE("Messages split at random offsets")
+{
+	std::vector<std::vector<uint8_t>> Payloads;
+	const std::vector<uint8_t> Stream = MakeSampleStream(Payloads);
+
+	std::mt19937 Random(0x5653);
+	std::uniform_int_distribution<size_t> ChunkDistribution(1, 2 * (HeaderSize + MaxFramePayload));
+	for (int Iteration = 0; Iteration < 50; Iteration++)
+	{
+		std::vector<size_t> ChunkSizes;
+		for (int Chunk = 0; Chunk < 64; Chunk++)
+		{
+			ChunkSizes.push_back(ChunkDistribution(Random));
+		}
+
+		CheckSampleMessages(ReadAll(Stream, ChunkSizes), Payloads);
+	}
+}
+
+TEST_CASE("Interleaved multi-frame requests")
+{
+	const std::vector<uint8_t> First = MakePayload(3, 1);
+	const std::vector<uint8_t> Second = MakePayload(5, 2);
+	const std::vector<uint8_t> Third = MakePayload(2, 3);
+	const std::vector<uint8_t> Empty;
+
+	// Request 1: [0,1) [1,3), request 2: [0,2) [2,4) [4,5) and request 3: [0,2) with an empty last frame.
+	std::vector<uint8_t> Stream;
+	Append(Stream, MakeFrame(EMessageType::Request, 1, FrameFlagContinued, { First[0] }));
+	Append(Stream, MakeFrame(EMessageType::Request, 2, FrameFlagContinued, { Second[0], Second[1] }));
+	Append(Stream, MakeFrame(EMessageType::Request, 3, FrameFlagContinued, Third));
+	Append(Stream, MakeFrame(EMessageType::Request, 2, FrameFlagContinued, { Second[2], Second[3] }));
+	Append(Stream, MakeFrame(EMessageType::Request, 1, 0, { First[1], First[2] }));
+	Append(Stream, MakeFrame(EMessageType::Request, 4, 0, Empty));
+	Append(Stream, MakeFrame(EMessageType::Request, 3, 0, Empty));
+	Append(Stream, MakeFrame(EMessageType::Request, 2, 0, { Second[4] }));
+
+	for (size_t ChunkSize : { Stream.size(), size_t(1), size_t(HeaderSize + 1) })
+	{
+		// The messages complete in the order of their last frames.
+		const std::vector<FMessage> Messages = ReadAll(Stream, { ChunkSize });
+		CHECK(Messages.size() == 4);
+		if (Messages.size() == 4)
+		{
+			CHECK(IsSameMessage(Messages[0], EMessageType::Request, 1, First));
+			CHECK(IsSameMessage(Messages[1], EMessageType::Request, 4, Empty));
+			CHECK(IsSameMessage(Messages[2], EMessageType::Request, 3, Third));
+			CHECK(IsSameMessage(Messages[3], EMessageType::Request, 2, Second));
+		}
+	}
+}
+
+TEST_CASE("Zero-length payloads")
+{
+	std::vector<uint8_t> Stream;
+	WriteMessage(Stream, EMessageType::Request, 1, "");
+	WriteMessage(Stream, EMessageType::Data, 1, "");
+	WriteMessage(Stream, EMessageType::Response, 1, "");
+
+	// Empty frames in the middle of a message don't end it.
+	Append(Stream, MakeFrame(EMessageType::Request, 2, FrameFlagContinued, {}));
+	Append(Stream, MakeFrame(EMessageType::Request, 2, FrameFlagContinued, { 'a' }));
+	Append(Stream, MakeFrame(EMessageType::Request, 2, FrameFlagContinued, {}));
+	Append(Stream, MakeFrame(EMessageType::Request, 2, 0, {}));
+
+	const std::vector<FMessage> Messages = ReadAll(Stream, { 1 });
+	CHECK(Messages.size() == 4);
+	if (Messages.size() == 4)
+	{
+		CHECK(IsSameMessage(Messages[0], EMessageType::Request, 1, {}));
+		CHECK(IsSameMessage(Messages[1], EMessageType::Data, 1, {}));
+		CHECK(IsSameMessage(Messages[2], EMessageType::Response, 1, {}));
+		CHECK(IsSameMessage(Messages[3], EMessageType::Request, 2, { 'a' }));
+	}
+}
+
+TEST_CASE("Same request ID with a new type after the message ends")
+{
+	// A request and its data and response messages all have the same ID.
+	std::vector<uint8_t> Stream;
+	WriteMessage(Stream, EMessageType::Request, 9, "{\"command\":\"ping\"}");
+	WriteMessage(Stream, EMessageType::Data, 9, MakePayload(MaxFramePayload + 1, 9).data(), MaxFramePayload + 1);
+	WriteMessage(Stream, EMessageType::Response, 9, "{\"result\":0}");
+
+	const std::vector<FMessage> Messages = ReadAll(Stream, { 1000 });
+	CHECK(Messages.size() == 3);
+	if (Messages.size() == 3)
+	{
+		CHECK(Messages[0].Type == EMessageType::Request);
+		CHECK(Messages[1].Type == EMessageType::Data && Messages[1].Payload.size() == MaxFramePayload + 1);
+		CHECK(Messages[2].Type == EMessageType::Response);
+	}
+}
+
+/** Reads the stream, which must produce `ValidMessages` messages and then fail. The error must be sticky. */
+static void CheckRejected(const std::vector<uint8_t>& Stream, size_t ValidMessages)
+{
+	for (size_t ChunkSize : { Stream.size(), size_t(1) })
+	{
+		FMessageReader Reader;
+		const std::vector<FMessage> Messages = ReadAll(Stream, { ChunkSize }, Reader);
+		CHECK(Messages.size() == ValidMessages);
+		CHECK(Reader.HasError());
+		CHECK(!Reader.GetError().empty());
+
+		// The stream can't be resynchronized, even with valid frames.
+		std::vector<uint8_t> Valid;
+		WriteMessage(Valid, EMessageType::Request, 100, "{}");
+		Reader.Append(Valid.data(), Valid.size());
+
+		FMessage Message;
+		CHECK(!Reader.Next(Message));
+		CHECK(Reader.HasError());
+	}
+}
+
+TEST_CASE("Rejects invalid frame headers")
+{
+	std::vector<uint8_t> Valid;
+	WriteMessage(Valid, EMessageType::Request, 1, "{}");
+
+	auto WithFrame = [&](const std::vector<uint8_t>& Frame)
+	{
+		std::vector<uint8_t> Stream = Valid;
+		Append(Stream, Frame);
+		return Stream;
+	};
+
+	CheckRejected(WithFrame(MakeFrame(EMessageType::Request, 2, 0, { 'x' }, Magic ^ 1)), 1);
+	CheckRejected(WithFrame(MakeFrame(EMessageType::Request, 2, 0, { 'x' }, Magic, Version + 1)), 1);
+	CheckRejected(WithFrame(MakeFrame(EMessageType::Request, 2, 0, { 'x' }, Magic, 0)), 1);
+	CheckRejected(WithFrame(MakeFrame(static_cast<EMessageType>(0), 2, 0, { 'x' })), 1);
+	CheckRejected(WithFrame(MakeFrame(static_cast<EMessageType>(4), 2, 0, { 'x' })), 1);
+
+	// A legacy command line after framed messages.
+	const std::string CommandLine = "-VSServerPing -NamedPipe=Test";
+	CheckRejected(WithFrame(std::vector<uint8_t>(CommandLine.begin(), CommandLine.end())), 1);
+}
+
+TEST_CASE("Rejects oversized frames from the header alone")
+{
+	FFrameHeader Header{};
+	Header.Magic = Magic;
+	Header.Version = Version;
+	Header.Type = EMessageType::Request;
+	Header.RequestId = 1;
+
+	for (uint32_t PayloadSize : { MaxFramePayload + 1, MaxMessageSize, UINT32_MAX })
+	{
+		Header.PayloadSize = PayloadSize;
+
+		// The payload is never sent: the reader must not wait for it, nor allocate for it.
+		FMessageReader Reader;
+		Reader.Append(&Header, HeaderSize);
+
+		FMessage Message;
+		CHECK(!Reader.Next(Message));
+		CHECK(Reader.HasError());
+	}
+
+	// The largest frame is accepted.
+	std::vector<uint8_t> Largest = MakeFrame(EMessageType::Request, 1, 0, MakePayload(MaxFramePayload, 1));
+	CHECK(ReadAll(Largest, { Largest.size() }).size() == 1);
+}
+
+TEST_CASE("Rejects messages over MaxMessageSize")
+{
+	static_assert(MaxMessageSize % MaxFramePayload == 0, "The test fills the message with full frames.");
+	const std::vector<uint8_t> Full = MakeFrame(EMessageType::Request, 1, FrameFlagContinued, MakePayload(MaxFramePayload, 1));
+	const uint32_t FullFrames = MaxMessageSize / MaxFramePayload;
+
+	// Exactly `MaxMessageSize` bytes, ended by an empty frame.
+	{
+		FMessageReader Reader;
+		FMessage Message;
+		for (uint32_t Frame = 0; Frame < FullFrames; Frame++)
+		{
+			Reader.Append(Full.data(), Full.size());
+			CHECK(!Reader.Next(Message));
+		}
+
+		const std::vector<uint8_t> Last = MakeFrame(EMessageType::Request, 1, 0, {});
+		Reader.Append(Last.data(), Last.size());
+		CHECK(Reader.Next(Message));
+		CHECK(!Reader.HasError() && Message.Payload.size() == MaxMessageSize);
+	}
+
+	// One byte more.
+	{
+		FMessageReader Reader;
+		FMessage Message;
+		for (uint32_t Frame = 0; Frame < FullFrames; Frame++)
+		{
+			Reader.Append(Full.data(), Full.size());
+			CHECK(!Reader.Next(Message));
+		}
+
+		CHECK(!Reader.HasError());
+		const std::vector<uint8_t> Last = MakeFrame(EMessageType::Request, 1, 0, { 'x' });
+		Reader.Append(Last.data(), Last.size());
+		CHECK(!Reader.Next(Message));
+		CHECK(Reader.HasError());
+	}
+}
+
+TEST_CASE("Rejects mixed frame types for the same request ID")
+{
+	for (EMessageType Second : { EMessageType::Data, EMessageType::Response })
+	{
+		std::vector<uint8_t> Stream;
+		WriteMessage(Stream, EMessageType::Request, 5, "{}");
+		Append(Stream, MakeFrame(EMessageType::Request, 1, FrameFlagContinued, { 'a' }));
+		Append(Stream, MakeFrame(Second, 1, 0, { 'b' }));
+		CheckRejected(Stream, 1);
+	}
+
+	// Other requests are not affected by a pending one.
+	std::vector<uint8_t> Stream;
+	Append(Stream, MakeFrame(EMessageType::Request, 1, FrameFlagContinued, { 'a' }));
+	Append(Stream, MakeFrame(EMessageType::Data, 2, 0, { 'b' }));
+	Append(Stream, MakeFrame(EMessageType::Request, 1, 0, { 'c' }));
+	const std::vector<FMessage> Messages = ReadAll(Stream, { 1 });
+	CHECK(Messages.size() == 2);
+	if (Messages.size() == 2)
+	{
+		CHECK(IsSameMessage(Messages[0], EMessageType::Data, 2, { 'b' }));
+		CHECK(IsSameMessage(Messages[1], EMessageType::Request, 1, { 'a', 'c' }));
+	}
+}
+
+TEST_CASE("Tells framed and legacy clients apart")
+{
+	std::vector<uint8_t> Frame;
+	WriteMessage(Frame, EMessageType::Request, 1, "");
+	CHECK(IsFramed(Frame.data(), Frame.size()));
+	CHECK(IsFramed(Frame.data(), sizeof(uint32_t)));
+	CHECK(!IsFramed(Frame.data(), sizeof(uint32_t) - 1));
+	CHECK(!IsFramed(nullptr, 0));
+
+	const std::string CommandLine = "-run=VSTestAdapter -NamedPipe=Test";
+	CHECK(!IsFramed(CommandLine.data(), CommandLine.size()));
+}
+
+TEST_CASE("Command and priority names")
+{
+	for (ECommand Command : { ECommand::Ping, ECommand::TestAdapter, ECommand::Shutdown, ECommand::BlueprintIndex, ECommand::BlueprintReferences, ECommand::Cancel })
+	{
+		CHECK(ParseCommand(LexToString(Command)) == Command);
+	}
+
+	CHECK(ParseCommand("") == ECommand::Unknown);
+	CHECK(ParseCommand("PING") == ECommand::Unknown);
+	CHECK(ParseCommand("unknown") == ECommand::Unknown);
+
+	for (EPriority Priority : { EPriority::Urgent, EPriority::Normal, EPriority::Background })
+	{
+		EPriority Parsed = EPriority::Normal;
+		CHECK(ParsePriority(LexToString(Priority), Parsed) && Parsed == Priority);
+	}
+
+	EPriority Unchanged = EPriority::Background;
+	CHECK(!ParsePriority("high", Unchanged) && Unchanged == EPriority::Background);
+}
+
+TEST_MAIN()
@@ -0,0 +1,385 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+// Replays a trace of requests over a socket pair, through the framing of `VSServerProtocol.h` and a stub
+// dispatcher standing in for the server, and prints the round trip times and throughput.
+// The commands are not run, so this measures the overhead of the protocol and the transport only,
+// without Unreal Engine. Each line of the trace is the JSON payload of a request, as with the
+// `-LatencyBenchmarkTrace` parameter of the `VSServer` commandlet.
+//
+// The sanitizers of the test build slow it down, so build it without them for meaningful numbers:
+//
+//   cmake -S Tests -B Tests/_bench -DVSTOOLS_TESTS_SANITIZE=OFF -DCMAKE_BUILD_TYPE=Release
+//   cmake --build Tests/_bench --target ServerTraceBenchmark
+//   Tests/_bench/ServerTraceBenchmark [trace] [iterations]
+
+#include "VSServerProtocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace VisualStudioTools::ServerProtocol;
+
+/** Size of the output of the stub blueprint and test commands, sent in a single `Data` message. */
+static constexpr size_t StubOutputSize = 4 * 1024;
+
+static constexpr int DefaultIterations = 1000;
+
+using FClock = std::chrono::steady_clock;
+
+static double GetMilliseconds(FClock::duration Duration)
+{
+	return std::chrono::duration<double, std::milli>(Duration).count();
+}
+
+static bool WriteAll(int Socket, const std::vector<uint8_t>& Bytes)
+{
+	size_t Offset = 0;
+	while (Offset < Bytes.size())
+	{
+		const ssize_t Written = ::write(Socket, Bytes.data() + Offset, Bytes.size() - Offset);
+		if (Written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (Written <= 0)
+		{
+			return false;
+		}
+
+		Offset += static_cast<size_t>(Written);
+	}
+
+	return true;
+}
+
+/** Reads whatever is available into the reader. Returns false once the other end is closed. */
+static bool ReadSome(int Socket, FMessageReader& Reader)
+{
+	uint8_t Buffer[MaxFramePayload];
+	while (true)
+	{
+		const ssize_t Read = ::read(Socket, Buffer, sizeof(Buffer));
+		if (Read < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (Read <= 0)
+		{
+			return false;
+		}
+
+		Reader.Append(Buffer, static_cast<size_t>(Read));
+		return true;
+	}
+}
+
+/**
+* Returns the value of a string field of a request. The requests of the traces don't escape quotes
+* in the fields read here, so this does without a JSON parser.
+*/
+static std::string GetStringField(const std::string& Json, const char* Name)
+{
+	const std::string Key = std::string("\"") + Name + "\"";
+	const size_t KeyPos = Json.find(Key);
+	const size_t Colon = KeyPos == std::string::npos ? std::string::npos : Json.find(':', KeyPos + Key.size());
+	const size_t Start = Colon == std::string::npos ? std::string::npos : Json.find('"', Colon);
+	const size_t End = Start == std::string::npos ? std::string::npos : Json.find('"', Start + 1);
+	return End == std::string::npos ? std::string() : Json.substr(Start + 1, End - Start - 1);
+}
+
+/**
+* Answers a request like the server does, with `Data` messages for the commands that have an output,
+* and a response. Returns true on `shutdown`.
+*/
+static bool Dispatch(const FMessage& Message, const std::vector<uint8_t>& StubOutput, std::vector<uint8_t>& Out)
+{
+	if (Message.Type != EMessageType::Request)
+	{
+		WriteMessage(Out, EMessageType::Response, Message.RequestId, "{\"result\":1,\"error\":\"Expected a request message.\"}");
+		return false;
+	}
+
+	const std::string Payload(Message.Payload.begin(), Message.Payload.end());
+	switch (ParseCommand(GetStringField(Payload, "command")))
+	{
+	case ECommand::Ping:
+		WriteMessage(Out, EMessageType::Response, Message.RequestId, "{\"result\":0}");
+		return false;
+
+	case ECommand::Shutdown:
+		WriteMessage(Out, EMessageType::Response, Message.RequestId, "{\"result\":0}");
+		return true;
+
+	case ECommand::TestAdapter:
+	case ECommand::BlueprintIndex:
+	case ECommand::BlueprintReferences:
+		WriteMessage(Out, EMessageType::Data, Message.RequestId, StubOutput.data(), StubOutput.size());
+		WriteMessage(Out, EMessageType::Response, Message.RequestId, "{\"result\":0}");
+		return false;
+
+	case ECommand::Cancel:
+		// Requests are answered before the next one is read, so there is never anything to cancel.
+		WriteMessage(Out, EMessageType::Response, Message.RequestId, "{\"result\":1,\"error\":\"Unknown request.\"}");
+		return false;
+
+	default:
+		WriteMessage(Out, EMessageType::Response, Message.RequestId, "{\"result\":1,\"error\":\"Unknown command.\"}");
+		return false;
+	}
+}
+
+/** Serves the requests of the socket until `shutdown`, the client closes it, or a framing error. */
+static void RunStubServer(int Socket)
+{
+	const std::vector<uint8_t> StubOutput(StubOutputSize, 'x');
+	FMessageReader Reader;
+	std::vector<uint8_t> Out;
+
+	while (true)
+	{
+		FMessage Message;
+		while (Reader.Next(Message))
+		{
+			Out.clear();
+			const bool bShutdown = Dispatch(Message, StubOutput, Out);
+			if (!WriteAll(Socket, Out) || bShutdown)
+			{
+				return;
+			}
+		}
+
+		if (Reader.HasError())
+		{
+			std::fprintf(stderr, "Closing the server connection: %s\n", Reader.GetError().c_str());
+			return;
+		}
+
+		if (!ReadSome(Socket, Reader))
+		{
+			return;
+		}
+	}
+}
+
+/**
+* Client end of the socket, playing the role of Visual Studio.
+*/
+class FTraceClient
+{
+public:
+	explicit FTraceClient(int InSocket)
+		: Socket(InSocket)
+	{
+	}
+
+	/** Sends the requests as one write, with consecutive IDs. Returns the ID of the first one. */
+	bool Send(const std::vector<std::string>& Payloads, uint32_t& OutFirstId)
+	{
+		std::vector<uint8_t> Frames;
+		OutFirstId = NextRequestId;
+		for (const std::string& Payload : Payloads)
+		{
+			WriteMessage(Frames, EMessageType::Request, NextRequestId++, Payload);
+		}
+
+		return WriteAll(Socket, Frames);
+	}
+
+	/** Waits for the responses of the requests starting at `FirstId`, which the server answers in order. */
+	bool Receive(uint32_t FirstId, size_t Count)
+	{
+		FMessage Message;
+		uint32_t ExpectedId = FirstId;
+		while (Count > 0)
+		{
+			if (!Reader.Next(Message))
+			{
+				if (Reader.HasError() || !ReadSome(Socket, Reader))
+				{
+					return false;
+				}
+				continue;
+			}
+
+			if (Message.RequestId != ExpectedId)
+			{
+				std::fprintf(stderr, "Unexpected message for request %u, expected %u.\n", Message.RequestId, ExpectedId);
+				return false;
+			}
+
+			if (Message.Type != EMessageType::Response)
+			{
+				OutputBytes += Message.Payload.size();
+				continue;
+			}
+
+			const std::string Payload(Message.Payload.begin(), Message.Payload.end());
+			if (Payload.find("\"result\":0") == std::string::npos)
+			{
+				Errors++;
+			}
+
+			ExpectedId++;
+			Count--;
+		}
+
+		return true;
+	}
+
+	size_t OutputBytes = 0;
+	size_t Errors = 0;
+
+private:
+	const int Socket;
+	FMessageReader Reader;
+	uint32_t NextRequestId = 1;
+};
+
+static bool ReadTrace(const char* Path, std::vector<std::string>& OutTrace)
+{
+	std::ifstream File(Path);
+	if (!File)
+	{
+		return false;
+	}
+
+	std::string Line;
+	while (std::getline(File, Line))
+	{
+		if (Line.find_first_not_of(" \t\r") != std::string::npos)
+		{
+			OutTrace.push_back(Line);
+		}
+	}
+
+	return true;
+}
+
+/**
+* Sends the requests of the trace one at a time for the round trip times, and then all of them at once
+* for the throughput of pipelined requests. Returns false if a request is not answered.
+*/
+static bool RunBenchmark(FTraceClient& Client, const std::vector<std::string>& Trace, int Iterations)
+{
+	std::vector<double> Latencies;
+	const FClock::time_point TraceStartTime = FClock::now();
+	for (int Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		for (const std::string& Payload : Trace)
+		{
+			const FClock::time_point StartTime = FClock::now();
+			uint32_t RequestId = 0;
+			if (!Client.Send({ Payload }, RequestId) || !Client.Receive(RequestId, 1))
+			{
+				std::fprintf(stderr, "Benchmark request failed: %s\n", Payload.c_str());
+				return false;
+			}
+
+			Latencies.push_back(GetMilliseconds(FClock::now() - StartTime));
+		}
+	}
+	const double TraceSeconds = GetMilliseconds(FClock::now() - TraceStartTime) / 1000.0;
+
+	std::sort(Latencies.begin(), Latencies.end());
+	std::printf("Server latency over %zu requests: { Min: %.3fms, P50: %.3fms, P99: %.3fms, Max: %.3fms }\n",
+		Latencies.size(), Latencies.front(), Latencies[Latencies.size() / 2], Latencies[Latencies.size() * 99 / 100], Latencies.back());
+	std::printf("Server throughput: %.1f requests/s, %.1f KB/s of output.\n",
+		Latencies.size() / TraceSeconds, Client.OutputBytes / 1024.0 / TraceSeconds);
+
+	// The requests are written on another thread, so neither end blocks on a full socket buffer.
+	std::vector<std::string> Pipelined;
+	for (int Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		Pipelined.insert(Pipelined.end(), Trace.begin(), Trace.end());
+	}
+
+	const size_t OutputBytesBefore = Client.OutputBytes;
+	const FClock::time_point PipelineStartTime = FClock::now();
+	uint32_t FirstId = 0;
+	bool bSent = false;
+	std::thread Sender([&]()
+		{
+			bSent = Client.Send(Pipelined, FirstId);
+		});
+
+	// The IDs are consecutive, and the sender only uses them before writing.
+	const uint32_t ExpectedFirstId = static_cast<uint32_t>(Latencies.size() + 1);
+	const bool bReceived = Client.Receive(ExpectedFirstId, Pipelined.size());
+	Sender.join();
+	const double PipelineSeconds = GetMilliseconds(FClock::now() - PipelineStartTime) / 1000.0;
+
+	if (!bSent || !bReceived || FirstId != ExpectedFirstId)
+	{
+		std::fprintf(stderr, "Pipelined benchmark requests failed.\n");
+		return false;
+	}
+
+	std::printf("Server answered %zu pipelined requests in %.3fms: %.1f requests/s, %.1f KB/s of output.\n",
+		Pipelined.size(), PipelineSeconds * 1000.0, Pipelined.size() / PipelineSeconds,
+		(Client.OutputBytes - OutputBytesBefore) / 1024.0 / PipelineSeconds);
+	return true;
+}
+
+int main(int ArgC, char** ArgV)
+{
+	const char* TracePath = ArgC > 1 ? ArgV[1] : nullptr;
+	const int Iterations = ArgC > 2 ? std::max(1, std::atoi(ArgV[2])) : DefaultIterations;
+
+	std::vector<std::string> Trace;
+	if (TracePath != nullptr && !ReadTrace(TracePath, Trace))
+	{
+		std::fprintf(stderr, "Failed to read the benchmark trace: %s\n", TracePath);
+		return 1;
+	}
+
+	if (Trace.empty())
+	{
+		Trace.push_back(std::string("{\"command\":\"") + LexToString(ECommand::Ping) + "\"}");
+	}
+
+	// A closed socket is reported by the failed write instead.
+	std::signal(SIGPIPE, SIG_IGN);
+
+	int Sockets[2];
+	if (::socketpair(AF_UNIX, SOCK_STREAM, 0, Sockets) != 0)
+	{
+		std::perror("socketpair");
+		return 1;
+	}
+
+	std::thread Server(RunStubServer, Sockets[1]);
+
+	FTraceClient Client(Sockets[0]);
+	bool bSucceeded = RunBenchmark(Client, Trace, Iterations);
+
+	uint32_t ShutdownId = 0;
+	bSucceeded = Client.Send({ std::string("{\"command\":\"") + LexToString(ECommand::Shutdown) + "\"}" }, ShutdownId)
+		&& Client.Receive(ShutdownId, 1)
+		&& bSucceeded;
+
+	::shutdown(Sockets[0], SHUT_RDWR);
+	Server.join();
+	::close(Sockets[0]);
+	::close(Sockets[1]);
+
+	if (Client.Errors > 0)
+	{
+		std::printf("%zu requests of the trace were answered with an error.\n", Client.Errors);
+	}
+
+	return bSucceeded ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+// Copyright 2022 (c) Microsoft. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+// Minimal test helpers for the engine-independent headers of the plugin.
+// Each test executable registers its cases with `TEST_CASE` and returns the number of failed checks.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace VisualStudioTools
+{
+namespace Tests
+{
+struct FTestCase
+{
+	const char* Name;
+	std::function<void()> Body;
+};
+
+inline std::vector<FTestCase>& GetTestCases()
+{
+	static std::vector<FTestCase> TestCases;
+	return TestCases;
+}
+
+inline int& GetFailureCount()
+{
+	static int FailureCount = 0;
+	return FailureCount;
+}
+
+struct FTestRegistration
+{
+	FTestRegistration(const char* Name, std::function<void()> Body)
+	{
+		GetTestCases().push_back({ Name, std::move(Body) });
+	}
+};
+
+inline void ReportFailure(const char* File, int Line, const char* Expression)
+{
+	std::fprintf(stderr, "%s:%d: check failed: %s\n", File, Line, Expression);
+	GetFailureCount()++;
+}
+
+/** Runs the registered cases, the ones containing `Filter` if set. Returns the process exit code. */
+inline int RunTests(const char* Filter)
+{
+	for (const FTestCase& TestCase : GetTestCases())
+	{
+		if (Filter != nullptr && std::string(TestCase.Name).find(Filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		const int FailuresBefore = GetFailureCount();
+		TestCase.Body();
+		std::printf("[%s] %s\n", GetFailureCount() == FailuresBefore ? "PASS" : "FAIL", TestCase.Name);
+	}
+
+	return GetFailureCount() == 0 ? 0 : 1;
+}
+
+inline bool ReadFile(const std::string& Path, std::vector<uint8_t>& OutBytes)
+{
+	std::ifstream File(Path, std::ios::binary);
+	if (!File)
+	{
+		return false;
+	}
+
+	OutBytes.assign(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+	return true;
+}
+
+inline bool WriteFile(const std::string& Path, const std::vector<uint8_t>& Bytes)
+{
+	std::ofstream File(Path, std::ios::binary);
+	File.write(reinterpret_cast<const char*>(Bytes.data()), static_cast<std::streamsize>(Bytes.size()));
+	return static_cast<bool>(File);
+}
+
+/** Directory of the checked-in fixtures, passed by CMake at build time. */
+inline std::string GetFixturePath(const char* Name)
+{
+	return std::string(VSTOOLS_FIXTURES_DIR) + "/" + Name;
+}
+} // namespace Tests
+} // namespace VisualStudioTools
+
+#define VSTOOLS_CONCAT_INNER(A, B) A##B
+#define VSTOOLS_CONCAT(A, B) VSTOOLS_CONCAT_INNER(A, B)
+
+#define TEST_CASE(Name) \
+	static void VSTOOLS_CONCAT(TestCase_, __LINE__)(); \
+	static ::VisualStudioTools::Tests::FTestRegistration VSTOOLS_CONCAT(TestRegistration_, __LINE__)(Name, &VSTOOLS_CONCAT(TestCase_, __LINE__)); \
+	static void VSTOOLS_CONCAT(TestCase_, __LINE__)()
+
+#define CHECK(Expression) \
+	do \
+	{ \
+		if (!(Expression)) \
+		{ \
+			::VisualStudioTools::Tests::ReportFailure(__FILE__, __LINE__, #Expression); \
+		} \
+	} while (false)
+
+#define TEST_MAIN() \
+	int main(int argc, char** argv) \
+	{ \
+		return ::VisualStudioTools::Tests::RunTests(argc > 1 ? argv[1] : nullptr); \
+	}